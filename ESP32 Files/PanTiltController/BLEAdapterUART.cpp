@@ -1,23 +1,43 @@
 #include "BLEAdapterUART.h"
+#include <esp_gatts_api.h>
 
 // -------------------- Callback Implementations --------------------
+// These run on the BLE host task. They only touch per-connection RX state;
+// everything the application sees is delivered later from loop().
 
-void BleServerCallbacks::onConnect(BLEServer* server) {
-  if (adapter_) adapter_->handleConnect_(server->getConnId());
+void BleServerCallbacks::onConnect(BLEServer* server, esp_ble_gatts_cb_param_t* param) {
+  if (adapter_) adapter_->handleConnect_(param->connect.conn_id);
 }
 
-void BleServerCallbacks::onDisconnect(BLEServer* server) {
-  if (adapter_) adapter_->handleDisconnect_();
+void BleServerCallbacks::onDisconnect(BLEServer* server, esp_ble_gatts_cb_param_t* param) {
+  if (adapter_) adapter_->handleDisconnect_(param->disconnect.conn_id);
 }
 
-void BleRxCallbacks::onWrite(BLECharacteristic* chr) {
+void BleRxCallbacks::onWrite(BLECharacteristic* chr, esp_ble_gatts_cb_param_t* param) {
   if (!adapter_) return;
 
   // ESP32 Arduino BLE library returns Arduino String here
   String s = chr->getValue();
   if (s.length() == 0) return;
 
-  adapter_->handleRxData_((const uint8_t*)s.c_str(), s.length());
+  adapter_->handleRxData_(param->write.conn_id, (const uint8_t*)s.c_str(), s.length());
+}
+
+// -------------------- Ring helpers --------------------
+
+static void ringWrite(uint8_t* ring, size_t cap, size_t& head, const uint8_t* src, size_t n) {
+  size_t first = cap - head;
+  if (first > n) first = n;
+  memcpy(ring + head, src, first);
+  if (n > first) memcpy(ring, src + first, n - first);
+  head = (head + n) % cap;
+}
+
+static void ringRead(const uint8_t* ring, size_t cap, size_t tail, uint8_t* dst, size_t n) {
+  size_t first = cap - tail;
+  if (first > n) first = n;
+  memcpy(dst, ring + tail, first);
+  if (n > first) memcpy(dst + first, ring, n - first);
 }
 
 // -------------------- BLEAdapterUART Implementation --------------------
@@ -27,9 +47,21 @@ bool BLEAdapterUART::begin(const BleConfig& cfg, FrameHandler onFrame, EventHand
   onFrame_ = onFrame;
   onEvent_ = onEvent;
 
-  lineBuf_.reserve(cfg_.max_frame_len + 8);
-  windowStartMs_ = millis();
-  framesThisWindow_ = 0;
+  maxConns_ = cfg_.max_connections;
+  if (maxConns_ < 1) maxConns_ = 1;
+  if (maxConns_ > BLE_MAX_CONNS) maxConns_ = BLE_MAX_CONNS;
+
+  // One full frame plus headroom per connection, so a max-length line never starves
+  frameScratch_ = (uint8_t*)malloc(cfg_.max_frame_len + 1);
+  for (uint8_t i = 0; i < maxConns_; i++) {
+    BleConn& c = conns_[i];
+    c.lineBuf.reserve(cfg_.max_frame_len + 8);
+    c.rxCap = cfg_.max_frame_len + 2 + 256;
+    c.rxRing = (uint8_t*)malloc(c.rxCap);
+    c.txQueue = (uint8_t*)malloc(cfg_.tx_queue_len);
+    if (!c.rxRing || !c.txQueue) return false;
+  }
+  if (!frameScratch_) return false;
 
   // Initialize BLE
   BLEDevice::init(cfg_.device_name.c_str());
@@ -46,7 +78,8 @@ bool BLEAdapterUART::begin(const BleConfig& cfg, FrameHandler onFrame, EventHand
     NUS_TX_CHARACTERISTIC,
     BLECharacteristic::PROPERTY_NOTIFY
   );
-  txChar_->addDescriptor(new BLE2902());
+  txCccd_ = new BLE2902();
+  txChar_->addDescriptor(txCccd_);
 
   // RX characteristic (phone -> ESP32): Write
   rxChar_ = service->createCharacteristic(
@@ -68,9 +101,7 @@ bool BLEAdapterUART::begin(const BleConfig& cfg, FrameHandler onFrame, EventHand
 
   enabled_ = true;
 
-  BleMeta meta;
-  meta.timestamp_ms = millis();
-  if (onEvent_) onEvent_("READY", meta);
+  emitEvent_("READY", 0);
 
   return true;
 }
@@ -78,139 +109,296 @@ bool BLEAdapterUART::begin(const BleConfig& cfg, FrameHandler onFrame, EventHand
 void BLEAdapterUART::setEnabled(bool en) {
   enabled_ = en;
   if (!enabled_) {
-    lineBuf_ = "";
+    for (uint8_t i = 0; i < maxConns_; i++) {
+      BleConn& c = conns_[i];
+      c.rxReset = true;   // BLE task drops its partial line on the next write
+      size_t len;
+      while (popFrame_(c, len)) {}
+      c.txHead = 0;
+      c.txUsed = 0;
+    }
   }
 }
 
 bool BLEAdapterUART::isConnected() const {
-  return enabled_ && connected_;
+  return enabled_ && connectionCount() > 0;
+}
+
+uint8_t BLEAdapterUART::connectionCount() const {
+  uint8_t n = 0;
+  for (uint8_t i = 0; i < maxConns_; i++) {
+    if (conns_[i].used && !conns_[i].closing) n++;
+  }
+  return n;
+}
+
+bool BLEAdapterUART::connStats(int connId, BleStats& out) const {
+  int idx = findConn_(connId);
+  if (idx < 0) return false;
+  out = conns_[idx].stats;
+  return true;
 }
 
-bool BLEAdapterUART::floodAllowed_() {
+bool BLEAdapterUART::rxCredit(int connId, size_t& bytes, uint32_t& lines) {
+  int idx = findConn_(connId);
+  if (idx < 0) return false;
+  BleConn& c = conns_[idx];
+  portENTER_CRITICAL(&mux_);
+  size_t used = c.rxUsed + c.lineLen;
+  uint32_t frames = c.framesThisWindow;
+  uint32_t since = millis() - c.windowStartMs;
+  portEXIT_CRITICAL(&mux_);
+  bytes = used + 2 >= c.rxCap ? 0 : c.rxCap - used - 2;
+  if (since >= 1000) frames = 0;
+  lines = frames >= cfg_.flood_max_fps ? 0 : cfg_.flood_max_fps - frames;
+  return true;
+}
+
+int BLEAdapterUART::findConn_(int connId) const {
+  for (uint8_t i = 0; i < maxConns_; i++) {
+    if (conns_[i].used && conns_[i].connId == connId) return i;
+  }
+  return -1;
+}
+
+bool BLEAdapterUART::floodAllowed_(BleConn& c) {
   uint32_t now = millis();
-  if (now - windowStartMs_ >= 1000) {
-    windowStartMs_ = now;
-    framesThisWindow_ = 0;
+  if (now - c.windowStartMs >= 1000) {
+    c.windowStartMs = now;
+    c.framesThisWindow = 0;
   }
-  if (framesThisWindow_ >= cfg_.flood_max_fps) {
+  if (c.framesThisWindow >= cfg_.flood_max_fps) {
+    c.stats.flood_drops++;
     stats_.flood_drops++;
     return false;
   }
-  framesThisWindow_++;
+  c.framesThisWindow++;
+  return true;
+}
+
+void BLEAdapterUART::pushFrame_(BleConn& c, const uint8_t* data, size_t len) {
+  // Single producer (BLE task): copy into free space first, then publish under the lock
+  portENTER_CRITICAL(&mux_);
+  size_t freeBytes = c.rxCap - c.rxUsed;
+  portEXIT_CRITICAL(&mux_);
+
+  if (len + 2 > freeBytes) {
+    c.stats.dropped_frames++;
+    stats_.dropped_frames++;
+    return;
+  }
+
+  uint8_t hdr[2] = { (uint8_t)(len & 0xFF), (uint8_t)(len >> 8) };
+  size_t head = c.rxHead;
+  ringWrite(c.rxRing, c.rxCap, head, hdr, 2);
+  ringWrite(c.rxRing, c.rxCap, head, data, len);
+
+  portENTER_CRITICAL(&mux_);
+  c.rxHead = head;
+  c.rxUsed += len + 2;
+  portEXIT_CRITICAL(&mux_);
+
+  c.stats.rx_frames++;
+  stats_.rx_frames++;
+}
+
+bool BLEAdapterUART::popFrame_(BleConn& c, size_t& len) {
+  portENTER_CRITICAL(&mux_);
+  size_t used = c.rxUsed;
+  portEXIT_CRITICAL(&mux_);
+  if (used < 2) return false;
+
+  uint8_t hdr[2];
+  ringRead(c.rxRing, c.rxCap, c.rxTail, hdr, 2);
+  len = (size_t)hdr[0] | ((size_t)hdr[1] << 8);
+  ringRead(c.rxRing, c.rxCap, (c.rxTail + 2) % c.rxCap, frameScratch_, len);
+  frameScratch_[len] = 0;
+
+  portENTER_CRITICAL(&mux_);
+  c.rxTail = (c.rxTail + len + 2) % c.rxCap;
+  c.rxUsed -= len + 2;
+  portEXIT_CRITICAL(&mux_);
   return true;
 }
 
-void BLEAdapterUART::processRxByte_(uint8_t b) {
+void BLEAdapterUART::processRxByte_(BleConn& c, uint8_t b) {
   // NOTE: rx_bytes is counted in handleRxData_ as a bulk add
   char ch = (char)b;
 
   if (ch == '\n') {
-    if (!floodAllowed_()) {
-      lineBuf_ = "";
+    if (!floodAllowed_(c)) {
+      c.lineBuf = "";
       return;
     }
 
     // Strip optional '\r'
-    if (lineBuf_.endsWith("\r")) {
-      lineBuf_.remove(lineBuf_.length() - 1);
+    if (c.lineBuf.endsWith("\r")) {
+      c.lineBuf.remove(c.lineBuf.length() - 1);
     }
 
-    // Emit frame
-    stats_.rx_frames++;
-    if (onFrame_) {
-      BleMeta meta;
-      meta.timestamp_ms = millis();
-      meta.conn_id = connId_;
-      onFrame_((const uint8_t*)lineBuf_.c_str(), lineBuf_.length(), meta);
-    }
-    lineBuf_ = "";
+    pushFrame_(c, (const uint8_t*)c.lineBuf.c_str(), c.lineBuf.length());
+    c.lineBuf = "";
     return;
   }
 
   // Accumulate
-  if (lineBuf_.length() >= cfg_.max_frame_len) {
+  if (c.lineBuf.length() >= cfg_.max_frame_len) {
+    c.stats.overlong_frames++;
     stats_.overlong_frames++;
-    lineBuf_ = "";
+    c.lineBuf = "";
     return;
   }
 
-  lineBuf_ += ch;
+  c.lineBuf += ch;
 }
 
 void BLEAdapterUART::handleConnect_(int connId) {
-  connected_ = true;
-  connId_ = connId;
+  int idx = -1;
+  portENTER_CRITICAL(&mux_);
+  for (uint8_t i = 0; i < maxConns_; i++) {
+    if (!conns_[i].used) {
+      idx = i;
+      BleConn& c = conns_[i];
+      c.used = true;
+      c.closing = false;
+      c.connId = connId;
+      c.rxHead = c.rxTail = c.rxUsed = 0;
+      c.lineLen = 0;
+      c.connectPending = true;
+      break;
+    }
+  }
+  portEXIT_CRITICAL(&mux_);
+
+  if (idx < 0) {
+    // Over capacity: refuse rather than share a slot
+    server_->disconnect(connId);
+    return;
+  }
+
+  BleConn& c = conns_[idx];
+  c.stats = BleStats();
+  c.stats.connects = 1;
+  c.windowStartMs = millis();
+  c.framesThisWindow = 0;
+  c.rxReset = false;
   stats_.connects++;
-  lineBuf_ = "";
 
-  BleMeta meta;
-  meta.timestamp_ms = millis();
-  meta.conn_id = connId;
-  if (onEvent_) onEvent_("CONNECTED", meta);
+  // Advertising stops on connect; keep it up while there are free slots
+  if (connectionCount() < maxConns_) BLEDevice::startAdvertising();
 }
 
-void BLEAdapterUART::handleDisconnect_() {
-  connected_ = false;
+void BLEAdapterUART::handleDisconnect_(int connId) {
+  int idx = findConn_(connId);
+  if (idx >= 0) {
+    conns_[idx].stats.disconnects++;
+    conns_[idx].closing = true;   // loop() reports it and frees the slot
+  }
   stats_.disconnects++;
-  lineBuf_ = "";
-
-  BleMeta meta;
-  meta.timestamp_ms = millis();
-  meta.conn_id = connId_;
-  if (onEvent_) onEvent_("DISCONNECTED", meta);
-
-  connId_ = 0;
 
   // Restart advertising so another device can connect
   BLEDevice::startAdvertising();
 }
 
-void BLEAdapterUART::handleRxData_(const uint8_t* data, size_t len) {
+void BLEAdapterUART::handleRxData_(int connId, const uint8_t* data, size_t len) {
+  int idx = findConn_(connId);
+  if (idx < 0) return;
+  BleConn& c = conns_[idx];
+  if (c.closing) return;
+
+  if (c.rxReset) {
+    c.lineBuf = "";
+    c.rxReset = false;
+    portENTER_CRITICAL(&mux_);
+    c.lineLen = 0;
+    portEXIT_CRITICAL(&mux_);
+  }
   if (!enabled_) return;
 
   // Always track raw received bytes here (single source of truth)
+  c.stats.rx_bytes += len;
   stats_.rx_bytes += len;
 
   // If newline not required, each write = one frame
   if (!cfg_.require_newline) {
-    if (!floodAllowed_()) return;
-    stats_.rx_frames++;
-
-    BleMeta meta;
-    meta.timestamp_ms = millis();
-    meta.conn_id = connId_;
-
-    if (onFrame_) onFrame_(data, len, meta);
+    if (!floodAllowed_(c)) return;
+    if (len > cfg_.max_frame_len) {
+      c.stats.overlong_frames++;
+      stats_.overlong_frames++;
+      return;
+    }
+    pushFrame_(c, data, len);
     return;
   }
 
   // Newline framed mode
   for (size_t i = 0; i < len; i++) {
-    processRxByte_(data[i]);
+    processRxByte_(c, data[i]);
   }
+
+  // rxCredit() runs on the loop task; it sees the partial line only through lineLen
+  portENTER_CRITICAL(&mux_);
+  c.lineLen = c.lineBuf.length();
+  portEXIT_CRITICAL(&mux_);
 }
 
-bool BLEAdapterUART::sendFrame(const uint8_t* data, size_t len) {
-  if (!isConnected() || !txChar_) return false;
+bool BLEAdapterUART::enqueueTx_(BleConn& c, const uint8_t* data, size_t len) {
+  if (len > cfg_.tx_queue_len - c.txUsed) {
+    c.stats.tx_drops++;
+    stats_.tx_drops++;
+    return false;
+  }
+  size_t head = (c.txHead + c.txUsed) % cfg_.tx_queue_len;
+  ringWrite(c.txQueue, cfg_.tx_queue_len, head, data, len);
+  c.txUsed += len;
+  return true;
+}
+
+void BLEAdapterUART::pumpTx_(BleConn& c, uint32_t now) {
+  if (!c.txUsed || (int32_t)(now - c.nextTxMs) < 0) return;
 
   // Conservative chunk size (keeps iOS/Android happy without depending on MTU negotiation)
   const size_t chunkSize = 240;
-  size_t sent = 0;
+  uint8_t chunk[chunkSize];
+  size_t n = c.txUsed < chunkSize ? c.txUsed : chunkSize;
+  ringRead(c.txQueue, cfg_.tx_queue_len, c.txHead, chunk, n);
+
+  // Same rule as BLECharacteristic::notify(): nothing goes out until the client subscribes
+  if (txCccd_ && txCccd_->getNotifications()) {
+    esp_err_t err = esp_ble_gatts_send_indicate(server_->getGattsIf(), (uint16_t)c.connId,
+                                                txChar_->getHandle(), n, chunk, false);
+    if (err != ESP_OK) {
+      c.nextTxMs = now + 10;   // stack congested, retry the same chunk
+      return;
+    }
+    c.stats.tx_bytes += n;
+    stats_.tx_bytes += n;
+  }
 
-  while (sent < len) {
-    size_t toSend = (len - sent < chunkSize) ? (len - sent) : chunkSize;
+  c.txHead = (c.txHead + n) % cfg_.tx_queue_len;
+  c.txUsed -= n;
 
-    txChar_->setValue((uint8_t*)(data + sent), toSend);
-    txChar_->notify();
+  // Pace chunks so the controller's notify buffers don't overflow
+  c.nextTxMs = now + 10;
+}
 
-    sent += toSend;
-    stats_.tx_bytes += toSend;
+bool BLEAdapterUART::sendFrameTo(int connId, const uint8_t* data, size_t len) {
+  if (!enabled_ || !txChar_) return false;
+  int idx = findConn_(connId);
+  if (idx < 0 || conns_[idx].closing) return false;
+  return enqueueTx_(conns_[idx], data, len);
+}
 
-    // Delay only BETWEEN chunks
-    if (sent < len) delay(10);
-  }
+bool BLEAdapterUART::sendFrame(const uint8_t* data, size_t len) {
+  if (!isConnected() || !txChar_) return false;
 
-  return true;
+  bool any = false;
+  for (uint8_t i = 0; i < maxConns_; i++) {
+    BleConn& c = conns_[i];
+    if (!c.used || c.closing) continue;
+    if (enqueueTx_(c, data, len)) any = true;
+  }
+  return any;
 }
 
 bool BLEAdapterUART::sendLine(const String& line) {
@@ -218,6 +406,69 @@ bool BLEAdapterUART::sendLine(const String& line) {
   return sendFrame((const uint8_t*)msg.c_str(), msg.length());
 }
 
+bool BLEAdapterUART::sendLineTo(int connId, const String& line) {
+  String msg = line + "\n";
+  return sendFrameTo(connId, (const uint8_t*)msg.c_str(), msg.length());
+}
+
+void BLEAdapterUART::emitEvent_(const char* event, int connId) {
+  BleMeta meta;
+  meta.timestamp_ms = millis();
+  meta.conn_id = connId;
+  if (onEvent_) onEvent_(event, meta);
+}
+
 void BLEAdapterUART::loop() {
-  // BLE events handled by callbacks
+  uint32_t now = millis();
+
+  // Connection lifecycle (flagged by the BLE task, reported here)
+  for (uint8_t i = 0; i < maxConns_; i++) {
+    BleConn& c = conns_[i];
+    if (c.connectPending) {
+      c.connectPending = false;
+      c.txHead = 0;
+      c.txUsed = 0;
+      c.nextTxMs = now;
+      emitEvent_("CONNECTED", c.connId);
+    }
+    if (c.closing) {
+      emitEvent_("DISCONNECTED", c.connId);
+      c.txHead = 0;
+      c.txUsed = 0;
+      c.lineBuf = "";
+      portENTER_CRITICAL(&mux_);
+      c.rxHead = c.rxTail = c.rxUsed = 0;
+      c.lineLen = 0;
+      c.connId = -1;
+      c.closing = false;
+      c.used = false;
+      portEXIT_CRITICAL(&mux_);
+    }
+  }
+
+  // RX: one frame per connection per turn, so a chatty central can't starve the others
+  if (enabled_) {
+    uint8_t budget = cfg_.frames_per_loop ? cfg_.frames_per_loop : 1;
+    uint8_t idle = 0;
+    while (budget && idle < maxConns_) {
+      BleConn& c = conns_[rrNext_];
+      rrNext_ = (rrNext_ + 1) % maxConns_;
+      size_t len;
+      if (!c.used || c.closing || !popFrame_(c, len)) { idle++; continue; }
+      idle = 0;
+      budget--;
+      if (onFrame_) {
+        BleMeta meta;
+        meta.timestamp_ms = millis();
+        meta.conn_id = c.connId;
+        onFrame_(frameScratch_, len, meta);
+      }
+    }
+  }
+
+  // TX: at most one chunk per connection per pacing interval
+  for (uint8_t i = 0; i < maxConns_; i++) {
+    BleConn& c = conns_[i];
+    if (c.used && !c.closing) pumpTx_(c, now);
+  }
 }
@@ -26,13 +26,44 @@ struct BleStats {
   uint32_t flood_drops = 0;
   uint32_t connects = 0;
   uint32_t disconnects = 0;
+  uint32_t tx_drops = 0;         // lines that didn't fit a TX queue
 };
 
 struct BleConfig {
   String device_name = "ESP32-BLE";
   size_t max_frame_len = 512;
-  uint32_t flood_max_fps = 60;
+  uint32_t flood_max_fps = 60;   // per connection
   bool require_newline = true;   // true: newline framed. false: each write is a frame.
+  uint8_t max_connections = 3;   // simultaneous centrals (capped at BLE_MAX_CONNS)
+  size_t tx_queue_len = 2048;    // per-connection notify backlog; lines that don't fit are dropped
+  uint8_t frames_per_loop = 8;   // RX frames delivered per loop(), taken round-robin across connections
+};
+
+static const uint8_t BLE_MAX_CONNS = 4;
+
+// Per-central state. The BLE task frames bytes into lineBuf and pushes finished frames
+// into rxRing as [len lo][len hi][bytes]; loop() pops them and owns the TX side.
+struct BleConn {
+  volatile bool used = false;
+  volatile bool closing = false;        // disconnected, waiting for loop() to report and free it
+  volatile bool connectPending = false;
+  volatile bool rxReset = false;        // set by setEnabled(false); BLE task drops lineBuf
+  int connId = -1;
+
+  String lineBuf;                       // BLE task only
+  volatile size_t lineLen = 0;          // lineBuf.length() as of the last write, published under the mux
+  uint32_t windowStartMs = 0;
+  uint32_t framesThisWindow = 0;
+
+  uint8_t* rxRing = nullptr;
+  size_t rxCap = 0;
+  volatile size_t rxHead = 0, rxTail = 0, rxUsed = 0;
+
+  uint8_t* txQueue = nullptr;
+  size_t txHead = 0, txUsed = 0;
+  uint32_t nextTxMs = 0;
+
+  BleStats stats;
 };
 
 class BLEAdapterUART;
@@ -41,8 +72,8 @@ class BLEAdapterUART;
 class BleServerCallbacks : public BLEServerCallbacks {
 public:
   BleServerCallbacks(BLEAdapterUART* adapter) : adapter_(adapter) {}
-  void onConnect(BLEServer* server) override;
-  void onDisconnect(BLEServer* server) override;
+  void onConnect(BLEServer* server, esp_ble_gatts_cb_param_t* param) override;
+  void onDisconnect(BLEServer* server, esp_ble_gatts_cb_param_t* param) override;
 private:
   BLEAdapterUART* adapter_;
 };
@@ -50,7 +81,7 @@ private:
 class BleRxCallbacks : public BLECharacteristicCallbacks {
 public:
   BleRxCallbacks(BLEAdapterUART* adapter) : adapter_(adapter) {}
-  void onWrite(BLECharacteristic* chr) override;
+  void onWrite(BLECharacteristic* chr, esp_ble_gatts_cb_param_t* param) override;
 private:
   BLEAdapterUART* adapter_;
 };
@@ -61,17 +92,23 @@ public:
   using EventHandler = std::function<void(const char* event, const BleMeta& meta)>;
 
   bool begin(const BleConfig& cfg, FrameHandler onFrame, EventHandler onEvent);
-  void loop();
+  void loop();   // delivers frames/events and drains TX queues; call often
   void setEnabled(bool en);
   bool isConnected() const;
-  bool sendFrame(const uint8_t* data, size_t len);
+  uint8_t connectionCount() const;
+  bool sendFrame(const uint8_t* data, size_t len);               // every connected central
+  bool sendFrameTo(int connId, const uint8_t* data, size_t len); // one central
   bool sendLine(const String& line);  // convenience: adds \n
+  bool sendLineTo(int connId, const String& line);
   BleStats stats() const { return stats_; }
+  bool connStats(int connId, BleStats& out) const;
+  // Free RX ring bytes (after one frame header) and lines left in the flood window.
+  bool rxCredit(int connId, size_t& bytes, uint32_t& lines);
 
-  // Called by callbacks (internal use)
+  // Called by callbacks on the BLE task (internal use)
   void handleConnect_(int connId);
-  void handleDisconnect_();
-  void handleRxData_(const uint8_t* data, size_t len);
+  void handleDisconnect_(int connId);
+  void handleRxData_(int connId, const uint8_t* data, size_t len);
 
 private:
   BleConfig cfg_;
@@ -79,20 +116,24 @@ private:
   EventHandler onEvent_;
   BleStats stats_;
   bool enabled_ = false;
-  bool connected_ = false;
-  int connId_ = 0;
 
   BLEServer* server_ = nullptr;
   BLECharacteristic* txChar_ = nullptr;
   BLECharacteristic* rxChar_ = nullptr;
+  BLE2902* txCccd_ = nullptr;
 
-  // Framing buffer (used when require_newline=true)
-  String lineBuf_;
-
-  // Flood tracking
-  uint32_t windowStartMs_ = 0;
-  uint32_t framesThisWindow_ = 0;
+  BleConn conns_[BLE_MAX_CONNS];
+  uint8_t maxConns_ = 1;
+  uint8_t rrNext_ = 0;        // round-robin cursor for RX delivery
+  uint8_t* frameScratch_ = nullptr;
+  portMUX_TYPE mux_ = portMUX_INITIALIZER_UNLOCKED;
 
-  bool floodAllowed_();
-  void processRxByte_(uint8_t b);
+  int findConn_(int connId) const;
+  bool floodAllowed_(BleConn& c);
+  void processRxByte_(BleConn& c, uint8_t b);
+  void pushFrame_(BleConn& c, const uint8_t* data, size_t len);
+  bool popFrame_(BleConn& c, size_t& len);
+  bool enqueueTx_(BleConn& c, const uint8_t* data, size_t len);
+  void pumpTx_(BleConn& c, uint32_t now);
+  void emitEvent_(const char* event, int connId);
 };
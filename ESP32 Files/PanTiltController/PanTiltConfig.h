@@ -0,0 +1,86 @@
+#pragma once
+#include <stdint.h>
+
+// Build profiles: everything that sizes a rig or switches a feature in or out at
+// compile time. Values are constants, so a disabled feature's handlers and ticks fold
+// away (with --gc-sections its functions are dropped) and its buffers shrink to a stub.
+//
+// To build a variant, derive from a profile and shadow what differs, e.g. in a
+// PanTiltProfile.h next to the sketch (picked up automatically):
+//
+//   struct MyRig : PanTiltProfileFull {
+//     static constexpr uint8_t queueDepth = 8;
+//     static constexpr bool targets = false;
+//   };
+//   #define PANTILT_PROFILE MyRig
+//
+// or pass -DPANTILT_PROFILE=PanTiltProfileLite in the build flags.
+
+struct PanTiltProfileFull {
+  // ---- sizes ----
+  static constexpr uint8_t  maxRigs = 3;
+  static constexpr uint8_t  queueDepth = 20;        // steps per rig queue
+  static constexpr uint8_t  macroVms = 2;           // macros running at once per rig
+  static constexpr uint16_t cmdLineMax = 3600;      // longer lines are cut
+  static constexpr uint16_t favScriptMax = 3600;    // macro/favorite source
+  static constexpr uint16_t favCodeMax = 2048;      // compiled macro/favorite
+  static constexpr uint16_t scratchBytes = 4096;    // per-command arena, >= favCodeMax
+  static constexpr uint8_t  schedMax = 8;           // pending "at" lines per rig
+  static constexpr uint8_t  replayMax = 16;         // cached replies per rig
+
+  // ---- servos ----
+  static constexpr uint16_t servoHz = 50;
+  static constexpr uint16_t servoAttachMinUs = 500; // range given to Servo::attach
+  static constexpr uint16_t servoAttachMaxUs = 2400;
+  static constexpr int xMinUs = 500,  xMaxUs = 2400;   // default -90..+90 mapping
+  static constexpr int yMinUs = 800,  yMaxUs = 2050;
+
+  // ---- features ----
+  static constexpr bool telemetry = true;     // telemetry stream
+  static constexpr bool jog = true;           // velocity jog
+  static constexpr bool sweepShapes = true;   // sine/ease/raster/spiral/lissajous (triangle always)
+  static constexpr bool aiming = true;        // camera, look
+  static constexpr bool world = true;         // rigFrame, lookAt, stored targets
+  static constexpr bool targets = true;       // on-device subject selection
+  static constexpr bool zones = true;         // keep-out zones (soft limits always)
+  static constexpr bool hostClock = true;     // sync pings and "at" scheduling
+  static constexpr bool replay = true;        // replay cache for resent ids
+};
+
+// One head, short queue, manual control only: the first rigs this firmware drove.
+struct PanTiltProfileLite : PanTiltProfileFull {
+  static constexpr uint8_t  maxRigs = 1;
+  static constexpr uint8_t  queueDepth = 8;
+  static constexpr uint8_t  macroVms = 1;
+  static constexpr uint16_t cmdLineMax = 1024;
+  static constexpr uint16_t favScriptMax = 1024;
+  static constexpr uint16_t favCodeMax = 1024;
+  static constexpr uint16_t scratchBytes = 1024;
+  static constexpr uint8_t  replayMax = 8;
+
+  static constexpr bool sweepShapes = false;
+  static constexpr bool world = false;
+  static constexpr bool targets = false;
+  static constexpr bool zones = false;
+  static constexpr bool hostClock = false;
+};
+
+#ifndef PANTILT_PROFILE
+#if defined(__has_include)
+#if __has_include("PanTiltProfile.h")
+#include "PanTiltProfile.h"
+#endif
+#endif
+#endif
+#ifndef PANTILT_PROFILE
+#define PANTILT_PROFILE PanTiltProfileFull
+#endif
+
+typedef PANTILT_PROFILE PanTiltBuild;
+
+static_assert(PanTiltBuild::maxRigs >= 1 && PanTiltBuild::maxRigs <= 7, "maxRigs must be 1..7");
+static_assert(PanTiltBuild::queueDepth >= 2, "queueDepth must be at least 2");
+static_assert(PanTiltBuild::macroVms >= 1, "macroVms must be at least 1");
+static_assert(PanTiltBuild::scratchBytes >= PanTiltBuild::favCodeMax, "scratch arena must hold a compiled macro");
+static_assert(PanTiltBuild::replayMax >= 1 && PanTiltBuild::replayMax <= 64, "replayMax must be 1..64");
+static_assert(!PanTiltBuild::targets || PanTiltBuild::aiming, "targets needs aiming");
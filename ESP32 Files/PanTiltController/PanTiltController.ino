@@ -18,9 +18,24 @@ static void sendBleJsonLine(const String& line) {
   ble.sendLine(line);
 }
 
-static void panTiltOut(PanTiltDest dest, const String& line) {
+static void panTiltOut(PanTiltDest dest, const String& line, int bleConn) {
   if (dest == PanTiltDest::USB) sendUsbJsonLine(line);
-  else sendBleJsonLine(line);
+  else if (bleConn < 0) sendBleJsonLine(line);
+  else ble.sendLineTo(bleConn, line);   // only the central that issued the command
+}
+
+static bool panTiltInputCredit(PanTiltLink link, PanTiltInputCredit& out) {
+  if (link == PANTILT_LINK_USB) {
+    out.bytes = usb.rxFree();
+    out.lines = usb.linesLeft();
+    return true;
+  }
+  size_t bytes = 0;
+  uint32_t lines = 0;
+  if (!ble.rxCredit((int)link - 1, bytes, lines)) return false;
+  out.bytes = bytes;
+  out.lines = lines;
+  return true;
 }
 
 static void onUsbFrame(const uint8_t* data, size_t len, const UsbMeta& meta) {
@@ -33,6 +48,7 @@ static void onUsbFrame(const uint8_t* data, size_t len, const UsbMeta& meta) {
 }
 
 static void onUsbEvent(const char* event, const UsbMeta& meta) {
+  if (!PanTilt_wants(PanTiltMsg::Debug)) return;
   String out;
   out.reserve(160);
   out += "{\"ok\":true,\"event\":\"usb_";
@@ -40,7 +56,7 @@ static void onUsbEvent(const char* event, const UsbMeta& meta) {
   out += "\",\"ts\":";
   out += String(meta.timestamp_ms);
   out += "}";
-  sendUsbJsonLine(out);
+  PanTilt_emit(PanTiltMsg::Debug, out);
 }
 
 static void onBleFrame(const uint8_t* data, size_t len, const BleMeta& meta) {
@@ -49,10 +65,15 @@ static void onBleFrame(const uint8_t* data, size_t len, const BleMeta& meta) {
   for (size_t i = 0; i < len; i++) payload += (char)data[i];
 
   // Route everything to pan/tilt for now
-  PanTilt_handleLine(payload, true);
+  PanTilt_handleLine(payload, true, meta.conn_id);
 }
 
 static void onBleEvent(const char* event, const BleMeta& meta) {
+  // Each central is its own output link with its own subscriptions
+  if (!strcmp(event, "CONNECTED")) PanTilt_linkOpened(PanTilt_bleLink(meta.conn_id));
+  else if (!strcmp(event, "DISCONNECTED")) PanTilt_linkClosed(PanTilt_bleLink(meta.conn_id));
+
+  if (!PanTilt_wants(PanTiltMsg::Debug)) return;
   String out;
   out.reserve(180);
   out += "{\"ok\":true,\"event\":\"ble_";
@@ -63,17 +84,20 @@ static void onBleEvent(const char* event, const BleMeta& meta) {
   out += String(meta.conn_id);
   out += "}";
 
-  // Always visible on USB; optionally visible on BLE when connected
-  sendUsbJsonLine(out);
-  sendBleJsonLine(out);
+  // Visible on USB by default; centrals see it after subscribing to debug
+  PanTilt_emit(PanTiltMsg::Debug, out);
 }
 
+static const size_t USB_RX_BUFFER = 1024;
+
 void setup() {
+  Serial.setRxBufferSize(USB_RX_BUFFER);   // must precede begin(); reported as input credit
   Serial.begin(BAUD);
   delay(200);
 
   // Wire pan/tilt output routing
   PanTilt_setOutput(panTiltOut);
+  PanTilt_setInputCredit(panTiltInputCredit);
 
   // USB JSONL input
   UsbConfig ucfg;
@@ -81,6 +105,7 @@ void setup() {
   ucfg.flood_max_fps = 120;
   ucfg.require_newline = true;
   ucfg.echo = false;
+  ucfg.rx_buffer_len = USB_RX_BUFFER;
   usb.begin(Serial, ucfg, onUsbFrame, onUsbEvent);
 
   // BLE JSONL input
@@ -89,12 +114,19 @@ void setup() {
   bcfg.max_frame_len = 4096;
   bcfg.flood_max_fps = 120;
   bcfg.require_newline = true;
+  bcfg.max_connections = 3;
   ble.begin(bcfg, onBleFrame, onBleEvent);
 
   // Initialize pan/tilt (servos + config load)
   PanTilt_begin(3, 4);
 
-  sendUsbJsonLine("{\"ok\":true,\"event\":\"fullcontroller_ready\"}");
+  // Extra camera heads get their own pins/NVS namespaces and are selected by "route":
+  //   PanTiltRigConfig cam2;
+  //   cam2.route = "cam2"; cam2.servoXPin = 5; cam2.servoYPin = 6;
+  //   cam2.prefNs = "pantilt2"; cam2.storeNs = "ptstore2";
+  //   PanTilt_addRig(cam2);
+
+  PanTilt_emit(PanTiltMsg::Debug, "{\"ok\":true,\"event\":\"fullcontroller_ready\"}");
 }
 
 void loop() {
@@ -104,7 +136,7 @@ void loop() {
 
   static uint32_t last = 0;
   uint32_t now = millis();
-  if (now - last >= 5000) {
+  if (now - last >= 5000 && PanTilt_wants(PanTiltMsg::Debug)) {
     last = now;
     auto s = ble.stats();
 
@@ -116,7 +148,10 @@ void loop() {
     out += ",\"tx_bytes\":"; out += String(s.tx_bytes);
     out += ",\"connects\":"; out += String(s.connects);
     out += ",\"disconnects\":"; out += String(s.disconnects);
+    out += ",\"conns\":"; out += String(ble.connectionCount());
+    out += ",\"dropped\":"; out += String(s.dropped_frames);
+    out += ",\"tx_drops\":"; out += String(s.tx_drops);
     out += "}}";
-    sendUsbJsonLine(out);
+    PanTilt_emit(PanTiltMsg::Debug, out);
   }
 }
@@ -1,18 +1,146 @@
 #include "PanTiltModule.h"
-#include <ESP32Servo.h>
-#include <Preferences.h>
+#include "PanTiltRig.h"
 
 // ------------------- Output plumbing -------------------
 static PanTiltOutputFn g_out = nullptr;
+static PanTiltInputCreditFn g_inputCredit = nullptr;
+static const PanTiltRig* g_creditRig = nullptr;   // rig whose queue the credit fields report
+
+// Result of the client command being run, for the replay cache: the first ok/err reply
+// with its id. A data reply (status, lists) makes it a query, which isn't cached.
+struct ReplayCapture {
+  bool armed = false;
+  bool got = false;
+  bool ok = false;
+  bool data = false;
+  uint32_t id = 0;
+  char text[REPLAY_TEXT];
+};
+static ReplayCapture g_replayCap;
 
 static String g_defaultSubsystem = "usb";  // if cmd doesn't specify subsystem
-static bool g_mirrorToBle = false;         // current command origin (BLE mirrors)
-static bool g_lastMirrorToBle = false;     // for async done events
+static PanTiltLink g_mirrorToBle = PANTILT_LINK_USB;      // current command origin link
+static PanTiltLink g_lastMirrorToBle = PANTILT_LINK_USB;  // for async done events
+
+// ------------------- Output Sinks -------------------
+// Every link is a sink with a subscription level per message class. Senders ask
+// sinkWants() before formatting, then emitLine() fans the one String out.
+enum SubLevel : uint8_t { SUB_OFF = 0, SUB_OWN = 1, SUB_ALL = 2 };
+static const uint8_t PANTILT_MAX_SINKS = 6;   // USB + BLE centrals
+
+// Per-link ackLevel: which kinds of command reply (ReplyKind) a link still receives.
+// Data the client asked for (status, lists, help) and faults always pass.
+enum AckLevel : uint8_t { ACK_NONE = 0, ACK_MINIMAL, ACK_EVENTS, ACK_FULL };
+
+static const uint8_t ACK_LEVEL_KINDS[] = {
+  (1<<RK_DATA) | (1<<RK_FAULT),                                                        // none
+  (1<<RK_DATA) | (1<<RK_FAULT) | (1<<RK_TINY),                                         // minimal
+  (1<<RK_DATA) | (1<<RK_FAULT) | (1<<RK_DONE),                                         // events
+  (1<<RK_DATA) | (1<<RK_FAULT) | (1<<RK_OK) | (1<<RK_STATE) | (1<<RK_STARTED) | (1<<RK_DONE),  // full
+};
+static const char* const ACK_LEVEL_NAMES[] = { "none", "minimal", "events", "full" };
+
+struct OutputSink {
+  bool used = false;
+  PanTiltLink link = PANTILT_LINK_USB;
+  uint8_t level[PANTILT_MSG_CLASSES];
+  uint8_t ackKinds = ACK_LEVEL_KINDS[ACK_FULL];
+  AckLevel ackLevel = ACK_FULL;
+  bool credits = false;   // append "cr" (free queue slots / input bytes) to acks and telemetry
+};
+
+static OutputSink g_sinks[PANTILT_MAX_SINKS];
+static bool g_sinksReady = false;
+
+static const char* const MSG_CLASS_NAMES[PANTILT_MSG_CLASSES] = { "ack", "motion", "telemetry", "fault", "debug" };
+static const char* const SUB_LEVEL_NAMES[] = { "off", "own", "all" };
+
+static void sinkDefaults(OutputSink& s, PanTiltLink link) {
+  s.used = true;
+  s.link = link;
+  // USB has always carried every line; other links hear their own replies
+  for (uint8_t c=0;c<PANTILT_MSG_CLASSES;c++) s.level[c] = (link == PANTILT_LINK_USB) ? SUB_ALL : SUB_OWN;
+  if (link != PANTILT_LINK_USB) s.level[(uint8_t)PanTiltMsg::Debug] = SUB_OFF;
+  s.ackLevel = ACK_FULL;
+  s.ackKinds = ACK_LEVEL_KINDS[ACK_FULL];
+  s.credits = false;
+}
+
+// USB is always a sink; set up on first use since output can precede PanTilt_begin().
+static void sinksInit() {
+  if (g_sinksReady) return;
+  sinkDefaults(g_sinks[0], PANTILT_LINK_USB);
+  g_sinksReady = true;
+}
+
+static OutputSink* sinkFind(PanTiltLink link, bool create) {
+  sinksInit();
+  OutputSink* freeSlot = nullptr;
+  for (uint8_t i=0;i<PANTILT_MAX_SINKS;i++) {
+    if (g_sinks[i].used && g_sinks[i].link == link) return &g_sinks[i];
+    if (!g_sinks[i].used && !freeSlot) freeSlot = &g_sinks[i];
+  }
+  if (!create || !freeSlot || link == PANTILT_LINK_SYSTEM) return nullptr;
+  sinkDefaults(*freeSlot, link);
+  return freeSlot;
+}
+
+static bool sinkGets(const OutputSink& s, PanTiltMsg cls, PanTiltLink origin, ReplyKind rk) {
+  if (!(s.ackKinds & (1 << rk))) return false;
+  uint8_t lv = s.level[(uint8_t)cls];
+  if (lv == SUB_ALL) return true;
+  if (lv != SUB_OWN) return false;
+  if (origin == s.link || origin == PANTILT_LINK_SYSTEM) return true;
+  return origin == PANTILT_LINK_BLE_ALL && s.link != PANTILT_LINK_USB;
+}
+
+static bool sinkWants(PanTiltMsg cls, PanTiltLink origin, ReplyKind rk = RK_DATA) {
+  if (!g_out) return true;   // standalone debug fallback prints everything
+  sinksInit();
+  for (uint8_t i=0;i<PANTILT_MAX_SINKS;i++) {
+    if (g_sinks[i].used && sinkGets(g_sinks[i], cls, origin, rk)) return true;
+  }
+  return false;
+}
+
+// Credit object for one link: free queue slots of the current rig, free input bytes and
+// flood-window lines of the link. Fields the module can't know are left out.
+static void appendCredit(String& out, PanTiltLink link) {
+  out += "{";
+  bool first = true;
+  if (g_creditRig) { out += "\"q\":"; out += String(g_creditRig->queueFree()); first = false; }
+  PanTiltInputCredit in;
+  if (g_inputCredit && link != PANTILT_LINK_BLE_ALL && g_inputCredit(link, in)) {
+    if (!first) out += ",";
+    out += "\"in\":"; out += String(in.bytes);
+    out += ",\"ln\":"; out += String(in.lines);
+  }
+  out += "}";
+}
 
-static void emitLine(const String& line, bool mirrorToBle) {
+static void emitLine(PanTiltMsg cls, const String& line, PanTiltLink origin, ReplyKind rk = RK_DATA) {
+  if (g_replayCap.armed && cls == PanTiltMsg::Ack && rk == RK_DATA) g_replayCap.data = true;
   if (g_out) {
-    g_out(PanTiltDest::USB, line);
-    if (mirrorToBle) g_out(PanTiltDest::BLE, line);
+    sinksInit();
+    const bool creditable = (cls == PanTiltMsg::Ack || cls == PanTiltMsg::Telemetry) && line.endsWith("}");
+    for (uint8_t i=0;i<PANTILT_MAX_SINKS;i++) {
+      const OutputSink& s = g_sinks[i];
+      if (!s.used || !sinkGets(s, cls, origin, rk)) continue;
+      const String* out = &line;
+      static String credited;   // reused like the reply line
+      if (s.credits && creditable) {
+        // per sink: each link has its own input buffer
+        credited = "";
+        credited.reserve(line.length() + 40);
+        credited.concat(line.c_str(), line.length() - 1);
+        credited += ",\"cr\":";
+        appendCredit(credited, s.link);
+        credited += "}";
+        out = &credited;
+      }
+      if (s.link == PANTILT_LINK_USB) g_out(PanTiltDest::USB, *out, -1);
+      else g_out(PanTiltDest::BLE, *out, s.link == PANTILT_LINK_BLE_ALL ? -1 : (int)s.link - 1);
+    }
     return;
   }
   // Fallback (debug) if someone uses module standalone
@@ -20,11 +148,10 @@ static void emitLine(const String& line, bool mirrorToBle) {
   Serial.flush();
 }
 
-static String jsonEscape(const String& in) {
-  String out;
-  out.reserve(in.length() + 8);
-  for (int i = 0; i < (int)in.length(); i++) {
-    char c = in[i];
+// Appends in, escaped, to a reply under construction (no temporary String).
+static void appendJsonEscaped(String& out, const char* in) {
+  for (const char* p = in; *p; p++) {
+    char c = *p;
     switch (c) {
       case '\\': out += "\\\\"; break;
       case '\"': out += "\\\""; break;
@@ -43,138 +170,86 @@ static String jsonEscape(const String& in) {
         break;
     }
   }
-  return out;
 }
 
+static void appendJsonEscaped(String& out, const String& in) { appendJsonEscaped(out, in.c_str()); }
+
 static void appendRoutingFields(String& out, const String& subsystem, const String& route) {
   if (subsystem.length()) {
     out += ",\"subsystem\":\"";
-    out += jsonEscape(subsystem);
+    appendJsonEscaped(out, subsystem);
     out += "\"";
   }
   if (route.length()) {
     out += ",\"route\":\"";
-    out += jsonEscape(route);
+    appendJsonEscaped(out, route);
     out += "\"";
   }
 }
 
-// ------------------- Servos / Ranges -------------------
-static Servo s1, s2;
-
-static const int S1_MIN_US = 500;
-static const int S1_MAX_US = 2400;
-
-static const int S2_MIN_US = 800;
-static const int S2_MAX_US = 2050;
-
+// ------------------- Ranges -------------------
 static const float POS_MIN = -90.0f;
 static const float POS_MAX =  90.0f;
 
-static const uint16_t CMD_LINE_MAX = 3600;
-static const uint8_t QMAX = 20;
+static const uint16_t CMD_LINE_MAX = PanTiltBuild::cmdLineMax;
 static const uint32_t STEP_TIMEOUT_GRACE_MS = 2000;
 
-static const int POS_FAV_SLOTS = 5;
-static const int CMD_FAV_SLOTS = 5;
-static const uint16_t FAV_SCRIPT_MAX = 3600;
-
-static int SERVO1_PIN = 3;
-static int SERVO2_PIN = 4;
-
-// ------------------- Runtime State -------------------
-static float v1 = 0.0f;
-static float v2 = 0.0f;
-
-static bool invX = false;
-static bool invY = false;
-
-static float defaultSpeed = 90.0f;
-
-static bool posFavValid[POS_FAV_SLOTS] = {false,false,false,false,false};
-static float posFavX[POS_FAV_SLOTS] = {0,0,0,0,0};
-static float posFavY[POS_FAV_SLOTS] = {0,0,0,0,0};
-
-static bool cmdFavValid[CMD_FAV_SLOTS] = {false,false,false,false,false};
-static String cmdFavScript[CMD_FAV_SLOTS] = {"","","","",""};
-
-static String lastSubsystem = "";
-static String lastRoute = "";
-
-static bool cfgDirty = false;
-
-// ------------------- Motion Profiles -------------------
-struct MoveProfile {
-  bool active = false;
-  float start = 0;
-  float target = 0;
-  uint32_t t0 = 0;
-  uint32_t durMs = 0;
-  uint32_t cmdRef = 0;
-  char axis = '?';
-};
-
-static MoveProfile mx, my;
+static const uint16_t FAV_SCRIPT_MAX = PanTiltBuild::favScriptMax;
+
+// Dirty bits, grouped by NVS key: the "cfg" blob (speed, invert, autosave, position
+// slots) and one "fbN" key per command favorite. Persisting only rewrites keys whose
+// group has a bit set.
+static const uint16_t DIRTY_SPEED     = 1u << 0;
+static const uint16_t DIRTY_INVERT    = 1u << 1;
+static const uint16_t DIRTY_AUTOSAVE  = 1u << 2;
+static const uint8_t  DIRTY_POS_SHIFT = 3;   // bits 3..7
+static const uint8_t  DIRTY_FAV_SHIFT = 8;   // bits 8..12
+static const uint16_t DIRTY_CFG_KEY   = 0x00FF;
+static const uint16_t DIRTY_FAV_ALL   = 0x1F00;
+static const uint16_t DIRTY_CAM       = 1u << 13;
+static const uint16_t DIRTY_FRAME     = 1u << 14;
+static const uint16_t DIRTY_LIMITS    = 1u << 15;
+
+static uint16_t dirtyPos(int i) { return (uint16_t)(1u << (DIRTY_POS_SHIFT + i)); }
+static uint16_t dirtyFav(int i) { return (uint16_t)(1u << (DIRTY_FAV_SHIFT + i)); }
+void PanTiltRig::markDirty(uint16_t bits) { cfgDirty |= bits; cfgDirtyAt = millis(); }
 
 // ------------------- Queue -------------------
-enum QueueMode : uint8_t { Q_OFF=0, Q_ON=1, Q_STEP=2 };
-static QueueMode qMode = Q_STEP;
-
-struct QueueItem {
-  bool used = false;
-  uint32_t id = 0;
-
-  String subsystem;
-  String route;
-
-  bool mirrorToBle = false;
-
-  String kind;
-
-  bool useX = false;
-  bool useY = false;
-
-  float tx = 0;
-  float ty = 0;
-  uint32_t dx = 0;
-  uint32_t dy = 0;
-
-  uint32_t expectedEnd = 0;
-};
+static const char* queueModeName(QueueMode m) {
+  switch (m) {
+    case Q_OFF: return "off";
+    case Q_ON: return "on";
+    case Q_BLEND: return "blend";
+    default: return "step";
+  }
+}
 
-static QueueItem q[QMAX];
-static uint8_t qHead = 0;
-static uint8_t qTail = 0;
-static uint8_t qCount = 0;
+bool PanTiltRig::qAnyActive() {
+  for (uint8_t i=0;i<QLANES;i++) if (qLane[i].active) return true;
+  return false;
+}
 
-static bool qActive = false;
-static QueueItem qCurrent;
-static bool qCurXDone = true;
-static bool qCurYDone = true;
-static uint32_t qStartedAt = 0;
+// Lane whose active step drives the given axis (nullptr when the axis is not queue-driven).
+QueueLane* PanTiltRig::laneForAxis(char axis) {
+  for (uint8_t i=0;i<QLANES;i++) {
+    QueueLane& ln = qLane[i];
+    if (!ln.active) continue;
+    if (axis == 'x' ? ln.cur.useX : ln.cur.useY) return &ln;
+  }
+  return nullptr;
+}
 
-static uint32_t autoId = 0;
+void PanTiltRig::qDeactivateLanes() {
+  for (uint8_t i=0;i<QLANES;i++) {
+    qLane[i].active = false;
+    qLane[i].xDone = qLane[i].yDone = true;
+  }
+}
 
 // ------------------- Preferences / Persistence -------------------
-static Preferences prefs;
-static const char* PREF_NS = "pantilt";
 static const uint32_t CFG_MAGIC = 0x50544A31; // 'PTJ1'
 static const uint16_t CFG_VERSION = 1;
 
-struct PersistedConfig {
-  uint32_t magic;
-  uint16_t version;
-  uint16_t reserved;
-  float defaultSpeed;
-  uint8_t invX;
-  uint8_t invY;
-  uint8_t posValidMask; // 5 bits
-  uint8_t reserved2;
-  float posX[POS_FAV_SLOTS];
-  float posY[POS_FAV_SLOTS];
-  uint32_t crc32;
-};
-
 // ------------------- Utilities -------------------
 static float clampf(float x, float lo, float hi) { return (x<lo)?lo:((x>hi)?hi:x); }
 static int clampInt(int x, int lo, int hi) { return (x<lo)?lo:((x>hi)?hi:x); }
@@ -187,12 +262,19 @@ static int mapSignedToUs(float v, int minUs, int maxUs) {
   return clampInt(us, minUs, maxUs);
 }
 
-static void applyOutputs() {
+void PanTiltRig::applyOutputs() {
+  // Last line of defence for every motion source: soft limits clamp, and a pose in a
+  // keep-out zone is replaced by the last allowed one (loop() then stops and reports).
+  v1 = clampf(v1, limits.minX, limits.maxX);
+  v2 = clampf(v2, limits.minY, limits.maxY);
+  if (poseAllowed(v1, v2)) { safeX = v1; safeY = v2; safeValid = true; }
+  else if (safeValid) { v1 = safeX; v2 = safeY; limitTripped = true; }
+
   float px = invX ? -v1 : v1;
   float py = invY ? -v2 : v2;
 
-  int us1 = mapSignedToUs(px, S1_MIN_US, S1_MAX_US);
-  int us2 = mapSignedToUs(py, S2_MIN_US, S2_MAX_US);
+  int us1 = mapSignedToUs(px, rigCfg.xMinUs, rigCfg.xMaxUs);
+  int us2 = mapSignedToUs(py, rigCfg.yMinUs, rigCfg.yMaxUs);
 
   s1.writeMicroseconds(us1);
   s2.writeMicroseconds(us2);
@@ -207,27 +289,165 @@ static uint32_t durationFromSpeed(float start, float target, float speedDegPerSe
   return (uint32_t)(sec * 1000.0f + 0.5f);
 }
 
-static void toggleInvertX() { invX = !invX; v1 = -v1; cfgDirty = true; }
-static void toggleInvertY() { invY = !invY; v2 = -v2; cfgDirty = true; }
+void PanTiltRig::toggleInvertX() { invX = !invX; v1 = -v1; markDirty(DIRTY_INVERT); }
+void PanTiltRig::toggleInvertY() { invY = !invY; v2 = -v2; markDirty(DIRTY_INVERT); }
 
 // ------------------- CRC32 -------------------
+// Reflected CRC-32 (poly 0xEDB88320), one lookup per byte; results match the bitwise
+// form, so blobs written by older firmware still validate.
+static const uint32_t CRC32_TABLE[256] = {
+  0x00000000u, 0x77073096u, 0xEE0E612Cu, 0x990951BAu, 0x076DC419u, 0x706AF48Fu,
+  0xE963A535u, 0x9E6495A3u, 0x0EDB8832u, 0x79DCB8A4u, 0xE0D5E91Eu, 0x97D2D988u,
+  0x09B64C2Bu, 0x7EB17CBDu, 0xE7B82D07u, 0x90BF1D91u, 0x1DB71064u, 0x6AB020F2u,
+  0xF3B97148u, 0x84BE41DEu, 0x1ADAD47Du, 0x6DDDE4EBu, 0xF4D4B551u, 0x83D385C7u,
+  0x136C9856u, 0x646BA8C0u, 0xFD62F97Au, 0x8A65C9ECu, 0x14015C4Fu, 0x63066CD9u,
+  0xFA0F3D63u, 0x8D080DF5u, 0x3B6E20C8u, 0x4C69105Eu, 0xD56041E4u, 0xA2677172u,
+  0x3C03E4D1u, 0x4B04D447u, 0xD20D85FDu, 0xA50AB56Bu, 0x35B5A8FAu, 0x42B2986Cu,
+  0xDBBBC9D6u, 0xACBCF940u, 0x32D86CE3u, 0x45DF5C75u, 0xDCD60DCFu, 0xABD13D59u,
+  0x26D930ACu, 0x51DE003Au, 0xC8D75180u, 0xBFD06116u, 0x21B4F4B5u, 0x56B3C423u,
+  0xCFBA9599u, 0xB8BDA50Fu, 0x2802B89Eu, 0x5F058808u, 0xC60CD9B2u, 0xB10BE924u,
+  0x2F6F7C87u, 0x58684C11u, 0xC1611DABu, 0xB6662D3Du, 0x76DC4190u, 0x01DB7106u,
+  0x98D220BCu, 0xEFD5102Au, 0x71B18589u, 0x06B6B51Fu, 0x9FBFE4A5u, 0xE8B8D433u,
+  0x7807C9A2u, 0x0F00F934u, 0x9609A88Eu, 0xE10E9818u, 0x7F6A0DBBu, 0x086D3D2Du,
+  0x91646C97u, 0xE6635C01u, 0x6B6B51F4u, 0x1C6C6162u, 0x856530D8u, 0xF262004Eu,
+  0x6C0695EDu, 0x1B01A57Bu, 0x8208F4C1u, 0xF50FC457u, 0x65B0D9C6u, 0x12B7E950u,
+  0x8BBEB8EAu, 0xFCB9887Cu, 0x62DD1DDFu, 0x15DA2D49u, 0x8CD37CF3u, 0xFBD44C65u,
+  0x4DB26158u, 0x3AB551CEu, 0xA3BC0074u, 0xD4BB30E2u, 0x4ADFA541u, 0x3DD895D7u,
+  0xA4D1C46Du, 0xD3D6F4FBu, 0x4369E96Au, 0x346ED9FCu, 0xAD678846u, 0xDA60B8D0u,
+  0x44042D73u, 0x33031DE5u, 0xAA0A4C5Fu, 0xDD0D7CC9u, 0x5005713Cu, 0x270241AAu,
+  0xBE0B1010u, 0xC90C2086u, 0x5768B525u, 0x206F85B3u, 0xB966D409u, 0xCE61E49Fu,
+  0x5EDEF90Eu, 0x29D9C998u, 0xB0D09822u, 0xC7D7A8B4u, 0x59B33D17u, 0x2EB40D81u,
+  0xB7BD5C3Bu, 0xC0BA6CADu, 0xEDB88320u, 0x9ABFB3B6u, 0x03B6E20Cu, 0x74B1D29Au,
+  0xEAD54739u, 0x9DD277AFu, 0x04DB2615u, 0x73DC1683u, 0xE3630B12u, 0x94643B84u,
+  0x0D6D6A3Eu, 0x7A6A5AA8u, 0xE40ECF0Bu, 0x9309FF9Du, 0x0A00AE27u, 0x7D079EB1u,
+  0xF00F9344u, 0x8708A3D2u, 0x1E01F268u, 0x6906C2FEu, 0xF762575Du, 0x806567CBu,
+  0x196C3671u, 0x6E6B06E7u, 0xFED41B76u, 0x89D32BE0u, 0x10DA7A5Au, 0x67DD4ACCu,
+  0xF9B9DF6Fu, 0x8EBEEFF9u, 0x17B7BE43u, 0x60B08ED5u, 0xD6D6A3E8u, 0xA1D1937Eu,
+  0x38D8C2C4u, 0x4FDFF252u, 0xD1BB67F1u, 0xA6BC5767u, 0x3FB506DDu, 0x48B2364Bu,
+  0xD80D2BDAu, 0xAF0A1B4Cu, 0x36034AF6u, 0x41047A60u, 0xDF60EFC3u, 0xA867DF55u,
+  0x316E8EEFu, 0x4669BE79u, 0xCB61B38Cu, 0xBC66831Au, 0x256FD2A0u, 0x5268E236u,
+  0xCC0C7795u, 0xBB0B4703u, 0x220216B9u, 0x5505262Fu, 0xC5BA3BBEu, 0xB2BD0B28u,
+  0x2BB45A92u, 0x5CB36A04u, 0xC2D7FFA7u, 0xB5D0CF31u, 0x2CD99E8Bu, 0x5BDEAE1Du,
+  0x9B64C2B0u, 0xEC63F226u, 0x756AA39Cu, 0x026D930Au, 0x9C0906A9u, 0xEB0E363Fu,
+  0x72076785u, 0x05005713u, 0x95BF4A82u, 0xE2B87A14u, 0x7BB12BAEu, 0x0CB61B38u,
+  0x92D28E9Bu, 0xE5D5BE0Du, 0x7CDCEFB7u, 0x0BDBDF21u, 0x86D3D2D4u, 0xF1D4E242u,
+  0x68DDB3F8u, 0x1FDA836Eu, 0x81BE16CDu, 0xF6B9265Bu, 0x6FB077E1u, 0x18B74777u,
+  0x88085AE6u, 0xFF0F6A70u, 0x66063BCAu, 0x11010B5Cu, 0x8F659EFFu, 0xF862AE69u,
+  0x616BFFD3u, 0x166CCF45u, 0xA00AE278u, 0xD70DD2EEu, 0x4E048354u, 0x3903B3C2u,
+  0xA7672661u, 0xD06016F7u, 0x4969474Du, 0x3E6E77DBu, 0xAED16A4Au, 0xD9D65ADCu,
+  0x40DF0B66u, 0x37D83BF0u, 0xA9BCAE53u, 0xDEBB9EC5u, 0x47B2CF7Fu, 0x30B5FFE9u,
+  0xBDBDF21Cu, 0xCABAC28Au, 0x53B39330u, 0x24B4A3A6u, 0xBAD03605u, 0xCDD70693u,
+  0x54DE5729u, 0x23D967BFu, 0xB3667A2Eu, 0xC4614AB8u, 0x5D681B02u, 0x2A6F2B94u,
+  0xB40BBE37u, 0xC30C8EA1u, 0x5A05DF1Bu, 0x2D02EF8Du
+};
+
 static uint32_t crc32_update(uint32_t crc, const uint8_t* data, size_t len) {
   crc = ~crc;
-  for (size_t i=0;i<len;i++) {
-    crc ^= data[i];
-    for (int b=0;b<8;b++) {
-      uint32_t mask = -(crc & 1u);
-      crc = (crc >> 1) ^ (0xEDB88320u & mask);
-    }
-  }
+  for (size_t i=0;i<len;i++) crc = (crc >> 8) ^ CRC32_TABLE[(crc ^ data[i]) & 0xFFu];
   return ~crc;
 }
 
+// ------------------- Trig Tables -------------------
+// sin() at whole degrees over a quarter wave; everything else is folded onto it and
+// linearly interpolated (max error ~4e-5, far below servo resolution).
+static const float SIN_DEG_TABLE[91] = {
+  0.0000000f, 0.0174524f, 0.0348995f, 0.0523360f, 0.0697565f, 0.0871557f,
+  0.1045285f, 0.1218693f, 0.1391731f, 0.1564345f, 0.1736482f, 0.1908090f,
+  0.2079117f, 0.2249511f, 0.2419219f, 0.2588190f, 0.2756374f, 0.2923717f,
+  0.3090170f, 0.3255682f, 0.3420201f, 0.3583679f, 0.3746066f, 0.3907311f,
+  0.4067366f, 0.4226183f, 0.4383711f, 0.4539905f, 0.4694716f, 0.4848096f,
+  0.5000000f, 0.5150381f, 0.5299193f, 0.5446390f, 0.5591929f, 0.5735764f,
+  0.5877853f, 0.6018150f, 0.6156615f, 0.6293204f, 0.6427876f, 0.6560590f,
+  0.6691306f, 0.6819984f, 0.6946584f, 0.7071068f, 0.7193398f, 0.7313537f,
+  0.7431448f, 0.7547096f, 0.7660444f, 0.7771460f, 0.7880108f, 0.7986355f,
+  0.8090170f, 0.8191520f, 0.8290376f, 0.8386706f, 0.8480481f, 0.8571673f,
+  0.8660254f, 0.8746197f, 0.8829476f, 0.8910065f, 0.8987940f, 0.9063078f,
+  0.9135455f, 0.9205049f, 0.9271839f, 0.9335804f, 0.9396926f, 0.9455186f,
+  0.9510565f, 0.9563048f, 0.9612617f, 0.9659258f, 0.9702957f, 0.9743701f,
+  0.9781476f, 0.9816272f, 0.9848078f, 0.9876883f, 0.9902681f, 0.9925462f,
+  0.9945219f, 0.9961947f, 0.9975641f, 0.9986295f, 0.9993908f, 0.9998477f,
+  1.0000000f
+};
+
+static float sinDeg(float deg) {
+  deg = fmodf(deg, 360.0f);
+  if (deg < 0) deg += 360.0f;
+  float sign = 1.0f;
+  if (deg >= 180.0f) { deg -= 180.0f; sign = -1.0f; }
+  if (deg > 90.0f) deg = 180.0f - deg;
+  int i = (int)deg;
+  if (i >= 90) return sign;
+  float f = deg - (float)i;
+  return sign * (SIN_DEG_TABLE[i] + (SIN_DEG_TABLE[i+1] - SIN_DEG_TABLE[i]) * f);
+}
+
+static float cosDeg(float deg) { return sinDeg(deg + 90.0f); }
+
+// Polynomial atan on [0,1] folded into all octants; max error ~0.0006 deg.
+static float atan2Deg(float y, float x) {
+  float ax = fabsf(x), ay = fabsf(y);
+  if (ax == 0.0f && ay == 0.0f) return 0.0f;
+  bool steep = ay > ax;
+  float a = steep ? ax / ay : ay / ax;
+  float s = a * a;
+  float r = a * (0.9998660f + s * (-0.3302995f + s * (0.1801410f + s * (-0.0851330f + s * 0.0208351f))));
+  if (steep) r = 1.5707963f - r;
+  if (x < 0.0f) r = 3.1415927f - r;
+  if (y < 0.0f) r = -r;
+  return r * 57.2957795f;
+}
+
+// ------------------- Scratch Arena -------------------
+// Bulky per-command scratch (compiled macro code) comes from one fixed bump arena
+// instead of the heap. handleCommandLine rewinds to its entry mark on return, so a
+// macro step run inside a command only frees its own allocations.
+static const uint16_t SCRATCH_BYTES = PanTiltBuild::scratchBytes;
+static uint8_t g_scratch[SCRATCH_BYTES] __attribute__((aligned(4)));
+static uint16_t g_scratchTop = 0;
+static uint16_t g_scratchHigh = 0;
+static uint32_t g_scratchOverflows = 0;
+
+static void* scratchAlloc(uint16_t n) {
+  n = (uint16_t)((n + 3) & ~3);
+  if (n > SCRATCH_BYTES - g_scratchTop) { g_scratchOverflows++; return nullptr; }
+  void* p = &g_scratch[g_scratchTop];
+  g_scratchTop += n;
+  if (g_scratchTop > g_scratchHigh) g_scratchHigh = g_scratchTop;
+  return p;
+}
+
+struct ScratchScope {
+  uint16_t mark;
+  ScratchScope() : mark(g_scratchTop) {}
+  ~ScratchScope() { g_scratchTop = mark; }
+};
+
 // ------------------- Minimal JSON Helpers (same as your sketch) -------------------
+// These read the line in place: no key patterns, substrings or temporary buffers.
+// findKey only matches a key of the outer object (a quoted token followed by ':'), so a
+// string value such as "name":"at" or a key inside a nested object never answers for it.
 static bool findKey(const String& s, const char* key, int& keyPos) {
-  String pat = "\""; pat += key; pat += "\"";
-  keyPos = s.indexOf(pat);
-  return keyPos >= 0;
+  const char* base = s.c_str();
+  size_t kl = strlen(key);
+  int depth = 0;
+  for (const char* p = base; *p; p++) {
+    char c = *p;
+    if (c == '{' || c == '[') { depth++; continue; }
+    if (c == '}' || c == ']') { depth--; continue; }
+    if (c != '"') continue;
+
+    const char* q = p + 1;
+    while (*q && *q != '"') q += (*q == '\\' && q[1]) ? 2 : 1;
+    if (!*q) return false;
+    const char* after = q + 1;
+    while (*after == ' ' || *after == '\t') after++;
+    if (*after == ':' && depth <= 1 && (size_t)(q - p - 1) == kl && !strncmp(p + 1, key, kl)) {
+      keyPos = (int)(p - base);
+      return true;
+    }
+    p = q;
+  }
+  return false;
 }
 
 static bool getStringField(const String& s, const char* key, String& out) {
@@ -240,20 +460,25 @@ static bool getStringField(const String& s, const char* key, String& out) {
   int q1 = s.indexOf('"', colon + 1);
   if (q1 < 0) return false;
 
-  String tmp;
-  tmp.reserve(128);
-
-  bool esc = false;
-  for (int i = q1 + 1; i < (int)s.length(); i++) {
-    char c = s[i];
-
-    if (esc) { tmp += c; esc = false; continue; }
-    if (c == '\\') { esc = true; continue; }
-    if (c == '"') { out = tmp; return true; }
-
-    tmp += c;
+  // Find the closing quote first so out is untouched on a malformed line
+  const char* p = s.c_str();
+  int n = (int)s.length();
+  int e = q1 + 1;
+  bool escaped = false;
+  for (; e < n; e++) {
+    if (p[e] == '\\') { escaped = true; e++; continue; }
+    if (p[e] == '"') break;
   }
-  return false;
+  if (e >= n) return false;
+
+  out = "";   // keeps out's buffer
+  if (!escaped) { out.concat(p + q1 + 1, (unsigned)(e - q1 - 1)); return true; }
+  out.reserve((unsigned)(e - q1));
+  for (int i = q1 + 1; i < e; i++) {
+    if (p[i] == '\\') i++;
+    out += p[i];
+  }
+  return true;
 }
 
 static bool getNumberField(const String& s, const char* key, float& out) {
@@ -272,10 +497,22 @@ static bool getNumberField(const String& s, const char* key, float& out) {
     j++;
   }
   if (j <= i) return false;
-  out = s.substring(i, j).toFloat();
+  out = strtof(s.c_str() + i, nullptr);
   return true;
 }
 
+// Host timestamps (epoch ms) need more digits than a float holds.
+static bool getDoubleField(const String& s, const char* key, double& out) {
+  int kp;
+  if (!findKey(s, key, kp)) return false;
+  int colon = s.indexOf(':', kp);
+  if (colon < 0) return false;
+  const char* p = s.c_str() + colon + 1;
+  char* end;
+  out = strtod(p, &end);
+  return end != p;
+}
+
 static bool getIntField(const String& s, const char* key, int& out) {
   float tmp;
   if (!getNumberField(s, key, tmp)) return false;
@@ -297,70 +534,138 @@ static bool getBoolField(const String& s, const char* key, bool& out) {
   return false;
 }
 
-static String unescapeScript(const String& in) {
-  String out; out.reserve(in.length());
-  for (int i=0;i<(int)in.length();i++) {
-    char c = in[i];
+// Flat number array, "key":[1,-2.5,3]. False if missing, malformed or longer than cap.
+static bool getNumberArray(const String& s, const char* key, float* out, uint8_t cap, uint8_t& n) {
+  int kp;
+  if (!findKey(s, key, kp)) return false;
+  int colon = s.indexOf(':', kp);
+  if (colon < 0) return false;
+
+  const char* p = s.c_str() + colon + 1;
+  while (*p == ' ' || *p == '\t') p++;
+  if (*p++ != '[') return false;
+  n = 0;
+  while (true) {
+    while (*p == ' ' || *p == '\t') p++;
+    if (*p == ']') return true;
+    if (n >= cap) return false;
+    char* end;
+    out[n] = strtof(p, &end);
+    if (end == p) return false;
+    n++;
+    p = end;
+    while (*p == ' ' || *p == '\t') p++;
+    if (*p == ',') p++;
+    else if (*p != ']') return false;
+  }
+}
+
+// Decodes in place: the result is never longer than the input.
+static void unescapeScript(String& s) {
+  int n = (int)s.length();
+  int w = 0;
+  for (int i=0;i<n;i++) {
+    char c = s[i];
 
-    if (c == '\\' && i+1 < (int)in.length()) {
-      char n = in[i+1];
+    if (c == '\\' && i+1 < n) {
+      char nx = s[i+1];
 
-      if (n == 'n') { out += '\n'; i++; continue; }
-      if (n == 'r') { out += '\r'; i++; continue; }
-      if (n == 't') { out += '\t'; i++; continue; }
+      if (nx == 'n') { s.setCharAt(w++, '\n'); i++; continue; }
+      if (nx == 'r') { s.setCharAt(w++, '\r'); i++; continue; }
+      if (nx == 't') { s.setCharAt(w++, '\t'); i++; continue; }
 
-      if (n == '\\' && i+2 < (int)in.length()) {
-        char n2 = in[i+2];
-        if (n2 == 'n') { out += '\n'; i += 2; continue; }
-        if (n2 == 'r') { out += '\r'; i += 2; continue; }
-        if (n2 == 't') { out += '\t'; i += 2; continue; }
-        if (n2 == '\\') { out += '\\'; i += 2; continue; }
+      if (nx == '\\' && i+2 < n) {
+        char n2 = s[i+2];
+        if (n2 == 'n') { s.setCharAt(w++, '\n'); i += 2; continue; }
+        if (n2 == 'r') { s.setCharAt(w++, '\r'); i += 2; continue; }
+        if (n2 == 't') { s.setCharAt(w++, '\t'); i += 2; continue; }
+        if (n2 == '\\') { s.setCharAt(w++, '\\'); i += 2; continue; }
       }
 
-      if (n == '\\') { out += '\\'; i++; continue; }
-      if (n == '/')  { out += '/';  i++; continue; }
-      if (n == '\"') { out += '\"'; i++; continue; }
+      if (nx == '\\') { s.setCharAt(w++, '\\'); i++; continue; }
+      if (nx == '/')  { s.setCharAt(w++, '/');  i++; continue; }
+      if (nx == '\"') { s.setCharAt(w++, '\"'); i++; continue; }
     }
 
-    out += c;
+    s.setCharAt(w++, c);
   }
-  return out;
+  s.remove(w);
 }
 
 // ------------------- Reply Helpers (now JSON-only + mirrored) -------------------
-static void sendOk(uint32_t id, const String& subsystem, const String& route, bool mirror, const char* msg) {
-  String out;
-  out.reserve(160);
+// Acks, state and motion events are built in one long-lived String: assigning "" keeps
+// its buffer, so steady-state replies don't allocate. Only leaf senders may use it.
+static String g_replyLine;
+
+static String& replyLine(unsigned cap) {
+  g_replyLine = "";
+  g_replyLine.reserve(cap);
+  return g_replyLine;
+}
+
+static void replayCapture(uint32_t id, bool ok, const char* text) {
+  ReplayCapture& c = g_replayCap;
+  if (!c.armed || c.got || id != c.id) return;
+  c.got = true;
+  c.ok = ok;
+  strncpy(c.text, text, REPLAY_TEXT - 1);
+  c.text[REPLAY_TEXT - 1] = 0;
+}
+
+static void sendOk(uint32_t id, const String& subsystem, const String& route, PanTiltLink mirror, const char* msg, ReplyKind rk = RK_OK) {
+  replayCapture(id, true, msg);
+  if (rk == RK_OK && id && sinkWants(PanTiltMsg::Ack, mirror, RK_TINY)) {
+    String& tiny = replyLine(24);
+    tiny += "{\"ok\":1,\"id\":";
+    tiny += String(id);
+    tiny += "}";
+    emitLine(PanTiltMsg::Ack, tiny, mirror, RK_TINY);
+  }
+  if (!sinkWants(PanTiltMsg::Ack, mirror, rk)) return;
+  String& out = replyLine(160);
   out += "{\"ok\":true,\"id\":";
   out += String(id);
   appendRoutingFields(out, subsystem, route);
   out += ",\"msg\":\"";
-  out += jsonEscape(String(msg));
+  appendJsonEscaped(out, msg);
   out += "\"}";
-  emitLine(out, mirror);
+  emitLine(PanTiltMsg::Ack, out, mirror, rk);
 }
 
-static void sendErr(uint32_t id, const String& subsystem, const String& route, bool mirror, const char* code, const char* msg) {
-  String out;
-  out.reserve(200);
+static void sendErr(uint32_t id, const String& subsystem, const String& route, PanTiltLink mirror, const char* code, const char* msg) {
+  replayCapture(id, false, code);
+  if (!sinkWants(PanTiltMsg::Fault, mirror, RK_FAULT)) return;
+  String& out = replyLine(200);
   out += "{\"ok\":false,\"id\":";
   out += String(id);
   appendRoutingFields(out, subsystem, route);
   out += ",\"error\":\"";
-  out += jsonEscape(String(code));
+  appendJsonEscaped(out, code);
   out += "\",\"msg\":\"";
-  out += jsonEscape(String(msg));
+  appendJsonEscaped(out, msg);
   out += "\"}";
-  emitLine(out, mirror);
+  emitLine(PanTiltMsg::Fault, out, mirror, RK_FAULT);
 }
 
-static void sendState(const char* eventName, uint32_t ref, const String& subsystem, const String& route, bool mirror) {
-  String out;
-  out.reserve(360);
+// Scratch arena and heap watermarks, for spotting slow fragmentation on long runs.
+static void appendMemStats(String& out) {
+  out += ",\"mem\":{";
+  out += "\"arena\":"; out += String(SCRATCH_BYTES);
+  out += ",\"arenaHigh\":"; out += String(g_scratchHigh);
+  out += ",\"arenaOverflows\":"; out += String(g_scratchOverflows);
+  out += ",\"heapFree\":"; out += String(ESP.getFreeHeap());
+  out += ",\"heapMin\":"; out += String(ESP.getMinFreeHeap());
+  out += ",\"heapMaxBlock\":"; out += String(ESP.getMaxAllocHeap());
+  out += "}";
+}
+
+void PanTiltRig::sendState(const char* eventName, uint32_t ref, const String& subsystem, const String& route, PanTiltLink mirror, ReplyKind rk) {
+  if (!sinkWants(PanTiltMsg::Ack, mirror, rk)) return;
+  String& out = replyLine(360);
   out += "{\"ok\":true";
   if (eventName) {
     out += ",\"event\":\"";
-    out += jsonEscape(String(eventName));
+    appendJsonEscaped(out, eventName);
     out += "\"";
   }
   if (ref) {
@@ -377,93 +682,107 @@ static void sendState(const char* eventName, uint32_t ref, const String& subsyst
   out += ",\"speed\":"; out += String(defaultSpeed, 2);
 
   out += ",\"moving\":{";
-  out += "\"x\":"; out += (mx.active ? "true" : "false");
-  out += ",\"y\":"; out += (my.active ? "true" : "false");
+  out += "\"x\":"; out += ((mx.active || jog.x.active || (pat.active && pat.useX) || blendSeg.active) ? "true" : "false");
+  out += ",\"y\":"; out += ((my.active || jog.y.active || (pat.active && pat.useY) || blendSeg.active) ? "true" : "false");
   out += "}";
 
   out += ",\"queue\":{";
   out += "\"mode\":\"";
-  out += (qMode==Q_OFF ? "off" : (qMode==Q_ON ? "on" : "step"));
+  out += queueModeName(qMode);
   out += "\"";
+  out += ",\"lanes\":\""; out += (qLanes==QL_AXIS ? "axis" : "single"); out += "\"";
   out += ",\"count\":"; out += String(qCount);
-  out += ",\"active\":"; out += (qActive ? "true" : "false");
+  out += ",\"active\":"; out += (qAnyActive() ? "true" : "false");
   out += "}";
 
+  out += ",\"macros\":"; out += String(macroActiveCount());
   out += ",\"cfgDirty\":"; out += (cfgDirty ? "true" : "false");
+  out += ",\"persist\":{";
+  out += "\"dirty\":"; out += String(cfgDirty);
+  out += ",\"writes\":"; out += String(persistStats.writes);
+  out += ",\"skipped\":"; out += String(persistStats.skipped);
+  out += ",\"commits\":"; out += String(persistStats.commits);
+  out += ",\"autosaves\":"; out += String(persistStats.autosaves);
+  out += ",\"failures\":"; out += String(persistStats.failures);
+  out += ",\"autosaveMs\":"; out += String(autosaveMs);
+  out += "}";
+  if (rk == RK_DATA) appendMemStats(out);   // queries only; events stay short
   out += "}}";
 
-  emitLine(out, mirror);
+  emitLine(PanTiltMsg::Ack, out, mirror, rk);
 }
 
-static void sendEventDoneAxis(char axis, uint32_t ref, const String& subsystem, const String& route, bool mirror) {
-  String out;
-  out.reserve(140);
+static void sendEventDoneAxis(char axis, uint32_t ref, const String& subsystem, const String& route, PanTiltLink mirror) {
+  if (!sinkWants(PanTiltMsg::Motion, mirror, RK_DONE)) return;
+  String& out = replyLine(140);
   out += "{\"ok\":true,\"event\":\"done\",\"axis\":\"";
   out += axis;
   out += "\",\"ref\":";
   out += String(ref);
   appendRoutingFields(out, subsystem, route);
   out += "}";
-  emitLine(out, mirror);
+  emitLine(PanTiltMsg::Motion, out, mirror, RK_DONE);
 }
 
 static void sendEventStarted(const QueueItem& it) {
-  String out;
-  out.reserve(260);
+  if (!sinkWants(PanTiltMsg::Motion, it.mirrorToBle, RK_STARTED)) return;
+  String& out = replyLine(260);
   out += "{\"ok\":true,\"event\":\"started\",\"ref\":";
   out += String(it.id);
   appendRoutingFields(out, it.subsystem, it.route);
+  if (it.timed) { out += ",\"lateUs\":"; out += String((long)(int32_t)(micros() - it.dueUs)); }
   out += ",\"step\":{";
-  out += "\"kind\":\""; out += jsonEscape(it.kind); out += "\"";
+  out += "\"kind\":\""; out += it.kind; out += "\"";
   out += ",\"axis\":\"";
   out += (it.useX && it.useY) ? "xy" : (it.useX ? "x" : "y");
   out += "\"";
-  if (it.useX) { out += ",\"x\":"; out += String(it.tx, 2); }
-  if (it.useY) { out += ",\"y\":"; out += String(it.ty, 2); }
+  if (it.useX && !it.barrier) { out += ",\"x\":"; out += String(it.tx, 2); }
+  if (it.useY && !it.barrier) { out += ",\"y\":"; out += String(it.ty, 2); }
   out += ",\"dx\":"; out += String(it.dx);
   out += ",\"dy\":"; out += String(it.dy);
   out += "}}";
-  emitLine(out, it.mirrorToBle);
+  emitLine(PanTiltMsg::Motion, out, it.mirrorToBle, RK_STARTED);
 }
 
 static void sendEventStepDone(const QueueItem& it) {
-  String out;
-  out.reserve(120);
+  if (!sinkWants(PanTiltMsg::Motion, it.mirrorToBle, RK_DONE)) return;
+  String& out = replyLine(120);
   out += "{\"ok\":true,\"event\":\"stepDone\",\"ref\":";
   out += String(it.id);
   appendRoutingFields(out, it.subsystem, it.route);
   out += "}";
-  emitLine(out, it.mirrorToBle);
+  emitLine(PanTiltMsg::Motion, out, it.mirrorToBle, RK_DONE);
 }
 
-static void sendEventFault(const String& subsystem, const String& route, bool mirror, const char* code, uint32_t ref, const char* msg) {
-  String out;
-  out.reserve(220);
+static void sendEventFault(const String& subsystem, const String& route, PanTiltLink mirror, const char* code, uint32_t ref, const char* msg) {
+  if (!sinkWants(PanTiltMsg::Fault, mirror, RK_FAULT)) return;
+  String& out = replyLine(220);
   out += "{\"ok\":false,\"event\":\"fault\",\"error\":\"";
-  out += jsonEscape(String(code));
+  appendJsonEscaped(out, code);
   out += "\",\"ref\":";
   out += String(ref);
   appendRoutingFields(out, subsystem, route);
   out += ",\"msg\":\"";
-  out += jsonEscape(String(msg));
+  appendJsonEscaped(out, msg);
   out += "\"}";
-  emitLine(out, mirror);
+  emitLine(PanTiltMsg::Fault, out, mirror, RK_FAULT);
 }
 
 // ------------------- Queue Ops -------------------
-static bool qIsFull() { return qCount >= QMAX; }
-static bool qIsEmpty() { return qCount == 0; }
+bool PanTiltRig::qIsFull() { return qCount >= QMAX; }
+bool PanTiltRig::qIsEmpty() { return qCount == 0; }
 
-static bool qEnqueue(const QueueItem& it) {
+bool PanTiltRig::qEnqueue(const QueueItem& it) {
   if (qIsFull()) return false;
   q[qTail] = it;
   q[qTail].used = true;
+  if (schedReleasing) { q[qTail].timed = true; q[qTail].dueUs = schedDueUs; }
   qTail = (uint8_t)((qTail + 1) % QMAX);
   qCount++;
   return true;
 }
 
-static bool qDequeue(QueueItem& out) {
+bool PanTiltRig::qDequeue(QueueItem& out) {
   if (qIsEmpty()) return false;
   out = q[qHead];
   q[qHead].used = false;
@@ -472,25 +791,39 @@ static bool qDequeue(QueueItem& out) {
   return true;
 }
 
-static void qClearAll() {
+// Removes the i-th pending item (0 = head), keeping the order of the rest.
+void PanTiltRig::qRemoveAt(uint8_t i) {
+  if (i >= qCount) return;
+  for (uint8_t k=i; k+1<qCount; k++) {
+    uint8_t dst = (uint8_t)((qHead + k) % QMAX);
+    uint8_t src = (uint8_t)((qHead + k + 1) % QMAX);
+    q[dst] = q[src];
+  }
+  qTail = (uint8_t)((qTail + QMAX - 1) % QMAX);
+  q[qTail].used = false;
+  qCount--;
+}
+
+void PanTiltRig::qClearAll() {
   for (uint8_t i=0;i<QMAX;i++) q[i].used = false;
   qHead = qTail = qCount = 0;
 }
 
-static void stopX() { mx.active = false; mx.durMs = 0; }
-static void stopY() { my.active = false; my.durMs = 0; }
-static void stopAllMotion() { stopX(); stopY(); }
+void PanTiltRig::stopX() { mx.active = false; mx.durMs = 0; jog.x = JogAxis{}; if (pat.useX) stopPattern(); stopBlend(); }
+void PanTiltRig::stopY() { my.active = false; my.durMs = 0; jog.y = JogAxis{}; if (pat.useY) stopPattern(); stopBlend(); }
+void PanTiltRig::stopAllMotion() { stopX(); stopY(); }
 
-static void abortQueueAndMotion() {
+void PanTiltRig::abortQueueAndMotion() {
   stopAllMotion();
   qClearAll();
-  qActive = false;
-  qCurXDone = qCurYDone = true;
+  qDeactivateLanes();
 }
 
 // ------------------- Motion Start -------------------
-static void startMoveX(float target, uint32_t durMs, uint32_t ref) {
-  target = clampf(target, POS_MIN, POS_MAX);
+void PanTiltRig::startMoveX(float target, uint32_t durMs, uint32_t ref) {
+  target = clampf(target, limits.minX, limits.maxX);
+  jog.x = JogAxis{};   // a positioned move takes the axis over
+  if (pat.useX) stopPattern();
   if (durMs == 0) { v1 = target; mx.active = false; mx.durMs = 0; return; }
   mx.active = true;
   mx.start = v1;
@@ -501,8 +834,10 @@ static void startMoveX(float target, uint32_t durMs, uint32_t ref) {
   mx.axis = 'x';
 }
 
-static void startMoveY(float target, uint32_t durMs, uint32_t ref) {
-  target = clampf(target, POS_MIN, POS_MAX);
+void PanTiltRig::startMoveY(float target, uint32_t durMs, uint32_t ref) {
+  target = clampf(target, limits.minY, limits.maxY);
+  jog.y = JogAxis{};   // a positioned move takes the axis over
+  if (pat.useY) stopPattern();
   if (durMs == 0) { v2 = target; my.active = false; my.durMs = 0; return; }
   my.active = true;
   my.start = v2;
@@ -513,16 +848,202 @@ static void startMoveY(float target, uint32_t durMs, uint32_t ref) {
   my.axis = 'y';
 }
 
-static void executeStep(const QueueItem& it) {
+void PanTiltRig::startStepAxes(const QueueItem& it) {
+  if (it.barrier) return;
+  float tx = it.useX ? clampf(it.tx, limits.minX, limits.maxX) : v1;
+  float ty = it.useY ? clampf(it.ty, limits.minY, limits.maxY) : v2;
+  uint32_t dx = it.useX ? it.dx : 0, dy = it.useY ? it.dy : 0;
+  if (clipPath(v1, v2, tx, ty, dx, dy))
+    sendEventFault(it.subsystem, it.route, it.mirrorToBle, "keep_out", it.id, "Path crosses a keep-out zone; move clipped at its edge");
+  if (it.useX) startMoveX(tx, dx, it.id);
+  if (it.useY) startMoveY(ty, dy, it.id);
+  applyOutputs();
+}
+
+void PanTiltRig::executeStep(const QueueItem& it) {
   stopAllMotion();
+  startStepAxes(it);
+  if (schedReleasing) {   // queued steps report from startLane instead
+    QueueItem t = it;
+    t.timed = true;
+    t.dueUs = schedDueUs;
+    sendEventStarted(t);
+  }
+}
+
+// ------------------- Blend Planner -------------------
+// Lookahead planner for Q_BLEND: each queued step becomes a straight (x,y) segment with
+// a trapezoidal speed profile. Junction speeds come from the corner angle and tolerance
+// (same junction-deviation rule CNC planners use), then a backward/forward pass over the
+// next blendLookahead steps keeps every junction reachable and able to stop by the end of
+// the window. Steps that don't move (dwell) are plain holds with zero entry/exit speed.
+static const float BLEND_MAX_SPEED = 1000.0f;
+
+void PanTiltRig::stopBlend() {
+  blendSeg.active = false;
+  blendCarryValid = false;
+  blendCarryV = 0.0f;
+}
+
+static BlendPlanSeg makePlanSeg(const QueueItem& it, float& px, float& py) {
+  BlendPlanSeg ps{};
+  float ex = it.useX ? it.tx : px;
+  float ey = it.useY ? it.ty : py;
+  float dx = ex - px, dy = ey - py;
+  ps.len = (it.barrier) ? 0.0f : sqrtf(dx*dx + dy*dy);
+  if (ps.len > 1e-4f) { ps.ux = dx / ps.len; ps.uy = dy / ps.len; }
+  else ps.len = 0.0f;
+
+  uint32_t durMs = 0;
+  if (it.useX && it.dx > durMs) durMs = it.dx;
+  if (it.useY && it.dy > durMs) durMs = it.dy;
+  ps.vNom = (durMs > 0) ? (ps.len * 1000.0f / (float)durMs) : BLEND_MAX_SPEED;
+  if (ps.vNom > BLEND_MAX_SPEED) ps.vNom = BLEND_MAX_SPEED;
+  if (ps.vNom < 0.01f) ps.vNom = 0.01f;
+
+  px = ex; py = ey;
+  return ps;
+}
+
+float PanTiltRig::junctionSpeed(const BlendPlanSeg& a, const BlendPlanSeg& b) {
+  if (a.len <= 0.0f || b.len <= 0.0f) return 0.0f;
+  float vmax = (a.vNom < b.vNom) ? a.vNom : b.vNom;
+  float cosTheta = -(a.ux * b.ux + a.uy * b.uy);
+  if (cosTheta > 0.999999f) return 0.0f;      // full reversal
+  if (cosTheta < -0.999999f) return vmax;     // straight through
+  float sinHalf = sqrtf(0.5f * (1.0f - cosTheta));
+  float v = sqrtf(blendAccel * blendCorner * sinHalf / (1.0f - sinHalf));
+  return (v < vmax) ? v : vmax;
+}
+
+// Exit speed for `it` (about to start at px,py with speed vEntry) given what's queued behind it.
+float PanTiltRig::planBlendExit(const QueueItem& it, float px, float py, float vEntry, BlendPlanSeg& first) {
+  BlendPlanSeg segs[QMAX + 1];
+  float junc[QMAX + 1];
+  uint8_t n = 0;
+
+  segs[n++] = makePlanSeg(it, px, py);
+  uint8_t look = blendLookahead;
+  for (uint8_t i=0; i<qCount && n<look; i++) {
+    const QueueItem& nx = q[(uint8_t)((qHead + i) % QMAX)];
+    segs[n++] = makePlanSeg(nx, px, py);
+  }
+  first = segs[0];
+
+  // junc[i] = speed at the end of segment i; the window always ends at rest.
+  for (uint8_t i=0; i+1<n; i++) junc[i] = junctionSpeed(segs[i], segs[i+1]);
+  junc[n-1] = 0.0f;
+
+  // Backward pass: each junction must be able to decelerate to the next one.
+  for (int i=(int)n-2; i>=0; i--) {
+    float reach = sqrtf(junc[i+1]*junc[i+1] + 2.0f * blendAccel * segs[i+1].len);
+    if (junc[i] > reach) junc[i] = reach;
+  }
+
+  // Forward pass, first segment only: can't exit faster than we can accelerate to.
+  float reach = sqrtf(vEntry*vEntry + 2.0f * blendAccel * segs[0].len);
+  return (junc[0] < reach) ? junc[0] : reach;
+}
+
+void PanTiltRig::startBlendSegment(const QueueItem& it) {
+  uint32_t now = millis();
+  float vEntry = 0.0f;
+  uint32_t t0 = now;
+  if (blendCarryValid) {
+    vEntry = blendCarryV;
+    t0 = blendCarryT;
+    if ((int32_t)(now - t0) > 50 || (int32_t)(now - t0) < 0) { t0 = now; vEntry = 0.0f; }
+  }
+  blendCarryValid = false;
+
+  BlendPlanSeg ps;
+  float vExit = planBlendExit(it, v1, v2, vEntry, ps);
+
+  BlendSeg& b = blendSeg;
+  b = BlendSeg();
+  b.x0 = v1; b.y0 = v2;
+  b.t0 = t0;
+
+  if (ps.len <= 0.0f) {
+    uint32_t durMs = 0;
+    if (it.useX && it.dx > durMs) durMs = it.dx;
+    if (it.useY && it.dy > durMs) durMs = it.dy;
+    b.holdMs = it.barrier ? 0 : durMs;
+    b.totalMs = b.holdMs;
+    b.active = true;
+    return;
+  }
+
+  const float a = blendAccel;
+  float vN = ps.vNom;
+  if (vEntry > vN) vN = vEntry;
+  if (vExit > vN) vExit = vN;
+
+  float dAcc = (vN*vN - vEntry*vEntry) / (2.0f*a);
+  float dDec = (vN*vN - vExit*vExit) / (2.0f*a);
+  float vP = vN;
+  if (dAcc + dDec > ps.len) {
+    vP = sqrtf((2.0f*a*ps.len + vEntry*vEntry + vExit*vExit) * 0.5f);
+    if (vP < vEntry) vP = vEntry;
+    if (vP < vExit) vP = vExit;
+    dAcc = (vP*vP - vEntry*vEntry) / (2.0f*a);
+    dDec = ps.len - dAcc;
+    if (dDec < 0.0f) dDec = 0.0f;
+  }
+  float dCruise = ps.len - dAcc - dDec;
+  if (dCruise < 0.0f) dCruise = 0.0f;
+
+  b.ux = ps.ux; b.uy = ps.uy;
+  b.len = ps.len;
+  b.vEntry = vEntry; b.vPeak = vP; b.vExit = vExit;
+  b.tAcc = (vP - vEntry) / a;
+  b.tCruise = (vP > 0.0f) ? dCruise / vP : 0.0f;
+  b.tDec = (vP - vExit) / a;
+  b.totalMs = (uint32_t)((b.tAcc + b.tCruise + b.tDec) * 1000.0f + 0.5f);
+  b.active = true;
+}
 
-  qCurXDone = !it.useX || (it.dx == 0);
-  qCurYDone = !it.useY || (it.dy == 0);
+// Advances the active segment; returns true on the tick it completes.
+bool PanTiltRig::updateBlend(uint32_t now) {
+  BlendSeg& b = blendSeg;
+  if (!b.active) return false;
 
-  if (it.useX) startMoveX(it.tx, it.dx, it.id);
-  if (it.useY) startMoveY(it.ty, it.dy, it.id);
+  uint32_t elapsed = now - b.t0;
+  if ((int32_t)elapsed < 0) elapsed = 0;
 
+  if (elapsed >= b.totalMs) {
+    if (b.len > 0.0f) {
+      v1 = b.x0 + b.ux * b.len;
+      v2 = b.y0 + b.uy * b.len;
+      applyOutputs();
+    }
+    b.active = false;
+    blendCarryV = b.vExit;
+    blendCarryT = b.t0 + b.totalMs;
+    blendCarryValid = b.vExit > 0.0f;
+    return true;
+  }
+  if (b.len <= 0.0f) return false;
+
+  float t = (float)elapsed / 1000.0f;
+  float sPos;
+  if (t < b.tAcc) {
+    sPos = b.vEntry*t + 0.5f*blendAccel*t*t;
+  } else if (t < b.tAcc + b.tCruise) {
+    float tc = t - b.tAcc;
+    sPos = (b.vEntry + b.vPeak) * 0.5f * b.tAcc + b.vPeak*tc;
+  } else {
+    float td = t - b.tAcc - b.tCruise;
+    if (td > b.tDec) td = b.tDec;
+    sPos = (b.vEntry + b.vPeak) * 0.5f * b.tAcc + b.vPeak*b.tCruise + b.vPeak*td - 0.5f*blendAccel*td*td;
+  }
+  if (sPos > b.len) sPos = b.len;
+  if (sPos < 0.0f) sPos = 0.0f;
+
+  v1 = b.x0 + b.ux * sPos;
+  v2 = b.y0 + b.uy * sPos;
   applyOutputs();
+  return false;
 }
 
 // ------------------- Parsing Helpers -------------------
@@ -534,7 +1055,7 @@ static bool parseAxisMask(const String& axis, bool& useX, bool& useY) {
   return false;
 }
 
-static bool computeDurations(
+bool PanTiltRig::computeDurations(
   bool useX, bool useY,
   float tx, float ty,
   bool hasDur, float durSec,
@@ -557,68 +1078,85 @@ static bool computeDurations(
   return true;
 }
 
-static QueueItem buildStepFromCommand(
-  uint32_t id,
-  const String& subsystem,
-  const String& route,
+static const char* motionKindName(MotionKind k) {
+  switch (k) {
+    case MK_ADJUST: return "adjust";
+    case MK_CENTER: return "center";
+    default: return "set";
+  }
+}
+
+static bool motionTimingValid(const MotionArgs& a) {
+  if (a.hasDur) return a.durSec >= 0.0f && a.durSec <= 3600.0f;
+  if (a.hasSpeed) return a.speed >= 0.1f && a.speed <= 1000.0f;
+  return true;
+}
+
+static bool parseMotionArgs(
   const String& cmd,
   const String& axis,
   const String& line,
-  bool& ok,
-  String& errCode,
-  String& errMsg
+  MotionArgs& a,
+  const char*& errCode,
+  const char*& errMsg
 ) {
-  ok = false;
-  QueueItem it;
-  it.id = id;
-  it.subsystem = subsystem;
-  it.route = route;
-  it.kind = cmd;
+  if (cmd == "set") a.kind = MK_SET;
+  else if (cmd == "adjust") a.kind = MK_ADJUST;
+  else if (cmd == "center") a.kind = MK_CENTER;
+  else { errCode="unknown_cmd"; errMsg="Unknown motion cmd"; return false; }
 
-  bool useX=false, useY=false;
-  if (!parseAxisMask(axis, useX, useY)) {
+  if (!parseAxisMask(axis, a.useX, a.useY)) {
     errCode = "bad_axis"; errMsg = "axis must be x, y, or xy";
-    return it;
+    return false;
   }
-  it.useX = useX; it.useY = useY;
 
-  float durSec = -1.0f;
-  float speed = -1.0f;
-  bool hasDur = getNumberField(line, "dur", durSec);
-  bool hasSpeed = getNumberField(line, "speed", speed);
+  a.hasDur = getNumberField(line, "dur", a.durSec);
+  a.hasSpeed = getNumberField(line, "speed", a.speed);
 
-  float tx=v1, ty=v2;
+  if (a.kind == MK_CENTER) return true;
 
-  if (cmd == "center") {
-    tx = 0.0f; ty = 0.0f;
-  } else if (cmd == "set" || cmd == "adjust") {
-    float val=0, xVal=0, yVal=0;
-    bool hasValue = getNumberField(line, "value", val);
-    bool hasX = getNumberField(line, "x", xVal);
-    bool hasY = getNumberField(line, "y", yVal);
-
-    String a = axis; a.toLowerCase();
-    if (a == "xy") {
-      if (!hasX && !hasY && !hasValue) {
-        errCode="missing_value"; errMsg="For axis=xy provide x and/or y (or value for both)";
-        return it;
-      }
-      if (hasValue) { xVal = val; yVal = val; hasX = true; hasY = true; }
-      if (cmd == "set") {
-        if (hasX) tx = xVal;
-        if (hasY) ty = yVal;
-      } else {
-        if (hasX) tx = v1 + xVal;
-        if (hasY) ty = v2 + yVal;
-      }
-    } else {
-      if (!hasValue) { errCode="missing_value"; errMsg="Provide: value (degrees)"; return it; }
-      if (a == "x") tx = (cmd=="set") ? val : (v1 + val);
-      else          ty = (cmd=="set") ? val : (v2 + val);
+  float val=0;
+  bool hasValue = getNumberField(line, "value", val);
+  if (a.useX && a.useY) {
+    a.hasX = getNumberField(line, "x", a.x);
+    a.hasY = getNumberField(line, "y", a.y);
+    if (!a.hasX && !a.hasY && !hasValue) {
+      errCode="missing_value"; errMsg="For axis=xy provide x and/or y (or value for both)";
+      return false;
     }
+    if (hasValue) { a.x = val; a.y = val; a.hasX = true; a.hasY = true; }
+  } else {
+    if (!hasValue) { errCode="missing_value"; errMsg="Provide: value (degrees)"; return false; }
+    if (a.useX) { a.x = val; a.hasX = true; }
+    else        { a.y = val; a.hasY = true; }
+  }
+  return true;
+}
+
+bool PanTiltRig::buildStepFromArgs(
+  uint32_t id,
+  const String& subsystem,
+  const String& route,
+  const MotionArgs& a,
+  QueueItem& it,
+  const char*& errCode,
+  const char*& errMsg
+) {
+  it.id = id;
+  it.subsystem = subsystem;
+  it.route = route;
+  it.kind = motionKindName(a.kind);
+  it.useX = a.useX; it.useY = a.useY;
+
+  float tx=v1, ty=v2;
+  if (a.kind == MK_CENTER) {
+    tx = 0.0f; ty = 0.0f;
+  } else if (a.kind == MK_SET) {
+    if (a.hasX) tx = a.x;
+    if (a.hasY) ty = a.y;
   } else {
-    errCode="unknown_cmd"; errMsg="Unknown motion cmd";
-    return it;
+    if (a.hasX) tx = v1 + a.x;
+    if (a.hasY) ty = v2 + a.y;
   }
 
   tx = clampf(tx, POS_MIN, POS_MAX);
@@ -626,19 +1164,36 @@ static QueueItem buildStepFromCommand(
   it.tx = tx; it.ty = ty;
 
   uint32_t dx=0, dy=0;
-  if (!computeDurations(useX, useY, tx, ty, hasDur, durSec, hasSpeed, speed, dx, dy)) {
+  if (!computeDurations(a.useX, a.useY, tx, ty, a.hasDur, a.durSec, a.hasSpeed, a.speed, dx, dy)) {
     errCode="bad_timing"; errMsg="Invalid dur or speed";
-    return it;
+    return false;
   }
   it.dx = dx; it.dy = dy;
+  return true;
+}
 
-  ok = true;
+QueueItem PanTiltRig::buildStepFromCommand(
+  uint32_t id,
+  const String& subsystem,
+  const String& route,
+  const String& cmd,
+  const String& axis,
+  const String& line,
+  bool& ok,
+  const char*& errCode,
+  const char*& errMsg
+) {
+  QueueItem it;
+  MotionArgs a;
+  ok = parseMotionArgs(cmd, axis, line, a, errCode, errMsg) &&
+       buildStepFromArgs(id, subsystem, route, a, it, errCode, errMsg);
   return it;
 }
 
 // ------------------- JSON help/examples as JSONL -------------------
-static void sendTextLines(const char* event, uint32_t id, const String& subsystem, const String& route, bool mirror,
+static void sendTextLines(const char* event, uint32_t id, const String& subsystem, const String& route, PanTiltLink mirror,
                           const char* const* lines, size_t n) {
+  if (!sinkWants(PanTiltMsg::Ack, mirror)) return;
   for (size_t i = 0; i < n; i++) {
     String raw = String(lines[i]);
     raw.trim();
@@ -669,11 +1224,11 @@ static void sendTextLines(const char* event, uint32_t id, const String& subsyste
       out += raw;
     } else {
       out += "\"";
-      out += jsonEscape(raw);
+      appendJsonEscaped(out, raw);
       out += "\"";
     }
     out += "}";
-    emitLine(out, mirror);
+    emitLine(PanTiltMsg::Ack, out, mirror);
   }
 
   String done;
@@ -686,28 +1241,50 @@ static void sendTextLines(const char* event, uint32_t id, const String& subsyste
   done += String((uint32_t)n);
   appendRoutingFields(done, subsystem, route);
   done += "}";
-  emitLine(done, mirror);
+  emitLine(PanTiltMsg::Ack, done, mirror);
 }
 
 static const char* const COMMANDS_LINES[] = {
   "Info: commands, help, examples, status",
-  "Motion: set, adjust, center, stop, stopAll, resetAll, invert, speed",
+  "Output: subscribe, ackLevel, window, telemetry",
+  "Motion: set, adjust, center, stop, stopAll, resetAll, invert, speed, jog",
+  "Aiming: look, camera, lookAt, rigFrame, targetSave, targetDelete, targets",
   "Position favs: save, recall",
-  "Command favs: favSave, favRun, favList, favClear",
-  "Queue: queue, qAdd, qClear, qAbort, qStatus, qList",
+  "Command favs: favSave, favRun, favStop, favList, favClear",
+  "Named store: presetSave, presetGo, presetDelete, macroSave, macroRun, macroDelete",
+  "Macro flow: waitMs, waitIdle, loop/endLoop, repeatUntilStopped, sync",
+  "Queue: queue, qAdd, qSync, qClear, qAbort, qStatus, qList",
+  "Timing: sync (with t), at",
   "Macro: sweep",
-  "Persistence: persist, factoryReset",
+  "Safety: limits, zone",
+  "Persistence: persist, autosave, factoryReset",
 };
 
 static const char* const EXAMPLES_LINES[] = {
   "Examples (NO id):",
   "{\"cmd\":\"commands\"}",
   "{\"cmd\":\"status\"}",
+  "{\"cmd\":\"subscribe\",\"ack\":\"own\",\"motion\":\"own\",\"debug\":\"off\"}",
+  "{\"cmd\":\"ackLevel\",\"level\":\"minimal\"}",
+  "{\"cmd\":\"window\"}",
+  "{\"cmd\":\"telemetry\",\"hz\":20,\"keyframe\":20}",
   "{\"cmd\":\"speed\",\"value\":120}",
   "{\"cmd\":\"center\",\"axis\":\"xy\",\"dur\":1.0}",
   "{\"cmd\":\"set\",\"axis\":\"x\",\"value\":45,\"dur\":0.7}",
   "{\"cmd\":\"adjust\",\"axis\":\"y\",\"value\":-10,\"speed\":120}",
   "{\"cmd\":\"invert\",\"axis\":\"x\"}",
+  "{\"cmd\":\"camera\",\"hfov\":62,\"vfov\":48}",
+  "{\"cmd\":\"limits\",\"minX\":-80,\"maxX\":80,\"minY\":-20,\"maxY\":70}",
+  "{\"cmd\":\"zone\",\"slot\":1,\"pts\":[30,10,60,10,60,40,30,40]}",
+  "{\"cmd\":\"sync\",\"t\":1718000000123.5,\"rtt\":8}",
+  "{\"cmd\":\"set\",\"x\":40,\"y\":0,\"dur\":2,\"at\":1718000005000}",
+  "{\"cmd\":\"jog\",\"x\":30,\"y\":0,\"keepalive\":300}",
+  "{\"cmd\":\"jog\"}",
+  "{\"cmd\":\"look\",\"u\":0.25,\"v\":-0.1,\"dur\":0.15}",
+  "{\"cmd\":\"rigFrame\",\"x\":0,\"y\":1.5,\"z\":0,\"yaw\":0}",
+  "{\"cmd\":\"targetSave\",\"name\":\"stage\",\"x\":0,\"y\":1.2,\"z\":4}",
+  "{\"cmd\":\"lookAt\",\"name\":\"stage\",\"dur\":1}",
+  "{\"cmd\":\"targets\",\"b\":[0.1,0.05,0.2,0.3,0.9,-0.6,0,0.15,0.2,0.7],\"dur\":0.1}",
   "{\"cmd\":\"save\",\"slot\":1}",
   "{\"cmd\":\"recall\",\"slot\":1,\"dur\":1.2}",
   "Queue sequences:",
@@ -716,17 +1293,37 @@ static const char* const EXAMPLES_LINES[] = {
   "{\"cmd\":\"set\",\"axis\":\"x\",\"value\":60,\"dur\":1.5}",
   "{\"cmd\":\"set\",\"axis\":\"xy\",\"x\":0,\"y\":-20,\"dur\":1.0}",
   "{\"cmd\":\"stopAll\"}",
+  "Per-axis lanes (x and y steps run concurrently, qSync waits for both):",
+  "{\"cmd\":\"queue\",\"mode\":\"on\",\"lanes\":\"axis\"}",
+  "{\"cmd\":\"set\",\"axis\":\"x\",\"value\":-60,\"dur\":2.0}",
+  "{\"cmd\":\"set\",\"axis\":\"y\",\"value\":20,\"dur\":0.5}",
+  "{\"cmd\":\"qSync\"}",
+  "Blended sequence (flows through waypoints):",
+  "{\"cmd\":\"queue\",\"mode\":\"blend\",\"accel\":600,\"corner\":0.5,\"lookahead\":8}",
   "Sweep:",
   "{\"cmd\":\"queue\",\"mode\":\"step\"}",
   "{\"cmd\":\"sweep\",\"axis\":\"x\",\"from\":-80,\"to\":80,\"dur\":6,\"loops\":2,\"dwell\":0.2,\"q\":true}",
+  "{\"cmd\":\"sweep\",\"shape\":\"sine\",\"axis\":\"x\",\"from\":-60,\"to\":60,\"period\":8,\"count\":0}",
+  "{\"cmd\":\"sweep\",\"shape\":\"raster\",\"cx\":0,\"cy\":10,\"ampX\":60,\"ampY\":20,\"lines\":4,\"period\":20}",
+  "{\"cmd\":\"sweep\",\"shape\":\"lissajous\",\"amp\":40,\"ratio\":2,\"period\":10,\"count\":0}",
   "Command favorites (macros):",
   "{\"cmd\":\"favSave\",\"slot\":1,\"line\":\"{\\\"cmd\\\":\\\"center\\\",\\\"axis\\\":\\\"xy\\\",\\\"dur\\\":1.0}\"}",
   "{\"cmd\":\"favSave\",\"slot\":2,\"script\":\"{\\\"cmd\\\":\\\"queue\\\",\\\"mode\\\":\\\"on\\\"}\\\\n{\\\"cmd\\\":\\\"set\\\",\\\"axis\\\":\\\"x\\\",\\\"value\\\":-60,\\\"dur\\\":1.5}\\\\n{\\\"cmd\\\":\\\"set\\\",\\\"axis\\\":\\\"x\\\",\\\"value\\\":60,\\\"dur\\\":1.5}\\\\n{\\\"cmd\\\":\\\"stopAll\\\"}\"}",
   "{\"cmd\":\"favRun\",\"slot\":2}",
+  "{\"cmd\":\"favSave\",\"slot\":3,\"script\":\"{\\\"cmd\\\":\\\"loop\\\",\\\"n\\\":3}\\\\n{\\\"cmd\\\":\\\"set\\\",\\\"axis\\\":\\\"x\\\",\\\"value\\\":-45,\\\"dur\\\":1}\\\\n{\\\"cmd\\\":\\\"waitIdle\\\"}\\\\n{\\\"cmd\\\":\\\"waitMs\\\",\\\"value\\\":500}\\\\n{\\\"cmd\\\":\\\"set\\\",\\\"axis\\\":\\\"x\\\",\\\"value\\\":45,\\\"dur\\\":1}\\\\n{\\\"cmd\\\":\\\"endLoop\\\"}\"}",
+  "{\"cmd\":\"favStop\",\"slot\":0}",
   "{\"cmd\":\"favList\"}",
   "{\"cmd\":\"favClear\",\"slot\":2}",
+  "Named presets and macros (stored in flash on save):",
+  "{\"cmd\":\"presetSave\",\"name\":\"door\",\"x\":30,\"y\":-10}",
+  "{\"cmd\":\"presetGo\",\"name\":\"door\",\"dur\":1.0}",
+  "{\"cmd\":\"macroSave\",\"name\":\"patrol\",\"script\":\"{\\\"cmd\\\":\\\"presetGo\\\",\\\"name\\\":\\\"door\\\",\\\"dur\\\":1}\\\\n{\\\"cmd\\\":\\\"center\\\",\\\"dur\\\":1}\"}",
+  "{\"cmd\":\"macroRun\",\"name\":\"patrol\"}",
+  "{\"cmd\":\"favStop\",\"name\":\"patrol\"}",
+  "{\"cmd\":\"favList\",\"kind\":\"all\",\"page\":0}",
   "Persistence:",
   "{\"cmd\":\"persist\"}",
+  "{\"cmd\":\"autosave\",\"ms\":3000}",
   "{\"cmd\":\"factoryReset\"}",
 };
 
@@ -734,66 +1331,522 @@ static const char* const HELP_LINES[] = {
   "Protocol: JSONL (one JSON object per line). Required field: \"cmd\".",
   "Key fields: axis, value/x/y, dur, speed, q, id, subsystem, route",
   "Ranges: position -90..+90, speed 0.1..1000, dur 0..3600",
+  "Rigs: route picks the camera head; no route or an unknown one goes to the first rig",
   "Commands: commands, help, examples, status",
-  "Motion: set, adjust, center, stop, stopAll, resetAll, invert, speed",
-  "Favorites: save, recall, favSave, favRun, favList, favClear",
-  "Queue: queue(off|on|step), qAdd, qClear, qAbort, qStatus, qList",
-  "Macro: sweep",
-  "Persistence: persist, factoryReset",
+  "Output: subscribe ack|motion|telemetry|fault|debug (or level for all) = off|own|all, per link",
+  "Replies: ackLevel none (faults only) | minimal ({ok:1,id}) | events (completion) | full, per link; queries always answer",
+  "Memory: status reports mem{arena, arenaHigh, arenaOverflows, heapFree, heapMin (low-water), heapMaxBlock (largest free block)}",
+  "Retries: a repeated id from the same link gets the cached reply (replay:true) and doesn't run again; give every new command (and jog keepalive) a fresh id",
+  "Credits: window(credits=true|false) returns q (free queue slots), in (free input bytes), ln (lines left this second); then acks and telemetry carry cr:{q,in,ln}",
+  "Telemetry: telemetry(hz 1..100, 0=off; keyframe every N samples) streams tm events: seq, ts, changed fields only",
+  "Motion: set, adjust, center, stop, stopAll, resetAll, invert, speed, jog",
+  "Jog: jog(x,y deg/s; accel deg/s^2; keepalive ms) holds velocities; any jog line refreshes them, a missed keepalive ramps to a stop; jogging an axis ends its queued step, and later steps on it wait for the jog to stop",
+  "Aiming: look(u,v in -1..1 from image centre, +u right, +v up; optional hfov/vfov) projects to absolute pan/tilt",
+  "Camera: camera(hfov, vfov, panOffset, tiltOffset) sets the stored projection (persisted)",
+  "World: rigFrame(x,y,z metres, yaw/pitch/roll deg, tiltHeight, camOffset; +y up, +z forward) places the rig; lookAt(x,y,z or name) aims at a world point",
+  "Targets: targetSave(name, x,y,z), targetDelete(name), favList kind=target",
+  "Tracking: targets(b=[u,v,w,h,conf,...] up to 8 boxes per frame) picks one subject and aims at it; lockMs, lostMs, margin, minConf, deadband tune the hysteresis; lock events report switches",
+  "Favorites: save, recall, favSave, favRun, favStop, favList, favClear",
+  "Store: presetSave(name, x/y default current), presetGo(name), macroSave/macroRun(name), *Delete; favList kind+page pages it",
+  "Macros run in the background; flow lines: waitMs(value), waitIdle, loop(n)/endLoop, repeatUntilStopped, sync (a queue barrier; pings with t are refused); lines with at keep their schedule",
+  "Queue: queue(off|on|step|blend, lanes single|axis), qAdd, qSync, qClear, qAbort, qStatus, qList",
+  "Timing: sync(t = host ms, rtt = last round trip) pings the host clock; at (host ms) on any command holds it until then; started events report lateUs; stopAll/qAbort drop pending ones",
+  "Blend: queue mode=blend with accel (deg/s^2), corner (deg), lookahead (steps)",
+  "Macro: sweep (shape triangle: from, to, dur per leg, loops, dwell; expands into queue steps)",
+  "Sweep shapes: sweep(shape sine|ease|raster|spiral|lissajous; cx, cy, amp/ampX/ampY or from/to; period s, phase deg, count (0=endless); ratio = lissajous y:x or spiral turns; lines = raster rows) run on the motion tick, no queue",
+  "Safety: limits(minX,maxX,minY,maxY) narrow travel; zone(slot 1..4, pts=[pan,tilt,...] 3..8 vertices, or clear) keeps the camera out of a region; a target inside a zone is refused (pose_in_zone), paths through one are clipped at its edge and reported as keep_out faults (persisted)",
+  "Persistence: persist (changed keys only), autosave(ms, 0=off), factoryReset",
 };
 
-// ------------------- Persistence Implementation -------------------
-static void applyDefaults() {
-  defaultSpeed = 90.0f;
-  invX = false;
-  invY = false;
+// ------------------- Macro Bytecode -------------------
+// favSave compiles each script line into a compact op so favRun never touches the JSON
+// parser. Motion/queue commands get typed ops; anything else is kept as an OP_RAW line
+// that still goes through handleCommandLine. Layout: [version][steps][ops...], floats are
+// little-endian IEEE754 copied with memcpy (blob is stored as-is in NVS).
+static const uint8_t FAV_CODE_VERSION = 1;
+static const uint16_t FAV_CODE_MAX = PanTiltBuild::favCodeMax;
+static const int MACRO_MAX_STEPS = 50;
+
+enum MacroOp : uint8_t {
+  OP_END = 0,
+  OP_MOVE,      // kind, flags, [x], [y], [dur|speed]
+  OP_RECALL,    // slot, flags, [dur|speed]
+  OP_QUEUE,     // mode, lanes (0xFF = unchanged)
+  OP_QSYNC,
+  OP_QCLEAR,
+  OP_QABORT,
+  OP_STOP,      // axis flags
+  OP_STOPALL,   // flush
+  OP_RESETALL,
+  OP_INVERT,    // axis flags
+  OP_SPEED,     // f32
+  OP_SAVE,      // slot
+  OP_RAW,       // u16 len, bytes
+  OP_WAIT_MS,   // u32 ms
+  OP_WAIT_IDLE, // until queue empty and no axis moving
+  OP_LOOP,      // u16 count; body follows
+  OP_END_LOOP,
+  OP_REPEAT,    // jump back to the first op until the macro is stopped
+};
 
-  for (int i=0;i<POS_FAV_SLOTS;i++) {
-    posFavValid[i] = false;
-    posFavX[i] = 0;
-    posFavY[i] = 0;
-  }
-  for (int i=0;i<CMD_FAV_SLOTS;i++) {
-    cmdFavValid[i] = false;
-    cmdFavScript[i] = "";
-  }
-  cfgDirty = false;
+// OP_MOVE / OP_RECALL flag bits
+static const uint8_t MF_X      = 0x01;
+static const uint8_t MF_Y      = 0x02;
+static const uint8_t MF_HAS_X  = 0x04;
+static const uint8_t MF_HAS_Y  = 0x08;
+static const uint8_t MF_DUR    = 0x10;
+static const uint8_t MF_SPEED  = 0x20;
+static const uint8_t MF_HAS_Q  = 0x40;
+static const uint8_t MF_Q      = 0x80;
+
+static const uint8_t FAV_LOADED_ALL = (uint8_t)((1u << CMD_FAV_SLOTS) - 1);
+
+static void favCodeFree(FavCode& fc) {
+  free(fc.blob);
+  fc.blob = nullptr;
+  fc.len = 0;
 }
 
-static PersistedConfig makePersistedConfig() {
-  PersistedConfig cfg{};
-  cfg.magic = CFG_MAGIC;
-  cfg.version = CFG_VERSION;
-  cfg.defaultSpeed = defaultSpeed;
-  cfg.invX = invX ? 1 : 0;
-  cfg.invY = invY ? 1 : 0;
+static bool favCodeAssign(FavCode& fc, const uint8_t* data, uint16_t len) {
+  uint8_t* p = (uint8_t*)malloc(len);
+  if (!p) return false;
+  memcpy(p, data, len);
+  favCodeFree(fc);
+  fc.blob = p;
+  fc.len = len;
+  return true;
+}
 
-  uint8_t mask = 0;
-  for (int i=0;i<POS_FAV_SLOTS;i++) {
-    if (posFavValid[i]) mask |= (1u << i);
-    cfg.posX[i] = posFavX[i];
-    cfg.posY[i] = posFavY[i];
+static bool favCodeValid(const FavCode& fc) {
+  return fc.blob && fc.len >= 3 && fc.blob[0] == FAV_CODE_VERSION;
+}
+
+struct CodeWriter {
+  uint8_t* buf;
+  uint16_t cap;
+  uint16_t len = 0;
+  bool overflow = false;
+
+  CodeWriter(uint8_t* b, uint16_t c) : buf(b), cap(c) {}
+  void put(const void* p, uint16_t n) {
+    if (overflow || len + n > cap) { overflow = true; return; }
+    memcpy(buf + len, p, n);
+    len += n;
   }
-  cfg.posValidMask = mask;
+  void u8(uint8_t v) { put(&v, 1); }
+  void u16(uint16_t v) { put(&v, 2); }
+  void u32(uint32_t v) { put(&v, 4); }
+  void f32(float v) { put(&v, 4); }
+};
 
-  cfg.crc32 = 0;
-  uint32_t crc = crc32_update(0, (const uint8_t*)&cfg, sizeof(PersistedConfig));
-  cfg.crc32 = crc;
-  return cfg;
-}
+struct CodeReader {
+  const uint8_t* p;
+  const uint8_t* end;
+  bool bad = false;
 
-static bool loadConfigFromFlash() {
-  prefs.begin(PREF_NS, true);
+  bool need(uint16_t n) { if (bad || p + n > end) { bad = true; return false; } return true; }
+  uint8_t u8() { if (!need(1)) return 0; return *p++; }
+  uint16_t u16() { uint16_t v = 0; if (need(2)) { memcpy(&v, p, 2); p += 2; } return v; }
+  uint32_t u32() { uint32_t v = 0; if (need(4)) { memcpy(&v, p, 4); p += 4; } return v; }
+  float f32() { float v = 0; if (need(4)) { memcpy(&v, p, 4); p += 4; } return v; }
+};
 
-  PersistedConfig cfg{};
-  size_t n = prefs.getBytes("cfg", &cfg, sizeof(cfg));
-  if (n != sizeof(cfg) || cfg.magic != CFG_MAGIC || cfg.version != CFG_VERSION) {
-    prefs.end();
-    return false;
+static uint8_t axisFlags(bool useX, bool useY) { return (useX ? MF_X : 0) | (useY ? MF_Y : 0); }
+
+static bool compileTimingFields(const String& line, uint8_t& flags, float& timing) {
+  float durSec=-1, sp=-1;
+  if (getNumberField(line, "dur", durSec)) {
+    if (durSec < 0.0f || durSec > 3600.0f) return false;
+    flags |= MF_DUR; timing = durSec;
+  } else if (getNumberField(line, "speed", sp)) {
+    if (sp < 0.1f || sp > 1000.0f) return false;
+    flags |= MF_SPEED; timing = sp;
   }
+  return true;
+}
 
-  uint32_t storedCrc = cfg.crc32;
-  cfg.crc32 = 0;
+// The line verbatim, run through handleCommandLine when the op is reached
+static void compileRawLine(const String& one, CodeWriter& w) {
+  w.u8(OP_RAW); w.u16((uint16_t)one.length());
+  w.put(one.c_str(), (uint16_t)one.length());
+}
+
+static bool compileFavoriteLine(const String& one, CodeWriter& w, uint8_t& loopDepth, const char*& errCode, const char*& errMsg) {
+  String cmd;
+  if (!getStringField(one, "cmd", cmd)) { errCode="missing_cmd"; errMsg="Macro line has no cmd"; return false; }
+  cmd.toLowerCase();
+
+  if (cmd == "persist" || cmd == "factoryreset" || cmd == "favrun" || cmd == "macrorun") {
+    errCode="disallowed"; errMsg="Favorite cannot include persist/factoryReset/favRun/macroRun";
+    return false;
+  }
+
+  // A clock ping carries the host time it was sent at; replayed from flash it would skew
+  // the clock fit. A line with "at" keeps its schedule by going through the handler.
+  double hostT;
+  if (cmd == "sync" && getDoubleField(one, "t", hostT)) {
+    errCode="disallowed"; errMsg="Favorite cannot include sync pings (t); use qSync for a queue barrier";
+    return false;
+  }
+  if (getDoubleField(one, "at", hostT)) { compileRawLine(one, w); return true; }
+
+  bool qVal=false;
+  uint8_t qFlags = getBoolField(one, "q", qVal) ? (MF_HAS_Q | (qVal ? MF_Q : 0)) : 0;
+
+  if (cmd == "set" || cmd == "adjust" || cmd == "center") {
+    String axis="xy"; (void)getStringField(one, "axis", axis);
+    MotionArgs a;
+    if (!parseMotionArgs(cmd, axis, one, a, errCode, errMsg)) return false;
+    if (!motionTimingValid(a)) { errCode="bad_timing"; errMsg="Invalid dur or speed"; return false; }
+
+    uint8_t flags = axisFlags(a.useX, a.useY) | qFlags;
+    if (a.hasX) flags |= MF_HAS_X;
+    if (a.hasY) flags |= MF_HAS_Y;
+    if (a.hasDur) flags |= MF_DUR;
+    else if (a.hasSpeed) flags |= MF_SPEED;
+
+    w.u8(OP_MOVE); w.u8((uint8_t)a.kind); w.u8(flags);
+    if (a.hasX) w.f32(a.x);
+    if (a.hasY) w.f32(a.y);
+    if (a.hasDur) w.f32(a.durSec);
+    else if (a.hasSpeed) w.f32(a.speed);
+    return true;
+  }
+
+  if (cmd == "recall") {
+    int slot=0;
+    if (!getIntField(one, "slot", slot) || slot < 1 || slot > POS_FAV_SLOTS) { errCode="bad_slot"; errMsg="recall requires slot 1..5"; return false; }
+    String axis="xy"; (void)getStringField(one, "axis", axis);
+    bool useX=false, useY=false;
+    if (!parseAxisMask(axis, useX, useY)) { errCode="bad_axis"; errMsg="axis must be x, y, or xy"; return false; }
+    uint8_t flags = axisFlags(useX, useY) | qFlags;
+    float timing = 0;
+    if (!compileTimingFields(one, flags, timing)) { errCode="bad_timing"; errMsg="Invalid dur or speed"; return false; }
+    w.u8(OP_RECALL); w.u8((uint8_t)slot); w.u8(flags);
+    if (flags & (MF_DUR | MF_SPEED)) w.f32(timing);
+    return true;
+  }
+
+  if (cmd == "stop" || cmd == "invert") {
+    String axis="xy"; (void)getStringField(one, "axis", axis);
+    bool useX=false, useY=false;
+    if (!parseAxisMask(axis, useX, useY)) { errCode="bad_axis"; errMsg="axis must be x, y, or xy"; return false; }
+    w.u8(cmd == "stop" ? OP_STOP : OP_INVERT); w.u8(axisFlags(useX, useY));
+    return true;
+  }
+
+  if (cmd == "stopall") {
+    bool flush = true; (void)getBoolField(one, "flush", flush);
+    w.u8(OP_STOPALL); w.u8(flush ? 1 : 0);
+    return true;
+  }
+
+  if (cmd == "speed") {
+    float sp;
+    if (!getNumberField(one, "value", sp) || sp < 0.1f || sp > 1000.0f) { errCode="bad_value"; errMsg="speed requires value 0.1..1000"; return false; }
+    w.u8(OP_SPEED); w.f32(sp);
+    return true;
+  }
+
+  if (cmd == "save") {
+    int slot=0;
+    if (!getIntField(one, "slot", slot) || slot < 1 || slot > POS_FAV_SLOTS) { errCode="bad_slot"; errMsg="save requires slot 1..5"; return false; }
+    w.u8(OP_SAVE); w.u8((uint8_t)slot);
+    return true;
+  }
+
+  int kp;
+  bool blendTuning = findKey(one, "accel", kp) || findKey(one, "corner", kp) || findKey(one, "lookahead", kp);
+  if (cmd == "queue" && !blendTuning) {
+    String mode;
+    if (!getStringField(one, "mode", mode)) { errCode="missing_mode"; errMsg="queue requires mode"; return false; }
+    mode.toLowerCase();
+    uint8_t m;
+    if (mode == "off") m = Q_OFF;
+    else if (mode == "on") m = Q_ON;
+    else if (mode == "step") m = Q_STEP;
+    else if (mode == "blend") m = Q_BLEND;
+    else { errCode="bad_mode"; errMsg="mode must be off|on|step|blend"; return false; }
+    uint8_t lanes = 0xFF;
+    String l;
+    if (getStringField(one, "lanes", l)) {
+      l.toLowerCase();
+      if (l == "single") lanes = QL_SINGLE;
+      else if (l == "axis") lanes = QL_AXIS;
+      else { errCode="bad_lanes"; errMsg="lanes must be single|axis"; return false; }
+    }
+    w.u8(OP_QUEUE); w.u8(m); w.u8(lanes);
+    return true;
+  }
+
+  // ---- flow control (only meaningful inside macros) ----
+  if (cmd == "waitms") {
+    float ms;
+    if (!getNumberField(one, "value", ms) && !getNumberField(one, "ms", ms)) { errCode="missing_value"; errMsg="waitMs requires value (ms)"; return false; }
+    if (ms < 0.0f || ms > 3600000.0f) { errCode="bad_value"; errMsg="waitMs must be 0..3600000"; return false; }
+    w.u8(OP_WAIT_MS); w.u32((uint32_t)(ms + 0.5f));
+    return true;
+  }
+  if (cmd == "waitidle") { w.u8(OP_WAIT_IDLE); return true; }
+  if (cmd == "loop") {
+    int n=0;
+    if (!getIntField(one, "n", n) || n < 1 || n > 65535) { errCode="bad_value"; errMsg="loop requires n 1..65535"; return false; }
+    if (loopDepth >= MACRO_LOOP_DEPTH) { errCode="too_deep"; errMsg="loop nesting limit is 4"; return false; }
+    loopDepth++;
+    w.u8(OP_LOOP); w.u16((uint16_t)n);
+    return true;
+  }
+  if (cmd == "endloop") {
+    if (!loopDepth) { errCode="bad_loop"; errMsg="endLoop without loop"; return false; }
+    loopDepth--;
+    w.u8(OP_END_LOOP);
+    return true;
+  }
+  if (cmd == "repeatuntilstopped") { w.u8(OP_REPEAT); return true; }
+
+  if (cmd == "qsync" || cmd == "sync") { w.u8(OP_QSYNC); return true; }
+  if (cmd == "qclear")   { w.u8(OP_QCLEAR);   return true; }
+  if (cmd == "qabort")   { w.u8(OP_QABORT);   return true; }
+  if (cmd == "resetall") { w.u8(OP_RESETALL); return true; }
+
+  // Everything else runs through the regular handler.
+  compileRawLine(one, w);
+  return true;
+}
+
+// Compiles a newline separated JSONL script into out (header + ops).
+static bool compileFavoriteScript(const String& script, uint8_t* out, uint16_t cap, uint16_t& outLen,
+                                  const char*& errCode, const char*& errMsg) {
+  CodeWriter w(out, cap);
+  w.u8(FAV_CODE_VERSION);
+  w.u8(0);  // step count, patched below
+
+  int steps = 0;
+  uint8_t loopDepth = 0;
+  int start = 0;
+  while (start < (int)script.length()) {
+    int end = script.indexOf('\n', start);
+    if (end < 0) end = script.length();
+    String one = script.substring(start, end);
+    one.trim();
+    start = end + 1;
+    if (!one.length()) continue;
+
+    if (++steps > MACRO_MAX_STEPS) { errCode="macro_too_long"; errMsg="Macro step limit exceeded (50)"; return false; }
+    if (!compileFavoriteLine(one, w, loopDepth, errCode, errMsg)) return false;
+  }
+  if (loopDepth) { errCode="bad_loop"; errMsg="loop without endLoop"; return false; }
+  w.u8(OP_END);
+
+  if (!steps) { errCode="empty_script"; errMsg="Provided line/script is empty"; return false; }
+  if (w.overflow) { errCode="too_long"; errMsg="Compiled macro too large"; return false; }
+  out[1] = (uint8_t)steps;
+  outLen = w.len;
+  return true;
+}
+
+static void appendAxisText(String& out, uint8_t flags) {
+  out += "\"axis\":\"";
+  out += ((flags & MF_X) && (flags & MF_Y)) ? "xy" : ((flags & MF_X) ? "x" : "y");
+  out += "\"";
+}
+
+static void appendTimingText(String& out, uint8_t flags, CodeReader& r) {
+  if (flags & MF_DUR)   { out += ",\"dur\":";   out += String(r.f32(), 2); }
+  if (flags & MF_SPEED) { out += ",\"speed\":"; out += String(r.f32(), 2); }
+  if (flags & MF_HAS_Q) { out += ",\"q\":"; out += (flags & MF_Q) ? "true" : "false"; }
+}
+
+// Renders compiled ops back to JSONL (one line per op), stopping after maxLen chars.
+static String disassembleFavorite(const FavCode& fc, unsigned maxLen) {
+  String out;
+  if (!favCodeValid(fc)) return out;
+  CodeReader r{fc.blob + 2, fc.blob + fc.len};
+
+  while (!r.bad && out.length() < maxLen) {
+    uint8_t op = r.u8();
+    if (op == OP_END || r.bad) break;
+    if (out.length()) out += "\n";
+
+    switch (op) {
+      case OP_MOVE: {
+        MotionKind k = (MotionKind)r.u8();
+        uint8_t f = r.u8();
+        out += "{\"cmd\":\""; out += motionKindName(k); out += "\",";
+        appendAxisText(out, f);
+        bool single = !((f & MF_X) && (f & MF_Y));
+        if (f & MF_HAS_X) { out += single ? ",\"value\":" : ",\"x\":"; out += String(r.f32(), 2); }
+        if (f & MF_HAS_Y) { out += single ? ",\"value\":" : ",\"y\":"; out += String(r.f32(), 2); }
+        appendTimingText(out, f, r);
+        out += "}";
+        break;
+      }
+      case OP_RECALL: {
+        uint8_t slot = r.u8();
+        uint8_t f = r.u8();
+        out += "{\"cmd\":\"recall\",\"slot\":"; out += String(slot); out += ",";
+        appendAxisText(out, f);
+        appendTimingText(out, f, r);
+        out += "}";
+        break;
+      }
+      case OP_QUEUE: {
+        uint8_t m = r.u8();
+        uint8_t lanes = r.u8();
+        out += "{\"cmd\":\"queue\",\"mode\":\""; out += queueModeName((QueueMode)m); out += "\"";
+        if (lanes != 0xFF) { out += ",\"lanes\":\""; out += (lanes == QL_AXIS ? "axis" : "single"); out += "\""; }
+        out += "}";
+        break;
+      }
+      case OP_QSYNC:    out += "{\"cmd\":\"qSync\"}"; break;
+      case OP_QCLEAR:   out += "{\"cmd\":\"qClear\"}"; break;
+      case OP_QABORT:   out += "{\"cmd\":\"qAbort\"}"; break;
+      case OP_RESETALL: out += "{\"cmd\":\"resetAll\"}"; break;
+      case OP_STOP:
+      case OP_INVERT:
+        out += (op == OP_STOP) ? "{\"cmd\":\"stop\"," : "{\"cmd\":\"invert\",";
+        appendAxisText(out, r.u8());
+        out += "}";
+        break;
+      case OP_STOPALL:
+        out += "{\"cmd\":\"stopAll\",\"flush\":"; out += r.u8() ? "true" : "false"; out += "}";
+        break;
+      case OP_SPEED:
+        out += "{\"cmd\":\"speed\",\"value\":"; out += String(r.f32(), 2); out += "}";
+        break;
+      case OP_SAVE:
+        out += "{\"cmd\":\"save\",\"slot\":"; out += String(r.u8()); out += "}";
+        break;
+      case OP_RAW: {
+        uint16_t n = r.u16();
+        if (!r.need(n)) break;
+        out.concat((const char*)r.p, n);
+        r.p += n;
+        break;
+      }
+      case OP_WAIT_MS:
+        out += "{\"cmd\":\"waitMs\",\"value\":"; out += String(r.u32()); out += "}";
+        break;
+      case OP_WAIT_IDLE: out += "{\"cmd\":\"waitIdle\"}"; break;
+      case OP_LOOP:
+        out += "{\"cmd\":\"loop\",\"n\":"; out += String(r.u16()); out += "}";
+        break;
+      case OP_END_LOOP: out += "{\"cmd\":\"endLoop\"}"; break;
+      case OP_REPEAT: out += "{\"cmd\":\"repeatUntilStopped\"}"; break;
+      default:
+        r.bad = true;
+        break;
+    }
+  }
+  return out;
+}
+
+// ------------------- Persistence Implementation -------------------
+void PanTiltRig::applyDefaults() {
+  defaultSpeed = 90.0f;
+  invX = false;
+  invY = false;
+
+  for (int i=0;i<POS_FAV_SLOTS;i++) {
+    posFavValid[i] = false;
+    posFavX[i] = 0;
+    posFavY[i] = 0;
+  }
+  for (int i=0;i<CMD_FAV_SLOTS;i++) favCodeFree(cmdFav[i]);
+  favLoadedMask = 0;
+  favLegacyBad = 0;
+  autosaveMs = 0;
+  autosaveActive = false;
+  persistedCfgCrc = 0;
+  cameraDefaults();
+  persistedCamCrc = 0;
+  frameDefaults();
+  limitsDefaults();
+  persistedFrameCrc = 0;
+  cfgDirty = 0;
+}
+
+PersistedConfig PanTiltRig::makePersistedConfig() {
+  PersistedConfig cfg{};
+  cfg.magic = CFG_MAGIC;
+  cfg.version = CFG_VERSION;
+  cfg.autosaveMs = autosaveMs;
+  cfg.defaultSpeed = defaultSpeed;
+  cfg.invX = invX ? 1 : 0;
+  cfg.invY = invY ? 1 : 0;
+
+  uint8_t mask = 0;
+  for (int i=0;i<POS_FAV_SLOTS;i++) {
+    if (posFavValid[i]) mask |= (1u << i);
+    cfg.posX[i] = posFavX[i];
+    cfg.posY[i] = posFavY[i];
+  }
+  cfg.posValidMask = mask;
+
+  cfg.crc32 = 0;
+  uint32_t crc = crc32_update(0, (const uint8_t*)&cfg, sizeof(PersistedConfig));
+  cfg.crc32 = crc;
+  return cfg;
+}
+
+// "fbN" / "favN"; sized for any unsigned slot number so the key never truncates
+static const size_t FAV_KEY_MAX = 16;
+
+static void favKey(char* buf, size_t n, const char* prefix, int idx) {
+  snprintf(buf, n, "%.3s%u", prefix, (unsigned)idx + 1u);
+}
+
+// Loads one favorite slot (prefs must be open). Prefers the compiled "fbN" blob; falls
+// back to a legacy "favN" JSONL script and compiles it. Returns true if it migrated. A
+// legacy script that no longer compiles stays in flash, flagged in favLegacyBad.
+bool PanTiltRig::loadFavoriteSlot(int i) {
+  char key[FAV_KEY_MAX];
+  favKey(key, sizeof(key), "fb", i);
+  size_t n = prefs.getBytesLength(key);
+  if (n >= 3 && n <= FAV_CODE_MAX) {
+    uint8_t* p = (uint8_t*)malloc(n);
+    if (p && prefs.getBytes(key, p, n) == n && p[0] == FAV_CODE_VERSION) {
+      cmdFav[i].blob = p;
+      cmdFav[i].len = (uint16_t)n;
+      return false;
+    }
+    free(p);
+  }
+
+  favKey(key, sizeof(key), "fav", i);
+  String s = prefs.getString(key, "");
+  if (!s.length()) return false;
+  if (s.length() > FAV_SCRIPT_MAX) s = s.substring(0, FAV_SCRIPT_MAX);
+
+  ScratchScope scope;
+  uint8_t* code = (uint8_t*)scratchAlloc(FAV_CODE_MAX);
+  if (!code) return false;
+  uint16_t len = 0;
+  const char* ec; const char* em;
+  if (!compileFavoriteScript(s, code, FAV_CODE_MAX, len, ec, em)) {
+    favLegacyBad |= (uint8_t)(1u << i);
+    sendEventFault(lastSubsystem, lastRoute, g_lastMirrorToBle, "legacy_invalid", 0,
+                   "Stored legacy favorite does not compile; kept in flash, see favList");
+    return false;
+  }
+  return favCodeAssign(cmdFav[i], code, len);
+}
+
+bool PanTiltRig::loadConfigFromFlash() {
+  prefs.begin(rigCfg.prefNs, true);
+  (void)loadCamera();
+  (void)loadFrame();
+  (void)loadLimits();
+
+  PersistedConfig cfg{};
+  size_t n = prefs.getBytes("cfg", &cfg, sizeof(cfg));
+  if (n != sizeof(cfg) || cfg.magic != CFG_MAGIC || cfg.version != CFG_VERSION) {
+    prefs.end();
+    return false;
+  }
+
+  uint32_t storedCrc = cfg.crc32;
+  cfg.crc32 = 0;
   uint32_t calcCrc = crc32_update(0, (const uint8_t*)&cfg, sizeof(PersistedConfig));
 
   if (calcCrc != storedCrc) {
@@ -806,6 +1859,8 @@ static bool loadConfigFromFlash() {
 
   invX = (cfg.invX != 0);
   invY = (cfg.invY != 0);
+  autosaveMs = cfg.autosaveMs;
+  persistedCfgCrc = storedCrc;
 
   for (int i=0;i<POS_FAV_SLOTS;i++) {
     bool valid = (cfg.posValidMask & (1u << i)) != 0;
@@ -814,54 +1869,109 @@ static bool loadConfigFromFlash() {
     posFavY[i] = clampf(cfg.posY[i], POS_MIN, POS_MAX);
   }
 
+  cfgDirty = 0;
+  prefs.end();
+  return true;
+}
+
+// Favorites are not needed to drive the servos, so boot skips them: each slot is read on
+// first use, and PanTilt_loop() prefetches one remaining slot per pass.
+void PanTiltRig::markFavLoaded(int i) { favLoadedMask |= (uint8_t)(1u << i); }
+
+void PanTiltRig::ensureFavLoaded(int i) {
+  if (favLoadedMask & (1u << i)) return;
+  markFavLoaded(i);
+  prefs.begin(rigCfg.prefNs, true);
+  favCodeFree(cmdFav[i]);
+  // legacy text favorites get rewritten as bytecode on the next persist
+  if (loadFavoriteSlot(i)) markDirty(dirtyFav(i));
+  prefs.end();
+}
+
+void PanTiltRig::ensureAllFavLoaded() {
+  for (int i=0;i<CMD_FAV_SLOTS;i++) ensureFavLoaded(i);
+}
+
+void PanTiltRig::favPrefetchTick() {
+  if (favLoadedMask == FAV_LOADED_ALL) return;
   for (int i=0;i<CMD_FAV_SLOTS;i++) {
-    String key = "fav";
-    key += (i+1);
-    String s = prefs.getString(key.c_str(), "");
-    if (s.length() > 0) {
-      cmdFavValid[i] = true;
-      if (s.length() > FAV_SCRIPT_MAX) s = s.substring(0, FAV_SCRIPT_MAX);
-      cmdFavScript[i] = s;
-    } else {
-      cmdFavValid[i] = false;
-      cmdFavScript[i] = "";
+    if (favLoadedMask & (1u << i)) continue;
+    ensureFavLoaded(i);
+    return;
+  }
+}
+
+// Writes the lowest dirty key group (prefs must be open for writing). Bits are cleared
+// before writing so changes made later are picked up by the next pass; on failure they
+// are restored.
+bool PanTiltRig::persistNextKey() {
+  if (cfgDirty & DIRTY_CFG_KEY) {
+    uint16_t bits = cfgDirty & DIRTY_CFG_KEY;
+    cfgDirty &= ~DIRTY_CFG_KEY;
+    PersistedConfig cfg = makePersistedConfig();
+    if (cfg.crc32 == persistedCfgCrc) { persistStats.skipped++; return true; }
+    if (prefs.putBytes("cfg", &cfg, sizeof(cfg)) != sizeof(cfg)) {
+      cfgDirty |= bits;
+      persistStats.failures++;
+      return false;
     }
+    persistedCfgCrc = cfg.crc32;
+    persistStats.writes++;
+    return true;
   }
 
-  prefs.end();
-  cfgDirty = false;
+  if (cfgDirty & DIRTY_CAM) return persistCamera();
+  if (cfgDirty & DIRTY_FRAME) return persistFrame();
+  if (cfgDirty & DIRTY_LIMITS) return persistLimits();
+
+  for (int i=0;i<CMD_FAV_SLOTS;i++) {
+    if (!(cfgDirty & dirtyFav(i))) continue;
+    cfgDirty &= ~dirtyFav(i);
+
+    char key[FAV_KEY_MAX];
+    favKey(key, sizeof(key), "fb", i);
+    bool ok = true;
+    bool valid = favCodeValid(cmdFav[i]);
+    if (valid) {
+      ok = prefs.putBytes(key, cmdFav[i].blob, cmdFav[i].len) == cmdFav[i].len;
+    } else if (prefs.isKey(key)) {
+      prefs.remove(key);
+    }
+    // The legacy text form goes once its bytecode is in flash, or when the slot was
+    // cleared on purpose; a script that failed to migrate is never dropped silently.
+    favKey(key, sizeof(key), "fav", i);
+    bool dropLegacy = valid ? ok : !(favLegacyBad & (1u << i));
+    if (dropLegacy && prefs.isKey(key)) prefs.remove(key);
+
+    if (!ok) {
+      cfgDirty |= dirtyFav(i);
+      persistStats.failures++;
+      return false;
+    }
+    persistStats.writes++;
+    return true;
+  }
+
+  cfgDirty = 0;
   return true;
 }
 
-static bool persistToFlash(String& why) {
+bool PanTiltRig::persistToFlash(String& why) {
   if (!cfgDirty) {
     why = "no_changes";
     return true;
   }
 
-  PersistedConfig cfg = makePersistedConfig();
-
-  prefs.begin(PREF_NS, false);
-
+  prefs.begin(rigCfg.prefNs, false);
   bool ok = true;
-  ok &= (prefs.putBytes("cfg", &cfg, sizeof(cfg)) == sizeof(cfg));
-
-  for (int i=0;i<CMD_FAV_SLOTS;i++) {
-    String key = "fav";
-    key += (i+1);
-    if (cmdFavValid[i] && cmdFavScript[i].length() > 0) {
-      String s = cmdFavScript[i];
-      if (s.length() > FAV_SCRIPT_MAX) s = s.substring(0, FAV_SCRIPT_MAX);
-      ok &= prefs.putString(key.c_str(), s) > 0;
-    } else {
-      prefs.remove(key.c_str());
-    }
+  while (cfgDirty) {
+    if (!persistNextKey()) { ok = false; break; }
   }
-
   prefs.end();
+  autosaveActive = false;
 
   if (ok) {
-    cfgDirty = false;
+    persistStats.commits++;
     why = "persisted";
     return true;
   }
@@ -870,135 +1980,843 @@ static bool persistToFlash(String& why) {
   return false;
 }
 
-static bool factoryResetFlash(String& why) {
-  prefs.begin(PREF_NS, false);
+// Debounced background persist: once nothing has changed for autosaveMs, write one
+// dirty key per loop() pass so a full save never blocks a single iteration for long.
+void PanTiltRig::autosaveTick() {
+  if (!autosaveMs || !cfgDirty) { autosaveActive = false; return; }
+  if (!autosaveActive) {
+    if (millis() - cfgDirtyAt < autosaveMs) return;
+    autosaveActive = true;
+  }
+
+  prefs.begin(rigCfg.prefNs, false);
+  bool ok = persistNextKey();
+  prefs.end();
+
+  if (!ok) {
+    autosaveActive = false;
+    cfgDirtyAt = millis();   // retry after another debounce period
+    return;
+  }
+  if (!cfgDirty) {
+    autosaveActive = false;
+    persistStats.commits++;
+    persistStats.autosaves++;
+  }
+}
+
+bool PanTiltRig::factoryResetFlash(String& why) {
+  prefs.begin(rigCfg.prefNs, false);
   bool ok = prefs.clear();
   prefs.end();
+  if (ok) persistStats.writes++;
 
   applyDefaults();
+  if (ok) favLoadedMask = FAV_LOADED_ALL;   // nothing left to read
+  if (!storeFactoryReset()) ok = false;
   why = ok ? "factory_reset" : "clear_failed";
   return ok;
 }
 
-// ------------------- Macro Runner -------------------
-static bool macroRunning = false;
-static QueueMode qModeSavedForMacro = Q_STEP;
+// ------------------- Preset/Macro Store -------------------
+// Named presets and macros live in their own NVS namespace and are written through on
+// save. Each entry is one blob under a hashed key ("p"/"m" + FNV-1a of the name), so a
+// lookup is a single read. The paged index ("ixN", IDX_PAGE_ENTRIES per page, count in
+// "ixn") carries name, length and CRC for listing. Only STORE_CACHE_SLOTS decoded
+// entries stay in RAM (LRU), so heap use doesn't grow with the number of entries.
+static const uint16_t STORE_MAX_ENTRIES = 512;
+static const uint8_t IDX_PAGE_ENTRIES = 16;
+static const uint8_t STORE_REC_VERSION = 1;
+static const uint8_t STORE_LIST_PAGE = 8;
+
+enum StoreKind : uint8_t { SK_PRESET = 'p', SK_MACRO = 'm', SK_TARGET = 't' };
+
+struct StoreIndexEntry {
+  uint32_t hash;
+  uint32_t crc;
+  uint16_t len;
+  uint8_t kind;
+  char name[STORE_NAME_MAX + 1];
+};
 
-static bool shouldEnqueue(QueueMode mode, bool hasQ, bool qVal) {
-  if (macroRunning) {
-    if (hasQ && !qVal) return false;
-    return true;
-  }
+struct StoreRecordHeader {
+  uint8_t version;
+  uint8_t kind;
+  uint16_t len;
+  uint32_t crc;
+  char name[STORE_NAME_MAX + 1];
+};
 
-  if (mode == Q_ON)  return !(hasQ && qVal == false);
-  if (mode == Q_OFF) return (hasQ && qVal == true);
-  return (hasQ && qVal == true);
+static StoreIndexEntry storePage[IDX_PAGE_ENTRIES];
+
+// Macro VM slots past the command favorites refer to store cache entries.
+static int storeMacroSlot(uint8_t cacheIdx) { return CMD_FAV_SLOTS + cacheIdx; }
+
+static uint32_t storeHash(const String& name) {
+  uint32_t h = 2166136261u;
+  for (size_t i=0;i<name.length();i++) { h ^= (uint8_t)name[i]; h *= 16777619u; }
+  return h;
 }
 
-static bool looksDangerousFavorite(const String& line) {
-  String t = line;
-  t.toLowerCase();
-  if (t.indexOf("\"cmd\":\"persist\"") >= 0) return true;
-  if (t.indexOf("\"cmd\":\"factoryreset\"") >= 0) return true;
-  if (t.indexOf("\"cmd\":\"favrun\"") >= 0) return true;
-  return false;
+static bool storeNameValid(const String& name) {
+  if (!name.length() || name.length() > STORE_NAME_MAX) return false;
+  for (size_t i=0;i<name.length();i++) {
+    char c = name[i];
+    bool ok = (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '_' || c == '-' || c == '.';
+    if (!ok) return false;
+  }
+  return true;
 }
 
-static void handleCommandLine(String line); // fwd
+static void storeKey(char* buf, size_t n, uint8_t kind, uint32_t hash) {
+  snprintf(buf, n, "%c%08lx", (char)kind, (unsigned long)hash);
+}
 
-static bool runFavoriteScript(uint32_t id, const String& subsystem, const String& route, bool mirror, const String& scriptRaw) {
-  if (macroRunning) {
-    sendErr(id, subsystem, route, mirror, "macro_busy", "A macro is already running");
-    return false;
-  }
+static const char* storeKindName(uint8_t kind) {
+  return kind == SK_MACRO ? "macro" : (kind == SK_TARGET ? "target" : "preset");
+}
 
-  qModeSavedForMacro = qMode;
-  qMode = Q_ON;
-  macroRunning = true;
+// Index helpers (store namespace must be open).
+uint16_t PanTiltRig::storeCount() { return prefs.getUShort("ixn", 0); }
+
+uint8_t PanTiltRig::storeReadPage(uint16_t page, uint16_t count) {
+  uint16_t first = page * IDX_PAGE_ENTRIES;
+  if (first >= count) return 0;
+  uint16_t n = count - first;
+  if (n > IDX_PAGE_ENTRIES) n = IDX_PAGE_ENTRIES;
+  char key[8];
+  snprintf(key, sizeof(key), "ix%u", (unsigned)page);
+  size_t want = n * sizeof(StoreIndexEntry);
+  if (prefs.getBytes(key, storePage, want) != want) return 0;
+  return (uint8_t)n;
+}
 
-  String script = scriptRaw;
-  int start = 0;
-  int steps = 0;
-  while (start < (int)script.length()) {
-    int end = script.indexOf('\n', start);
-    if (end < 0) end = script.length();
-    String oneLine = script.substring(start, end);
-    oneLine.trim();
-    start = end + 1;
+bool PanTiltRig::storeWritePage(uint16_t page, uint8_t n) {
+  char key[8];
+  snprintf(key, sizeof(key), "ix%u", (unsigned)page);
+  if (!n) { prefs.remove(key); return true; }
+  size_t want = n * sizeof(StoreIndexEntry);
+  return prefs.putBytes(key, storePage, want) == want;
+}
 
-    if (!oneLine.length()) continue;
-    steps++;
-    if (steps > 50) {
-      sendErr(id, subsystem, route, mirror, "macro_too_long", "Macro step limit exceeded (50)");
-      macroRunning = false;
-      qMode = qModeSavedForMacro;
-      return false;
+int PanTiltRig::storeIndexFind(uint8_t kind, uint32_t hash, uint16_t count) {
+  for (uint16_t page=0; page * IDX_PAGE_ENTRIES < count; page++) {
+    uint8_t n = storeReadPage(page, count);
+    for (uint8_t i=0;i<n;i++) {
+      if (storePage[i].kind == kind && storePage[i].hash == hash) return page * IDX_PAGE_ENTRIES + i;
     }
+  }
+  return -1;
+}
 
-    handleCommandLine(oneLine);
+int PanTiltRig::storeCacheFind(uint8_t kind, uint32_t hash) {
+  for (uint8_t i=0;i<STORE_CACHE_SLOTS;i++) {
+    if (storeCache[i].used && storeCache[i].kind == kind && storeCache[i].hash == hash) return i;
   }
+  return -1;
+}
 
-  macroRunning = false;
-  qMode = qModeSavedForMacro;
-  return true;
+void PanTiltRig::storeCacheDrop(int i) {
+  favCodeFree(storeCache[i].code);
+  storeCache[i] = StoreCacheEntry();
 }
 
-// ------------------- Scheduler -------------------
-static void maybeStartNextQueuedStep() {
-  if (qActive) return;
-  if (mx.active || my.active) return;
-  if (qIsEmpty()) return;
+// Least recently used entry that no macro is running from; -1 if all are pinned.
+int PanTiltRig::storeCacheVictim() {
+  int best = -1;
+  for (uint8_t i=0;i<STORE_CACHE_SLOTS;i++) {
+    if (!storeCache[i].used) return i;
+    if (macroSlotRunning(storeMacroSlot(i))) continue;
+    if (best < 0 || storeCache[i].lastUse < storeCache[best].lastUse) best = i;
+  }
+  return best;
+}
 
-  if (!qDequeue(qCurrent)) return;
-  qActive = true;
-  qStartedAt = millis();
+void PanTiltRig::storeClearCache() {
+  for (uint8_t i=0;i<STORE_CACHE_SLOTS;i++) storeCacheDrop(i);
+}
 
-  uint32_t maxDur = 0;
-  if (qCurrent.useX && qCurrent.dx > maxDur) maxDur = qCurrent.dx;
-  if (qCurrent.useY && qCurrent.dy > maxDur) maxDur = qCurrent.dy;
-  qCurrent.expectedEnd = qStartedAt + maxDur + STEP_TIMEOUT_GRACE_MS;
+bool PanTiltRig::storePut(uint8_t kind, const String& name, const uint8_t* data, uint16_t len, const char*& errCode, const char*& errMsg) {
+  uint32_t hash = storeHash(name);
+  char key[12];
+  storeKey(key, sizeof(key), kind, hash);
+
+  size_t total = sizeof(StoreRecordHeader) + len;
+  uint8_t* rec = (uint8_t*)malloc(total);
+  if (!rec) { errCode="no_memory"; errMsg="Out of memory for store record"; return false; }
+
+  StoreRecordHeader h{};
+  h.version = STORE_REC_VERSION;
+  h.kind = kind;
+  h.len = len;
+  h.crc = crc32_update(0, data, len);
+  strncpy(h.name, name.c_str(), STORE_NAME_MAX);
+  memcpy(rec, &h, sizeof(h));
+  memcpy(rec + sizeof(h), data, len);
+
+  prefs.begin(rigCfg.storeNs, false);
+  bool ok = true;
 
-  sendEventStarted(qCurrent);
-  executeStep(qCurrent);
+  // getBytes() needs the whole blob, so the existing record is read in full
+  size_t oldLen = prefs.getBytesLength(key);
+  if (oldLen >= sizeof(StoreRecordHeader)) {
+    uint8_t* old = (uint8_t*)malloc(oldLen);
+    if (old && prefs.getBytes(key, old, oldLen) == oldLen
+        && strncmp(((StoreRecordHeader*)old)->name, h.name, sizeof(h.name)) != 0) {
+      errCode="name_collision"; errMsg="Another entry hashes to this name; pick a different name";
+      ok = false;
+    }
+    free(old);
+  }
 
-  if (!mx.active && !my.active && qCurXDone && qCurYDone) {
-    sendEventStepDone(qCurrent);
-    qActive = false;
+  uint16_t count = storeCount();
+  int pos = ok ? storeIndexFind(kind, hash, count) : -1;
+  if (ok && pos < 0 && count >= STORE_MAX_ENTRIES) {
+    errCode="store_full"; errMsg="Store is full";
+    ok = false;
   }
-}
 
-static void updateMotion() {
-  const uint32_t now = millis();
+  if (ok && prefs.putBytes(key, rec, total) != total) {
+    errCode="write_failed"; errMsg="Could not write store record";
+    ok = false;
+  }
 
-  if (mx.active) {
-    uint32_t dt = now - mx.t0;
-    if (dt >= mx.durMs) {
-      v1 = mx.target;
-      mx.active = false;
-      applyOutputs();
+  if (ok) {
+    bool append = pos < 0;
+    if (append) pos = count;
+    uint16_t page = pos / IDX_PAGE_ENTRIES;
+    uint8_t n = storeReadPage(page, count);
+    uint8_t slot = pos % IDX_PAGE_ENTRIES;
+    StoreIndexEntry& e = storePage[slot];
+    e.hash = hash; e.crc = h.crc; e.len = len; e.kind = kind;
+    memcpy(e.name, h.name, sizeof(e.name));
+    if (append) n = slot + 1;
+    if (!storeWritePage(page, n) || (append && !prefs.putUShort("ixn", count + 1))) {
+      errCode="write_failed"; errMsg="Could not update store index";
+      ok = false;
+    }
+  }
+  prefs.end();
+  free(rec);
 
-      bool mirror = qActive ? qCurrent.mirrorToBle : g_lastMirrorToBle;
-      sendEventDoneAxis('x', mx.cmdRef, qActive ? qCurrent.subsystem : lastSubsystem, qActive ? qCurrent.route : lastRoute, mirror);
+  int ci = storeCacheFind(kind, hash);
+  if (ok && ci >= 0 && !macroSlotRunning(storeMacroSlot(ci))) storeCacheDrop(ci);
+  if (ok) persistStats.writes++;
+  return ok;
+}
 
-      if (qActive && qCurrent.useX) qCurXDone = true;
-    } else {
-      float t = (float)dt / (float)mx.durMs;
-      v1 = mx.start + (mx.target - mx.start) * t;
-      applyOutputs();
-    }
+// Returns the cache index holding the named entry, loading it from flash on a miss.
+int PanTiltRig::storeGet(uint8_t kind, const String& name, const char*& errCode, const char*& errMsg) {
+  uint32_t hash = storeHash(name);
+  int ci = storeCacheFind(kind, hash);
+  if (ci >= 0 && strncmp(storeCache[ci].name, name.c_str(), STORE_NAME_MAX) == 0) {
+    storeCache[ci].lastUse = ++storeUseClock;
+    storeStats.hits++;
+    return ci;
   }
+  storeStats.misses++;
+
+  char key[12];
+  storeKey(key, sizeof(key), kind, hash);
+  prefs.begin(rigCfg.storeNs, true);
+  size_t n = prefs.getBytesLength(key);
+  uint8_t* rec = (n >= sizeof(StoreRecordHeader) && n <= sizeof(StoreRecordHeader) + FAV_CODE_MAX) ? (uint8_t*)malloc(n) : nullptr;
+  bool got = rec && prefs.getBytes(key, rec, n) == n;
+  prefs.end();
 
-  if (my.active) {
+  if (!got) { free(rec); errCode="not_found"; errMsg="No entry with that name"; return -1; }
+
+  StoreRecordHeader h;
+  memcpy(&h, rec, sizeof(h));
+  const uint8_t* data = rec + sizeof(h);
+  h.name[STORE_NAME_MAX] = 0;
+  if (h.version != STORE_REC_VERSION || h.kind != kind || strcmp(h.name, name.c_str()) != 0) {
+    free(rec); errCode="not_found"; errMsg="No entry with that name"; return -1;
+  }
+  if (sizeof(h) + h.len != n || crc32_update(0, data, h.len) != h.crc) {
+    free(rec); errCode="bad_record"; errMsg="Stored entry failed its CRC check"; return -1;
+  }
+
+  ci = storeCacheVictim();
+  if (ci < 0) { free(rec); errCode="store_busy"; errMsg="All cached entries are in use"; return -1; }
+  storeCacheDrop(ci);
+
+  StoreCacheEntry& e = storeCache[ci];
+  bool ok = true;
+  if (kind == SK_PRESET || kind == SK_TARGET) {
+    uint16_t want = (kind == SK_TARGET ? 3 : 2) * sizeof(float);
+    if (h.len == want) {
+      memcpy(&e.x, data, sizeof(float));
+      memcpy(&e.y, data + sizeof(float), sizeof(float));
+      if (kind == SK_TARGET) memcpy(&e.z, data + 2 * sizeof(float), sizeof(float));
+    } else {
+      ok = false;
+    }
+  } else {
+    ok = favCodeAssign(e.code, data, h.len) && favCodeValid(e.code);
+  }
+  free(rec);
+  if (!ok) { storeCacheDrop(ci); errCode="bad_record"; errMsg="Stored entry is malformed"; return -1; }
+
+  e.used = true;
+  e.kind = kind;
+  e.hash = hash;
+  e.lastUse = ++storeUseClock;
+  memcpy(e.name, h.name, sizeof(e.name));
+  return ci;
+}
+
+bool PanTiltRig::storeDelete(uint8_t kind, const String& name, const char*& errCode, const char*& errMsg) {
+  uint32_t hash = storeHash(name);
+  int ci = storeCacheFind(kind, hash);
+  if (ci >= 0 && macroSlotRunning(storeMacroSlot(ci))) { errCode="macro_busy"; errMsg="Cannot delete a macro while it runs"; return false; }
+
+  char key[12];
+  storeKey(key, sizeof(key), kind, hash);
+  prefs.begin(rigCfg.storeNs, false);
+  uint16_t count = storeCount();
+  int pos = storeIndexFind(kind, hash, count);
+  bool ok = pos >= 0;
+  if (!ok) { errCode="not_found"; errMsg="No entry with that name"; }
+
+  if (ok) {
+    // move the last index entry into the hole
+    uint16_t last = count - 1;
+    uint16_t lastPage = last / IDX_PAGE_ENTRIES;
+    storeReadPage(lastPage, count);
+    StoreIndexEntry moved = storePage[last % IDX_PAGE_ENTRIES];
+    uint16_t page = pos / IDX_PAGE_ENTRIES;
+    if (page != lastPage) {
+      storeWritePage(lastPage, (uint8_t)(last % IDX_PAGE_ENTRIES));
+      uint8_t n = storeReadPage(page, count);
+      storePage[pos % IDX_PAGE_ENTRIES] = moved;
+      ok = storeWritePage(page, n);
+    } else {
+      storePage[pos % IDX_PAGE_ENTRIES] = moved;
+      ok = storeWritePage(page, (uint8_t)(last % IDX_PAGE_ENTRIES));
+    }
+    ok = ok && prefs.putUShort("ixn", last) && prefs.remove(key);
+    if (!ok) { errCode="write_failed"; errMsg="Could not update store index"; }
+  }
+  prefs.end();
+
+  if (ci >= 0) storeCacheDrop(ci);
+  if (ok) persistStats.writes++;
+  return ok;
+}
+
+// One favList page of store entries; kind 0 lists both kinds. Only one index page is
+// held in RAM at a time, so clients walk the list with "page" until "more" is false.
+void PanTiltRig::sendStoreListPage(uint32_t id, const String& subsystem, const String& route, PanTiltLink mirror, uint8_t kind, uint16_t page) {
+  if (!sinkWants(PanTiltMsg::Ack, mirror)) return;
+  String out;
+  out.reserve(160 + STORE_LIST_PAGE * 64);
+  out += "{\"ok\":true,\"id\":";
+  out += String(id);
+  appendRoutingFields(out, subsystem, route);
+  out += ",\"page\":";
+  out += String(page);
+  out += ",\"entries\":[";
+
+  prefs.begin(rigCfg.storeNs, true);
+  uint16_t count = storeCount();
+  uint32_t skip = (uint32_t)page * STORE_LIST_PAGE;
+  uint8_t listed = 0;
+  bool more = false;
+  for (uint16_t ip=0; ip * IDX_PAGE_ENTRIES < count && !more; ip++) {
+    uint8_t n = storeReadPage(ip, count);
+    for (uint8_t i=0;i<n;i++) {
+      const StoreIndexEntry& e = storePage[i];
+      if (kind && e.kind != kind) continue;
+      if (skip) { skip--; continue; }
+      if (listed == STORE_LIST_PAGE) { more = true; break; }
+      if (listed++) out += ",";
+      out += "{\"name\":\"";
+      appendJsonEscaped(out, e.name);
+      out += "\",\"kind\":\"";
+      out += storeKindName(e.kind);
+      out += "\",\"bytes\":";
+      out += String(e.len);
+      out += "}";
+    }
+  }
+  prefs.end();
+
+  out += "],\"more\":";
+  out += (more ? "true" : "false");
+  out += ",\"total\":";
+  out += String(count);
+  out += ",\"cache\":{\"hits\":";
+  out += String(storeStats.hits);
+  out += ",\"misses\":";
+  out += String(storeStats.misses);
+  out += "}}";
+  emitLine(PanTiltMsg::Ack, out, mirror);
+}
+
+bool PanTiltRig::storeFactoryReset() {
+  storeClearCache();
+  prefs.begin(rigCfg.storeNs, false);
+  bool ok = prefs.clear();
+  prefs.end();
+  return ok;
+}
+
+// ------------------- Macro Runner -------------------
+// Macros run on a small cooperative VM: favRun claims a MacroVm, and PanTilt_loop()
+// executes at most MACRO_TICK_BUDGET ops per running macro per tick. Waits (waitMs,
+// waitIdle, a full queue) just leave the program counter where it is until the next tick.
+static const uint8_t MACRO_TICK_BUDGET = 8;
+
+uint8_t PanTiltRig::macroActiveCount() {
+  uint8_t n = 0;
+  for (uint8_t i=0;i<MACRO_VMS;i++) if (macroVm[i].active) n++;
+  return n;
+}
+
+bool PanTiltRig::macroSlotRunning(int idx) {
+  for (uint8_t i=0;i<MACRO_VMS;i++) if (macroVm[i].active && macroVm[i].slot == idx) return true;
+  return false;
+}
+
+const FavCode& PanTiltRig::macroCode(int slot) {
+  if (slot < CMD_FAV_SLOTS) return cmdFav[slot];
+  return storeCache[slot - CMD_FAV_SLOTS].code;
+}
+
+bool PanTiltRig::shouldEnqueue(QueueMode mode, bool hasQ, bool qVal) {
+  // Inside a macro, steps queue unless they explicitly say q:false.
+  if (macroRunning) {
+    if (hasQ && !qVal) return false;
+    return true;
+  }
+
+  if (mode == Q_ON || mode == Q_BLEND) return !(hasQ && qVal == false);
+  if (mode == Q_OFF) return (hasQ && qVal == true);
+  return (hasQ && qVal == true);
+}
+
+bool PanTiltRig::buildPositionStep(
+  uint32_t id, const String& subsystem, const String& route, const char* kind, float tx, float ty,
+  bool useX, bool useY, bool hasDur, float durSec, bool hasSpeed, float sp,
+  QueueItem& it
+) {
+  uint32_t dx=0, dy=0;
+  if (!computeDurations(useX,useY,tx,ty,hasDur,durSec,hasSpeed,sp,dx,dy)) return false;
+
+  it.id = id; it.subsystem=subsystem; it.route=route; it.kind=kind;
+  it.useX=useX; it.useY=useY; it.tx=tx; it.ty=ty; it.dx=dx; it.dy=dy;
+  return true;
+}
+
+bool PanTiltRig::buildRecallStep(
+  uint32_t id, const String& subsystem, const String& route, int idx,
+  bool useX, bool useY, bool hasDur, float durSec, bool hasSpeed, float sp,
+  QueueItem& it
+) {
+  return buildPositionStep(id, subsystem, route, "recall", posFavX[idx], posFavY[idx], useX, useY, hasDur, durSec, hasSpeed, sp, it);
+}
+
+// Queues or runs a step; false means the queue was full.
+bool PanTiltRig::dispatchStep(const QueueItem& it, bool enqueue) {
+  if (enqueue) return qEnqueue(it);
+  executeStep(it);
+  return true;
+}
+
+static void readTiming(CodeReader& r, uint8_t f, bool& hasDur, float& durSec, bool& hasSpeed, float& sp) {
+  hasDur = (f & MF_DUR) != 0;
+  hasSpeed = (f & MF_SPEED) != 0;
+  if (hasDur) durSec = r.f32();
+  if (hasSpeed) sp = r.f32();
+}
+
+bool PanTiltRig::motionIdle() {
+  return qIsEmpty() && !qAnyActive() && !mx.active && !my.active && !jog.x.active && !jog.y.active && !pat.active && !blendSeg.active;
+}
+
+// Executes the op at vm.pc. MR_YIELD leaves pc on the op so it is retried next tick.
+MacroOpResult PanTiltRig::macroExecOp(MacroVm& vm, const FavCode& fc) {
+  const uint8_t* base = fc.blob;
+  CodeReader r{base + vm.pc, base + fc.len};
+  const String& subsystem = vm.subsystem;
+  const String& route = vm.route;
+  const PanTiltLink mirror = vm.mirror;
+
+  uint8_t op = r.u8();
+  switch (op) {
+    case OP_END: return MR_END;
+
+    case OP_MOVE: {
+      MotionArgs a;
+      a.kind = (MotionKind)r.u8();
+      uint8_t f = r.u8();
+      a.useX = (f & MF_X) != 0;
+      a.useY = (f & MF_Y) != 0;
+      a.hasX = (f & MF_HAS_X) != 0;
+      a.hasY = (f & MF_HAS_Y) != 0;
+      if (a.hasX) a.x = r.f32();
+      if (a.hasY) a.y = r.f32();
+      readTiming(r, f, a.hasDur, a.durSec, a.hasSpeed, a.speed);
+      if (r.bad) return MR_BAD;
+
+      bool enqueue = shouldEnqueue(qMode, f & MF_HAS_Q, f & MF_Q);
+      if (enqueue && qIsFull()) return MR_YIELD;
+
+      QueueItem it;
+      const char* ec=""; const char* em="";
+      uint32_t stepId = ++autoId;
+      if (buildStepFromArgs(stepId, subsystem, route, a, it, ec, em)) {
+        it.mirrorToBle = mirror;
+        if (!refuseTargetInZone(it, enqueue)) dispatchStep(it, enqueue);
+      } else {
+        sendErr(stepId, subsystem, route, mirror, ec, em);
+      }
+      break;
+    }
+
+    case OP_RECALL: {
+      int idx = r.u8() - 1;
+      uint8_t f = r.u8();
+      bool hasDur, hasSpeed; float durSec=-1, sp=-1;
+      readTiming(r, f, hasDur, durSec, hasSpeed, sp);
+      if (r.bad) return MR_BAD;
+
+      bool enqueue = shouldEnqueue(qMode, f & MF_HAS_Q, f & MF_Q);
+      if (enqueue && qIsFull()) return MR_YIELD;
+
+      uint32_t stepId = ++autoId;
+      QueueItem it;
+      if (idx < 0 || idx >= POS_FAV_SLOTS || !posFavValid[idx]) {
+        sendErr(stepId, subsystem, route, mirror, "empty_slot", "slot not saved yet");
+      } else if (!buildRecallStep(stepId, subsystem, route, idx, f & MF_X, f & MF_Y, hasDur, durSec, hasSpeed, sp, it)) {
+        sendErr(stepId, subsystem, route, mirror, "bad_timing", "Invalid dur or speed");
+      } else {
+        it.mirrorToBle = mirror;
+        if (!refuseTargetInZone(it, enqueue)) dispatchStep(it, enqueue);
+      }
+      break;
+    }
+
+    case OP_QUEUE: {
+      // Macro steps always enqueue, so only the execution side of the mode matters here:
+      // entering or leaving blend, and the lane layout.
+      uint8_t m = r.u8();
+      uint8_t lanes = r.u8();
+      vm.queueChanged = true;
+      if (m == Q_BLEND || (qMode == Q_BLEND && m <= Q_STEP)) qMode = (QueueMode)m;
+      if (lanes != 0xFF) qLanes = (lanes == QL_AXIS) ? QL_AXIS : QL_SINGLE;
+      break;
+    }
+
+    case OP_QSYNC: {
+      if (qIsFull()) return MR_YIELD;
+      QueueItem it;
+      it.id = ++autoId; it.subsystem = subsystem; it.route = route; it.kind = "sync";
+      it.mirrorToBle = mirror;
+      it.useX = true; it.useY = true; it.barrier = true;
+      qEnqueue(it);
+      break;
+    }
+
+    case OP_QCLEAR: qClearAll(); break;
+    case OP_QABORT: abortQueueAndMotion(); applyOutputs(); break;
+    case OP_RESETALL: abortQueueAndMotion(); v1 = 0; v2 = 0; applyOutputs(); break;
+
+    case OP_STOP: {
+      uint8_t f = r.u8();
+      if (f & MF_X) stopX();
+      if (f & MF_Y) stopY();
+      applyOutputs();
+      break;
+    }
+
+    case OP_STOPALL: {
+      bool flush = r.u8() != 0;
+      stopAllMotion();
+      if (flush) { qClearAll(); qDeactivateLanes(); }
+      applyOutputs();
+      break;
+    }
+
+    case OP_INVERT: {
+      uint8_t f = r.u8();
+      if (f & MF_X) toggleInvertX();
+      if (f & MF_Y) toggleInvertY();
+      applyOutputs();
+      break;
+    }
+
+    case OP_SPEED: {
+      float sp = r.f32();
+      if (r.bad) return MR_BAD;
+      defaultSpeed = sp;
+      markDirty(DIRTY_SPEED);
+      break;
+    }
+
+    case OP_SAVE: {
+      int idx = r.u8() - 1;
+      if (idx < 0 || idx >= POS_FAV_SLOTS) return MR_BAD;
+      posFavValid[idx] = true;
+      posFavX[idx] = v1;
+      posFavY[idx] = v2;
+      markDirty(dirtyPos(idx));
+      break;
+    }
+
+    case OP_RAW: {
+      uint16_t n = r.u16();
+      if (!r.need(n)) return MR_BAD;
+      String one;
+      one.reserve(n);
+      one.concat((const char*)r.p, n);
+      r.p += n;
+      vm.pc = (uint16_t)(r.p - base);   // handler may stop this VM; advance first
+      handleCommandLine(one);
+      return MR_NEXT;
+    }
+
+    case OP_WAIT_MS: {
+      uint32_t ms = r.u32();
+      if (r.bad) return MR_BAD;
+      if (!vm.waiting) { vm.waiting = true; vm.waitUntil = millis() + ms; }
+      if ((int32_t)(millis() - vm.waitUntil) < 0) return MR_YIELD;
+      vm.waiting = false;
+      break;
+    }
+
+    case OP_WAIT_IDLE:
+      if (!motionIdle()) return MR_YIELD;
+      break;
+
+    case OP_LOOP: {
+      uint16_t n = r.u16();
+      if (r.bad || vm.depth >= MACRO_LOOP_DEPTH) return MR_BAD;
+      MacroLoop& lp = vm.loops[vm.depth++];
+      lp.bodyPc = (uint16_t)(r.p - base);
+      lp.remaining = n;
+      break;
+    }
+
+    case OP_END_LOOP: {
+      if (!vm.depth) return MR_BAD;
+      MacroLoop& lp = vm.loops[vm.depth - 1];
+      if (--lp.remaining > 0) { vm.pc = lp.bodyPc; return MR_NEXT; }
+      vm.depth--;
+      break;
+    }
+
+    case OP_REPEAT:
+      vm.pc = 2;
+      vm.depth = 0;
+      return MR_NEXT;
+
+    default:
+      return MR_BAD;
+  }
+
+  if (r.bad) return MR_BAD;
+  vm.pc = (uint16_t)(r.p - base);
+  return MR_NEXT;
+}
+
+// Every way out of a macro (completed, stopped or bad bytecode) goes through here, so a
+// queue mode/lanes change made by the macro never outlives it.
+void PanTiltRig::macroRelease(MacroVm& vm) {
+  vm.active = false;
+  if (vm.queueChanged) {
+    qMode = vm.savedMode;
+    qLanes = vm.savedLanes;
+  }
+}
+
+void PanTiltRig::macroFinish(MacroVm& vm, const char* msg) {
+  macroRelease(vm);
+  sendOk(vm.id, vm.subsystem, vm.route, vm.mirror, msg, RK_DONE);
+  sendState("done", vm.id, vm.subsystem, vm.route, vm.mirror);
+}
+
+// Stops running macros; slot < 0 stops all of them.
+uint8_t PanTiltRig::macroStop(int slot, const char* msg) {
+  uint8_t n = 0;
+  for (uint8_t i=0;i<MACRO_VMS;i++) {
+    MacroVm& vm = macroVm[i];
+    if (!vm.active || (slot >= 0 && vm.slot != slot)) continue;
+    macroFinish(vm, msg);
+    n++;
+  }
+  return n;
+}
+
+bool PanTiltRig::macroStart(uint32_t id, const String& subsystem, const String& route, PanTiltLink mirror, int slot) {
+  if (!favCodeValid(macroCode(slot))) {
+    sendErr(id, subsystem, route, mirror, "bad_macro", "Favorite bytecode is invalid");
+    return false;
+  }
+  if (macroSlotRunning(slot)) {
+    sendErr(id, subsystem, route, mirror, "macro_busy", "This favorite is already running");
+    return false;
+  }
+  for (uint8_t i=0;i<MACRO_VMS;i++) {
+    MacroVm& vm = macroVm[i];
+    if (vm.active) continue;
+    vm = MacroVm();
+    vm.active = true;
+    vm.slot = (uint8_t)slot;
+    vm.id = id;
+    vm.subsystem = subsystem;
+    vm.route = route;
+    vm.mirror = mirror;
+    vm.pc = 2;   // skip [version][steps]
+    vm.savedMode = qMode;
+    vm.savedLanes = qLanes;
+    return true;
+  }
+  sendErr(id, subsystem, route, mirror, "macro_busy", "Too many macros running");
+  return false;
+}
+
+void PanTiltRig::macroTick() {
+  for (uint8_t i=0;i<MACRO_VMS;i++) {
+    MacroVm& vm = macroVm[i];
+    for (uint8_t n=0; n<MACRO_TICK_BUDGET && vm.active; n++) {
+      const FavCode& fc = macroCode(vm.slot);
+      if (!favCodeValid(fc) || vm.pc >= fc.len) { macroFinish(vm, "macro_complete"); break; }
+
+      macroRunning = true;
+      MacroOpResult res = macroExecOp(vm, fc);
+      macroRunning = false;
+      if (!vm.active) break;   // stopped by its own raw line
+
+      if (res == MR_NEXT) { vm.opsRun++; continue; }
+      if (res == MR_YIELD) break;
+      if (res == MR_END) { macroFinish(vm, "macro_complete"); break; }
+
+      macroRelease(vm);
+      sendErr(vm.id, vm.subsystem, vm.route, vm.mirror, "bad_macro", "Favorite bytecode is truncated or corrupt");
+    }
+  }
+}
+
+// ------------------- Scheduler -------------------
+void PanTiltRig::startLane(QueueLane& ln, const QueueItem& it) {
+  ln.cur = it;
+  ln.active = true;
+  ln.startedAt = millis();
+  ln.xDone = !it.useX || it.barrier || (it.dx == 0);
+  ln.yDone = !it.useY || it.barrier || (it.dy == 0);
+
+  uint32_t maxDur = 0;
+  if (it.useX && it.dx > maxDur) maxDur = it.dx;
+  if (it.useY && it.dy > maxDur) maxDur = it.dy;
+  ln.cur.expectedEnd = ln.startedAt + maxDur + STEP_TIMEOUT_GRACE_MS;
+
+  sendEventStarted(ln.cur);
+  if (qMode == Q_BLEND) {
+    mx.active = my.active = false;
+    startBlendSegment(ln.cur);
+    ln.xDone = ln.yDone = !blendSeg.active;
+    ln.cur.expectedEnd = ln.startedAt + blendSeg.totalMs + STEP_TIMEOUT_GRACE_MS;
+  }
+  else if (qLanes == QL_AXIS) startStepAxes(ln.cur);  // leave the other lane's axis running
+  else executeStep(ln.cur);
+
+  bool moving = (ln.cur.useX && mx.active) || (ln.cur.useY && my.active);
+  if (!moving && ln.xDone && ln.yDone) {
+    sendEventStepDone(ln.cur);
+    ln.active = false;
+  }
+}
+
+void PanTiltRig::maybeStartNextQueuedStep() {
+  if (qIsEmpty()) return;
+
+  if (qLanes == QL_SINGLE || qMode == Q_BLEND) {
+    if (qAnyActive()) return;
+    if (mx.active || my.active || blendSeg.active) return;
+    const QueueItem& head = q[qHead];   // a jogging axis holds back the steps that need it
+    if ((jog.x.active && (head.useX || head.barrier || qMode == Q_BLEND)) ||
+        (jog.y.active && (head.useY || head.barrier || qMode == Q_BLEND))) return;
+    QueueItem it;
+    if (!qDequeue(it)) return;
+    startLane(qLane[0], it);
+    return;
+  }
+
+  // Axis lanes: walk the queue in order. An item may start once every axis it uses is
+  // free; an item that has to wait keeps its axes blocked so later items on those axes
+  // can't overtake it. Barriers use both axes and therefore wait for everything before them.
+  bool busyX = mx.active || jog.x.active || laneForAxis('x') != nullptr;
+  bool busyY = my.active || jog.y.active || laneForAxis('y') != nullptr;
+
+  uint8_t i = 0;
+  while (i < qCount && !(busyX && busyY)) {
+    const QueueItem& it = q[(uint8_t)((qHead + i) % QMAX)];
+    bool needX = it.useX || it.barrier;
+    bool needY = it.useY || it.barrier;
+
+    if ((needX && busyX) || (needY && busyY)) {
+      busyX = busyX || needX;
+      busyY = busyY || needY;
+      i++;
+      continue;
+    }
+
+    QueueLane& ln = (needX || !needY) ? qLane[0] : qLane[1];
+    if (ln.active) {
+      busyX = busyX || needX;
+      busyY = busyY || needY;
+      i++;
+      continue;
+    }
+
+    QueueItem started = it;
+    qRemoveAt(i);   // next candidate shifts into slot i
+    startLane(ln, started);
+    busyX = busyX || (needX && ln.active);
+    busyY = busyY || (needY && ln.active);
+  }
+}
+
+void PanTiltRig::finishAxisMove(char axis, uint32_t ref) {
+  QueueLane* ln = laneForAxis(axis);
+  PanTiltLink mirror = ln ? ln->cur.mirrorToBle : g_lastMirrorToBle;
+  sendEventDoneAxis(axis, ref, ln ? ln->cur.subsystem : lastSubsystem, ln ? ln->cur.route : lastRoute, mirror);
+
+  if (ln) {
+    if (axis == 'x') ln->xDone = true;
+    else ln->yDone = true;
+  }
+}
+
+void PanTiltRig::updateMotion() {
+  const uint32_t now = millis();
+
+  if (PanTiltBuild::jog) updateJog(now);
+  if (PanTiltBuild::sweepShapes) updatePattern(now);
+
+  if (mx.active) {
+    uint32_t dt = now - mx.t0;
+    if (dt >= mx.durMs) {
+      v1 = mx.target;
+      mx.active = false;
+      applyOutputs();
+      finishAxisMove('x', mx.cmdRef);
+    } else {
+      float t = (float)dt / (float)mx.durMs;
+      v1 = mx.start + (mx.target - mx.start) * t;
+      applyOutputs();
+    }
+  }
+
+  if (my.active) {
     uint32_t dt = now - my.t0;
     if (dt >= my.durMs) {
       v2 = my.target;
       my.active = false;
       applyOutputs();
-
-      bool mirror = qActive ? qCurrent.mirrorToBle : g_lastMirrorToBle;
-      sendEventDoneAxis('y', my.cmdRef, qActive ? qCurrent.subsystem : lastSubsystem, qActive ? qCurrent.route : lastRoute, mirror);
-
-      if (qActive && qCurrent.useY) qCurYDone = true;
+      finishAxisMove('y', my.cmdRef);
     } else {
       float t = (float)dt / (float)my.durMs;
       v2 = my.start + (my.target - my.start) * t;
@@ -1006,27 +2824,881 @@ static void updateMotion() {
     }
   }
 
-  if (qActive) {
-    if (qCurrent.expectedEnd != 0 && now > qCurrent.expectedEnd) {
-      sendEventFault(qCurrent.subsystem, qCurrent.route, qCurrent.mirrorToBle, "step_timeout", qCurrent.id,
+  if (updateBlend(now)) {
+    QueueLane& ln = qLane[0];
+    if (ln.active) {
+      if (ln.cur.useX && !ln.cur.barrier) finishAxisMove('x', ln.cur.id);
+      if (ln.cur.useY && !ln.cur.barrier) finishAxisMove('y', ln.cur.id);
+      ln.xDone = ln.yDone = true;
+    }
+  }
+
+  for (uint8_t i=0;i<QLANES;i++) {
+    QueueLane& ln = qLane[i];
+    if (!ln.active) continue;
+
+    if (ln.cur.expectedEnd != 0 && now > ln.cur.expectedEnd) {
+      sendEventFault(ln.cur.subsystem, ln.cur.route, ln.cur.mirrorToBle, "step_timeout", ln.cur.id,
                      "Queued step timed out; aborted");
       abortQueueAndMotion();
       applyOutputs();
       return;
     }
 
-    bool moving = mx.active || my.active;
-    if (!moving && qCurXDone && qCurYDone) {
-      sendEventStepDone(qCurrent);
-      qActive = false;
+    bool moving = (ln.cur.useX && mx.active) || (ln.cur.useY && my.active);
+    if (!moving && ln.xDone && ln.yDone) {
+      sendEventStepDone(ln.cur);
+      ln.active = false;
+    }
+  }
+
+  maybeStartNextQueuedStep();
+}
+
+// ------------------- Jog -------------------
+// "jog" sets per-axis velocities that the tick integrates, so a held button is one
+// refresh per keepalive period and the axis ramps instead of restarting from rest.
+static const float JOG_MAX_SPEED = 1000.0f;
+
+// Ramps vel toward target, braking early so the axis stops at the travel limit.
+static void jogAxisStep(JogAxis& a, float& pos, float lo, float hi, float accel, float dt) {
+  float want = a.target;
+  float room = a.vel > 0 ? hi - pos : pos - lo;
+  if (a.vel * want > 0 && a.vel * a.vel >= 2.0f * accel * room) want = 0;
+
+  float dv = accel * dt;
+  a.vel += clampf(want - a.vel, -dv, dv);
+  pos += a.vel * dt;
+  if (pos <= lo || pos >= hi) { pos = clampf(pos, lo, hi); a.vel = 0; }
+  if (a.vel == 0 && a.target == 0) a.active = false;
+}
+
+void PanTiltRig::updateJog(uint32_t now) {
+  if (!jog.x.active && !jog.y.active) return;
+
+  float dt = (float)(now - jog.lastTick) * 0.001f;
+  jog.lastTick = now;
+  if (dt > 0.1f) dt = 0.1f;   // a stalled loop shouldn't turn into a jump
+
+  if (!jog.expired && now - jog.refreshedAt > jog.keepaliveMs) {
+    jog.expired = true;
+    jog.x.target = jog.y.target = 0;
+    sendEventFault(jog.subsystem, jog.route, jog.origin, "jog_timeout", jog.ref, "No jog keepalive; ramping to a stop");
+  }
+
+  if (jog.x.active) jogAxisStep(jog.x, v1, limits.minX, limits.maxX, jog.accel, dt);
+  if (jog.y.active) jogAxisStep(jog.y, v2, limits.minY, limits.maxY, jog.accel, dt);
+  applyOutputs();
+
+  if (!jog.x.active && !jog.y.active) sendState("jog_stopped", jog.ref, jog.subsystem, jog.route, jog.origin, RK_DONE);
+}
+
+// Ends the positioned move, pattern or blend segment that had the axis. The queue lane
+// that owned it is finished here, or it would time out and abort the jog along with it.
+void PanTiltRig::jogTakeAxis(char axis) {
+  MoveProfile& m = (axis == 'x') ? mx : my;
+  if (m.active) { m.active = false; finishAxisMove(axis, m.cmdRef); }
+  if (axis == 'x' ? pat.useX : pat.useY) stopPattern();
+  if (blendSeg.active) {   // one segment drives both axes
+    QueueLane& ln = qLane[0];
+    if (ln.active) {
+      if (ln.cur.useX && !ln.cur.barrier && !ln.xDone) finishAxisMove('x', ln.cur.id);
+      if (ln.cur.useY && !ln.cur.barrier && !ln.yDone) finishAxisMove('y', ln.cur.id);
+      ln.xDone = ln.yDone = true;
+    }
+  }
+  stopBlend();
+}
+
+// Link gone: treat it as an immediate keepalive lapse.
+void PanTiltRig::linkClosed(PanTiltLink link) {
+  replayDropLink(link);   // a new central may reuse the connection id and restart its ids
+  if ((jog.x.active || jog.y.active) && jog.origin == link) jog.refreshedAt = millis() - jog.keepaliveMs - 1;
+}
+
+// ------------------- Sweep Patterns -------------------
+// Shapes are closed-form in the cycle position c = whole + frac, so a tick costs a
+// few table lookups and the end lands exactly on phase + count. Before cycle 0 the
+// rig eases from wherever it was to the start point at the default speed.
+static const char* const SWEEP_SHAPE_NAMES[] = { "sine", "ease", "raster", "spiral", "lissajous" };
+static const float RASTER_TRAVERSE = 0.8f;   // share of a raster row spent crossing; the rest steps down
+
+static float easeStep(float s) { return s * s * s * (s * (s * 6.0f - 15.0f) + 10.0f); }   // zero vel/acc at ends
+static float fracf(float x) { return x - floorf(x); }
+
+static uint16_t rasterRow(uint32_t k, uint16_t span) {   // rows ping-pong 0..span..0
+  uint32_t m = k % (2u * span);
+  return (uint16_t)(m < span ? m : 2u * span - m);
+}
+
+// Offsets in -1..1 per axis at cycle whole + frac (frac in [0,1)).
+static void patternEval(const SweepPattern& p, uint32_t whole, float frac, float& ux, float& uy) {
+  switch (p.shape) {
+    case SS_SINE:
+      ux = uy = sinDeg(360.0f * frac);
+      break;
+    case SS_EASE: {   // there and back per cycle, each leg eased
+      float s = frac < 0.5f ? easeStep(2.0f * frac) : 1.0f - easeStep(2.0f * frac - 1.0f);
+      ux = uy = 2.0f * s - 1.0f;
+      break;
+    }
+    case SS_RASTER: {   // a cycle is down the rows and back up: 2*(lines-1) row slots
+      uint16_t span = p.lines - 1;
+      float slots = frac * (float)(2 * span);
+      uint32_t k = (uint32_t)slots;
+      float s = slots - (float)k;
+      float dir = (k & 1) ? -1.0f : 1.0f;
+      float r0 = rasterRow(k, span), r1 = rasterRow(k + 1, span);
+      float row = r0;
+      if (s < RASTER_TRAVERSE) ux = dir * (2.0f * easeStep(s / RASTER_TRAVERSE) - 1.0f);
+      else { ux = dir; row = r0 + (r1 - r0) * easeStep((s - RASTER_TRAVERSE) / (1.0f - RASTER_TRAVERSE)); }
+      uy = 1.0f - 2.0f * row / (float)span;
+      break;
+    }
+    case SS_SPIRAL: {   // out over the first half, back in over the second
+      float r = frac < 0.5f ? easeStep(2.0f * frac) : 1.0f - easeStep(2.0f * frac - 1.0f);
+      float a = 360.0f * (fracf(p.ratio * (float)whole) + p.ratio * frac);
+      ux = r * cosDeg(a);
+      uy = r * sinDeg(a);
+      break;
+    }
+    case SS_LISSAJOUS:
+      ux = sinDeg(360.0f * frac);
+      uy = sinDeg(360.0f * (fracf(p.ratio * (float)whole) + p.ratio * frac));
+      break;
+  }
+}
+
+static void patternAt(const SweepPattern& p, uint32_t whole, float frac, float& x, float& y) {
+  float ux = 0.0f, uy = 0.0f;
+  patternEval(p, whole, frac, ux, uy);
+  x = clampf(p.cx + p.ax * ux, POS_MIN, POS_MAX);
+  y = clampf(p.cy + p.ay * uy, POS_MIN, POS_MAX);
+}
+
+void PanTiltRig::stopPattern() { pat.active = false; }
+
+void PanTiltRig::updatePattern(uint32_t now) {
+  if (!pat.active) return;
+
+  float x, y;
+  uint32_t t = now - pat.t0;
+  if (t < pat.leadMs) {
+    float sx, sy;
+    patternAt(pat, 0, pat.phase, sx, sy);
+    float e = easeStep((float)t / (float)pat.leadMs);
+    x = pat.leadX + (sx - pat.leadX) * e;
+    y = pat.leadY + (sy - pat.leadY) * e;
+  } else {
+    t -= pat.leadMs;
+    uint32_t whole = t / pat.periodMs;
+    float frac = pat.phase + (float)(t % pat.periodMs) / (float)pat.periodMs;
+    if (frac >= 1.0f) { frac -= 1.0f; whole++; }
+    bool done = pat.count && (whole > pat.count || (whole == pat.count && frac >= pat.phase));
+    if (done) { whole = pat.count; frac = pat.phase; }
+    patternAt(pat, whole, frac, x, y);
+    if (done) pat.active = false;
+  }
+
+  if (pat.useX) v1 = x;
+  if (pat.useY) v2 = y;
+  applyOutputs();
+  if (!pat.active) sendState("sweep_done", pat.ref, pat.subsystem, pat.route, pat.origin, RK_DONE);
+}
+
+// ------------------- Camera Projection -------------------
+// "look" takes normalized image coordinates (u right, v up, -1..1 at the frame edges)
+// and aims the optical axis through that pixel with a pinhole model. The camera's
+// current pan/tilt rotate the ray into the rig frame, so one message per frame gives
+// an absolute target instead of a tuned step.
+static const uint8_t CAM_VERSION = 1;
+
+// Small versioned blobs (cam, frame) end in a crc32 over the rest of the struct.
+template <typename T> static uint32_t blobCrc(T c) {
+  c.crc32 = 0;
+  return crc32_update(0, (const uint8_t*)&c, sizeof(c));
+}
+
+static float tanHalfDeg(float fov) { return sinDeg(fov * 0.5f) / cosDeg(fov * 0.5f); }
+
+void PanTiltRig::cameraDefaults() {
+  cam = CameraModel{};
+  cam.version = CAM_VERSION;
+  cam.hfov = 62.0f;
+  cam.vfov = 48.0f;
+  cameraDerive();
+}
+
+void PanTiltRig::cameraDerive() {
+  camTanH = tanHalfDeg(cam.hfov);
+  camTanV = tanHalfDeg(cam.vfov);
+}
+
+// prefs must be open
+bool PanTiltRig::loadCamera() {
+  CameraModel c{};
+  if (prefs.getBytes("cam", &c, sizeof(c)) != sizeof(c)) return false;
+  if (c.version != CAM_VERSION || blobCrc(c) != c.crc32) return false;
+  if (c.hfov < 1.0f || c.hfov > 170.0f || c.vfov < 1.0f || c.vfov > 170.0f) return false;
+  cam = c;
+  persistedCamCrc = c.crc32;
+  cameraDerive();
+  return true;
+}
+
+// prefs must be open for writing; same contract as persistNextKey()
+bool PanTiltRig::persistBlobKey(const char* key, uint16_t bit, const void* data, size_t n, uint32_t crc, uint32_t& persistedCrc) {
+  cfgDirty &= ~bit;
+  if (crc == persistedCrc) { persistStats.skipped++; return true; }
+  if (prefs.putBytes(key, data, n) != n) {
+    cfgDirty |= bit;
+    persistStats.failures++;
+    return false;
+  }
+  persistedCrc = crc;
+  persistStats.writes++;
+  return true;
+}
+
+bool PanTiltRig::persistCamera() {
+  cam.crc32 = blobCrc(cam);
+  return persistBlobKey("cam", DIRTY_CAM, &cam, sizeof(cam), cam.crc32, persistedCamCrc);
+}
+
+// Ray through (u,v) in camera coordinates (x right, y up, z forward), tilted then
+// panned by the camera's pose; the result is the servo pose that centres it.
+static void projectLook(const CameraModel& cam, float pan, float tilt, float u, float v,
+                        float tanH, float tanV, float& outPan, float& outTilt) {
+  float camPan = pan + cam.panOffset;
+  float camTilt = tilt + cam.tiltOffset;
+  float x = u * tanH, y = v * tanV, z = 1.0f;
+
+  float ct = cosDeg(camTilt), st = sinDeg(camTilt);
+  float y1 = y * ct + z * st;
+  float z1 = z * ct - y * st;
+
+  float cp = cosDeg(camPan), sp = sinDeg(camPan);
+  float x2 = x * cp + z1 * sp;
+  float z2 = z1 * cp - x * sp;
+
+  outPan = atan2Deg(x2, z2) - cam.panOffset;
+  outTilt = atan2Deg(y1, sqrtf(x2 * x2 + z2 * z2)) - cam.tiltOffset;
+}
+
+// ------------------- World Targeting -------------------
+// "lookAt" aims at a world point. The mount pose is folded into one rotation matrix
+// when it changes, so a solve is a matrix-vector product and three atan2 calls.
+// Named targets live in the preset/macro store as kind 't'.
+static const uint8_t FRAME_VERSION = 1;
+
+static void mat3Mul(const float a[9], const float b[9], float out[9]) {
+  for (uint8_t r=0;r<3;r++)
+    for (uint8_t c=0;c<3;c++)
+      out[r*3+c] = a[r*3]*b[c] + a[r*3+1]*b[3+c] + a[r*3+2]*b[6+c];
+}
+
+void PanTiltRig::frameDefaults() {
+  frame = RigFrame{};
+  frame.version = FRAME_VERSION;
+  frameDerive();
+}
+
+void PanTiltRig::frameDerive() {
+  float cy = cosDeg(frame.yaw), sy = sinDeg(frame.yaw);
+  float cp = cosDeg(frame.pitch), sp = sinDeg(frame.pitch);
+  float cr = cosDeg(frame.roll), sr = sinDeg(frame.roll);
+  const float ry[9] = { cy, 0, sy,   0, 1, 0,   -sy, 0, cy };   // +yaw turns forward toward +x
+  const float rx[9] = { 1, 0, 0,   0, cp, sp,   0, -sp, cp };   // +pitch turns forward toward +y
+  const float rz[9] = { cr, -sr, 0,   sr, cr, 0,   0, 0, 1 };
+  float t[9];
+  mat3Mul(ry, rx, t);
+  mat3Mul(t, rz, frameR);
+}
+
+// prefs must be open
+bool PanTiltRig::loadFrame() {
+  RigFrame f{};
+  if (prefs.getBytes("frame", &f, sizeof(f)) != sizeof(f)) return false;
+  if (f.version != FRAME_VERSION || blobCrc(f) != f.crc32) return false;
+  frame = f;
+  persistedFrameCrc = f.crc32;
+  frameDerive();
+  return true;
+}
+
+bool PanTiltRig::persistFrame() {
+  frame.crc32 = blobCrc(frame);
+  return persistBlobKey("frame", DIRTY_FRAME, &frame, sizeof(frame), frame.crc32, persistedFrameCrc);
+}
+
+// Two-axis IK: pan from the point's bearing in the mount frame, tilt from its
+// elevation above the tilt axis, corrected for an optical axis that sits camOffset
+// above that axis. False if the point is on the pan axis or out of servo range.
+bool PanTiltRig::solveLookAt(float wx, float wy, float wz, float& pan, float& tilt) {
+  float dx = wx - frame.x, dy = wy - frame.y, dz = wz - frame.z;
+  const float* R = frameR;   // world -> mount is R transposed
+  float lx = R[0]*dx + R[3]*dy + R[6]*dz;
+  float ly = R[1]*dx + R[4]*dy + R[7]*dz;
+  float lz = R[2]*dx + R[5]*dy + R[8]*dz;
+
+  float r = sqrtf(lx*lx + lz*lz);
+  if (r < 1e-3f) return false;
+  float h = ly - frame.tiltHeight;
+  float d = sqrtf(r*r + h*h);
+  if (d <= fabsf(frame.camOffset)) return false;
+
+  pan = atan2Deg(lx, lz) - cam.panOffset;
+  tilt = atan2Deg(h, r);
+  if (frame.camOffset != 0.0f) {
+    float s = frame.camOffset / d;
+    tilt -= atan2Deg(s, sqrtf(1.0f - s*s));
+  }
+  tilt -= cam.tiltOffset;
+  return pan >= POS_MIN - 0.5f && pan <= POS_MAX + 0.5f && tilt >= POS_MIN - 0.5f && tilt <= POS_MAX + 0.5f;
+}
+
+// ------------------- Limits and Keep-Out Zones -------------------
+// Soft limits narrow POS_MIN..POS_MAX per axis. Keep-out zones are polygons in
+// (pan, tilt); a 2-degree bitmap marks cells wholly inside a zone and cells an edge
+// crosses, so the per-tick check is a bit lookup and only edge cells run the exact
+// point-in-polygon test.
+static const uint8_t LIMITS_VERSION = 1;
+
+static uint16_t zoneCell(float v) { return (uint16_t)clampInt((int)((v - POS_MIN) / ZONE_GRID_DEG), 0, ZONE_GRID_N - 1); }
+static bool gridBit(const uint8_t* g, uint16_t i) { return (g[i >> 3] >> (i & 7)) & 1; }
+static void gridSet(uint8_t* g, uint16_t i) { g[i >> 3] |= (uint8_t)(1u << (i & 7)); }
+
+static bool pointInZone(const KeepOutZone& z, float x, float y) {
+  bool in = false;
+  for (uint8_t i=0, j=z.n-1; i<z.n; j=i++) {
+    if ((z.y[i] > y) != (z.y[j] > y) && x < z.x[j] + (z.x[i] - z.x[j]) * (y - z.y[j]) / (z.y[i] - z.y[j])) in = !in;
+  }
+  return in;
+}
+
+// Liang-Barsky: does the segment touch the closed box?
+static bool segHitsBox(float x0, float y0, float x1, float y1, float bx0, float by0, float bx1, float by1) {
+  float t0 = 0, t1 = 1, dx = x1 - x0, dy = y1 - y0;
+  const float p[4] = { -dx, dx, -dy, dy };
+  const float q[4] = { x0 - bx0, bx1 - x0, y0 - by0, by1 - y0 };
+  for (uint8_t i=0;i<4;i++) {
+    if (p[i] == 0) { if (q[i] < 0) return false; continue; }
+    float t = q[i] / p[i];
+    if (p[i] < 0) { if (t > t1) return false; if (t > t0) t0 = t; }
+    else          { if (t < t0) return false; if (t < t1) t1 = t; }
+  }
+  return true;
+}
+
+void PanTiltRig::limitsDefaults() {
+  limits = LimitConfig{};
+  limits.version = LIMITS_VERSION;
+  limits.minX = limits.minY = POS_MIN;
+  limits.maxX = limits.maxY = POS_MAX;
+  limitsDerive();
+}
+
+void PanTiltRig::limitsDerive() {
+  memset(zoneInside, 0, sizeof(zoneInside));
+  memset(zoneEdge, 0, sizeof(zoneEdge));
+  const uint8_t zoneCount = PanTiltBuild::zones ? ZONE_MAX : 0;   // stored zones stay, unenforced
+  for (uint8_t zi=0;zi<zoneCount;zi++) {
+    const KeepOutZone& z = limits.zones[zi];
+    if (z.n < 3) continue;
+    float lx = z.x[0], hx = lx, ly = z.y[0], hy = ly;
+    for (uint8_t k=1;k<z.n;k++) {
+      lx = fminf(lx, z.x[k]); hx = fmaxf(hx, z.x[k]);
+      ly = fminf(ly, z.y[k]); hy = fmaxf(hy, z.y[k]);
+    }
+    for (uint16_t r=zoneCell(ly); r<=zoneCell(hy); r++) {
+      for (uint16_t c=zoneCell(lx); c<=zoneCell(hx); c++) {
+        uint16_t i = r * ZONE_GRID_N + c;
+        float bx = POS_MIN + c * ZONE_GRID_DEG, by = POS_MIN + r * ZONE_GRID_DEG;
+        bool edge = false;
+        for (uint8_t k=0, j=z.n-1; k<z.n && !edge; j=k++)
+          edge = segHitsBox(z.x[j], z.y[j], z.x[k], z.y[k], bx, by, bx + ZONE_GRID_DEG, by + ZONE_GRID_DEG);
+        if (edge) gridSet(zoneEdge, i);
+        else if (pointInZone(z, bx + ZONE_GRID_DEG * 0.5f, by + ZONE_GRID_DEG * 0.5f)) gridSet(zoneInside, i);
+      }
+    }
+  }
+  if (safeValid && !poseAllowed(safeX, safeY)) safeValid = false;
+}
+
+bool PanTiltRig::poseAllowed(float x, float y) {
+  if (x < limits.minX || x > limits.maxX || y < limits.minY || y > limits.maxY) return false;
+  if (!PanTiltBuild::zones) return true;
+  uint16_t i = zoneCell(y) * ZONE_GRID_N + zoneCell(x);
+  if (gridBit(zoneInside, i)) return false;
+  if (!gridBit(zoneEdge, i)) return true;
+  for (uint8_t zi=0;zi<ZONE_MAX;zi++) {
+    if (limits.zones[zi].n >= 3 && pointInZone(limits.zones[zi], x, y)) return false;
+  }
+  return true;
+}
+
+// Every positioned command (set/adjust/center, qAdd, recall, presetGo, look, lookAt,
+// tracking and macro moves) passes its step through here before running or queueing it.
+// A step that would end inside a zone is refused with pose_in_zone; one that only crosses
+// a zone is clipped when it starts. Axes the step leaves alone come from the current
+// pose, so a queued single-axis step is only checked when it runs.
+bool PanTiltRig::refuseTargetInZone(const QueueItem& it, bool queued) {
+  if (!PanTiltBuild::zones || it.barrier) return false;
+  if (queued && !(it.useX && it.useY)) return false;
+  float x = it.useX ? clampf(it.tx, limits.minX, limits.maxX) : v1;
+  float y = it.useY ? clampf(it.ty, limits.minY, limits.maxY) : v2;
+  if (poseAllowed(x, y)) return false;
+  sendErr(it.id, it.subsystem, it.route, it.mirrorToBle, "pose_in_zone", "Target is inside a keep-out zone");
+  return true;
+}
+
+// Walks the step's path (each axis linear over its own duration) in half-cell samples
+// and, if it enters a zone, pulls the target and durations back to the last allowed
+// point. An instant step (no duration) is walked as the straight segment. A start that
+// is already inside a zone is left alone so the rig can move out.
+bool PanTiltRig::clipPath(float x0, float y0, float& x1, float& y1, uint32_t& dx, uint32_t& dy) {
+  if (!PanTiltBuild::zones) return false;   // the limit box is convex: a clamped target's path stays inside
+  if (!poseAllowed(x0, y0)) return false;
+  uint32_t total = dx > dy ? dx : dy;
+  auto at = [&](float s, float& x, float& y) {
+    if (!total) { x = x0 + (x1 - x0) * s; y = y0 + (y1 - y0) * s; return; }
+    float t = s * (float)total;
+    x = (dx == 0 || t >= dx) ? x1 : x0 + (x1 - x0) * t / (float)dx;
+    y = (dy == 0 || t >= dy) ? y1 : y0 + (y1 - y0) * t / (float)dy;
+  };
+
+  float span = fmaxf(fabsf(x1 - x0), fabsf(y1 - y0));
+  uint16_t n = (uint16_t)ceilf(span / (ZONE_GRID_DEG * 0.5f));
+  if (n == 0) n = 1;
+  float lo = 0, hi = -1, x, y;
+  for (uint16_t k=1;k<=n;k++) {
+    float s = (float)k / (float)n;
+    at(s, x, y);
+    if (!poseAllowed(x, y)) { hi = s; break; }
+    lo = s;
+  }
+  if (hi < 0) return false;
+
+  for (uint8_t it=0;it<8;it++) {   // refine the crossing to ~1/256 of a sample
+    float mid = (lo + hi) * 0.5f;
+    at(mid, x, y);
+    if (poseAllowed(x, y)) lo = mid; else hi = mid;
+  }
+  float t = lo * (float)total;
+  at(lo, x, y);
+  if (x == x1 && y == y1) return false;
+  x1 = x; y1 = y;
+  if (dx > t) dx = (uint32_t)t;
+  if (dy > t) dy = (uint32_t)t;
+  return true;
+}
+
+void PanTiltRig::limitTripTick() {
+  if (!limitTripped) return;
+  limitTripped = false;
+  abortQueueAndMotion();
+  applyOutputs();
+  sendEventFault(lastSubsystem, lastRoute, g_lastMirrorToBle, "keep_out", 0, "Motion reached a keep-out zone; stopped");
+}
+
+// prefs must be open
+bool PanTiltRig::loadLimits() {
+  LimitConfig c{};
+  if (prefs.getBytes("limits", &c, sizeof(c)) != sizeof(c)) return false;
+  if (c.version != LIMITS_VERSION || blobCrc(c) != c.crc32) return false;
+  limits = c;
+  persistedLimitsCrc = c.crc32;
+  limitsDerive();
+  return true;
+}
+
+bool PanTiltRig::persistLimits() {
+  limits.crc32 = blobCrc(limits);
+  return persistBlobKey("limits", DIRTY_LIMITS, &limits, sizeof(limits), limits.crc32, persistedLimitsCrc);
+}
+
+// ------------------- Target Selection -------------------
+// "targets" carries every detection in a frame, so the subject is chosen here against
+// the current aim and the previous lock instead of following the detector's ordering.
+static const float TARGET_AIM_WEIGHT = 0.25f;   // score lost per unit of distance from centre
+static const float TARGET_MATCH_IOU = 0.2f;
+
+static float boxIou(const TargetBox& a, const TargetBox& b) {
+  float ix = fminf(a.u + a.w*0.5f, b.u + b.w*0.5f) - fmaxf(a.u - a.w*0.5f, b.u - b.w*0.5f);
+  float iy = fminf(a.v + a.h*0.5f, b.v + b.h*0.5f) - fmaxf(a.v - a.h*0.5f, b.v - b.h*0.5f);
+  if (ix <= 0 || iy <= 0) return 0;
+  float inter = ix * iy;
+  float uni = a.w*a.h + b.w*b.h - inter;
+  return uni > 0 ? inter / uni : 0;
+}
+
+// Index of the box to follow, or -1 (nothing usable, or coasting on a lost lock).
+int8_t PanTiltRig::selectTarget(const TargetBox* boxes, uint8_t n, uint32_t now, bool& switched) {
+  switched = false;
+  track.frames++;
+
+  // Where the locked box should be now that the rig has moved since it was seen
+  TargetBox pred = track.box;
+  if (track.locked) {
+    pred.u -= tanHalfDeg(2.0f * (v1 - track.seenX)) / camTanH;
+    pred.v -= tanHalfDeg(2.0f * (v2 - track.seenY)) / camTanV;
+  }
+  float gate = 0.5f * fmaxf(fmaxf(pred.w, pred.h), 0.1f);
+
+  int8_t best = -1, match = -1;
+  float bestScore = 0, matchScore = 0, matchDist = 1e9f;
+  for (uint8_t i=0;i<n;i++) {
+    const TargetBox& b = boxes[i];
+    if (b.conf < track.minConf) continue;
+    float score = b.conf - TARGET_AIM_WEIGHT * sqrtf(b.u*b.u + b.v*b.v);
+    if (best < 0 || score > bestScore) { best = (int8_t)i; bestScore = score; }
+    if (!track.locked) continue;
+    float du = b.u - pred.u, dv = b.v - pred.v;
+    float d = sqrtf(du*du + dv*dv);
+    if (d < matchDist && (d < gate || boxIou(pred, b) >= TARGET_MATCH_IOU)) { match = (int8_t)i; matchScore = score; matchDist = d; }
+  }
+
+  int8_t pick;
+  if (match >= 0) {
+    bool canSwitch = now - track.lockedAt >= track.lockMs;
+    pick = (canSwitch && bestScore > matchScore + track.switchMargin) ? best : match;
+  } else if (track.locked && now - track.lastSeen < track.lostMs) {
+    return -1;
+  } else {
+    pick = best;
+  }
+
+  if (pick < 0) { track.locked = false; return -1; }
+  if (pick != match) {
+    track.locked = true;
+    track.lockId++;
+    track.lockedAt = now;
+    track.switches++;
+    switched = true;
+  }
+  track.box = boxes[pick];
+  track.seenX = v1;
+  track.seenY = v2;
+  track.lastSeen = now;
+  return pick;
+}
+
+// ------------------- Telemetry -------------------
+// A fixed-rate stream sampled right after the motion update. Every keyEvery samples a
+// full keyframe goes out; in between only changed fields are sent, and unchanged
+// samples are skipped entirely. seq counts sent lines so the host can spot loss.
+void PanTiltRig::telemetryStart(uint16_t hz, uint8_t keyEvery, PanTiltLink origin) {
+  telem.active = hz > 0;
+  if (!telem.active) return;
+  uint32_t now = millis();
+  telem.periodMs = (uint16_t)(1000 / hz);
+  telem.keyEvery = keyEvery;
+  telem.sinceKey = 0;
+  telem.needKey = true;
+  telem.nextMs = now;
+  telem.origin = origin;
+  telem.lastX = v1;
+  telem.lastY = v2;
+  telem.lastT = now;
+}
+
+void PanTiltRig::telemetrySnapshot(TelemetrySample& s, uint32_t now) {
+  float dt = (now - telem.lastT) / 1000.0f;
+  float vx = dt > 0 ? (v1 - telem.lastX) / dt : 0.0f;
+  float vy = dt > 0 ? (v2 - telem.lastY) / dt : 0.0f;
+  telem.lastX = v1;
+  telem.lastY = v2;
+  telem.lastT = now;
+
+  s.x = (int32_t)lroundf(v1 * 100.0f);
+  s.y = (int32_t)lroundf(v2 * 100.0f);
+  s.vx = (int32_t)lroundf(vx * 10.0f);
+  s.vy = (int32_t)lroundf(vy * 10.0f);
+  bool px = pat.active && pat.useX, py = pat.active && pat.useY;
+  s.moving = ((mx.active || jog.x.active || px || blendSeg.active) ? 1 : 0) | ((my.active || jog.y.active || py || blendSeg.active) ? 2 : 0);
+  s.queue = qCount;
+  s.macros = macroActiveCount();
+}
+
+void PanTiltRig::telemetryTick(uint32_t now) {
+  if (!telem.active || (int32_t)(now - telem.nextMs) < 0) return;
+  telem.nextMs += telem.periodMs;
+  if ((int32_t)(now - telem.nextMs) >= 0) telem.nextMs = now + telem.periodMs;   // fell behind; don't burst
+
+  TelemetrySample s;
+  telemetrySnapshot(s, now);
+
+  bool key = telem.needKey || ++telem.sinceKey >= telem.keyEvery;
+  if (!key && !memcmp(&s, &telem.sent, sizeof(s))) return;
+
+  // Nobody listening: skip formatting, and resend everything once someone is
+  if (!sinkWants(PanTiltMsg::Telemetry, telem.origin)) { telem.needKey = true; return; }
+  if (key) { telem.sinceKey = 0; telem.needKey = false; }
+
+  String& out = replyLine(160);
+  out += "{\"ok\":true,\"event\":\"tm\",\"seq\":";
+  out += String(telem.seq++);
+  out += ",\"ts\":";
+  out += String(now);
+  appendRoutingFields(out, "", rigCfg.route);
+  if (key) out += ",\"key\":true";
+  if (key || s.x != telem.sent.x)   { out += ",\"x\":";  out += String(s.x / 100.0f, 2); }
+  if (key || s.y != telem.sent.y)   { out += ",\"y\":";  out += String(s.y / 100.0f, 2); }
+  if (key || s.vx != telem.sent.vx) { out += ",\"vx\":"; out += String(s.vx / 10.0f, 1); }
+  if (key || s.vy != telem.sent.vy) { out += ",\"vy\":"; out += String(s.vy / 10.0f, 1); }
+  if (key || s.moving != telem.sent.moving) {
+    out += ",\"mx\":"; out += ((s.moving & 1) ? "true" : "false");
+    out += ",\"my\":"; out += ((s.moving & 2) ? "true" : "false");
+  }
+  if (key || s.queue != telem.sent.queue)   { out += ",\"q\":";      out += String(s.queue); }
+  if (key || s.macros != telem.sent.macros) { out += ",\"macros\":"; out += String(s.macros); }
+  out += "}";
+  telem.sent = s;
+  emitLine(PanTiltMsg::Telemetry, out, telem.origin);
+}
+
+// ------------------- Host Clock -------------------
+// "sync" pings carry the host's send time t (ms) and optionally its last measured
+// round trip; each gives one offset sample dev - (t + rtt/2). The offset and drift
+// are a least-squares line through the low-latency samples, so "at" (host ms) maps
+// to a device time. One clock is shared by every rig on this device.
+static const uint8_t CLOCK_SAMPLES = 8;
+static const double CLOCK_DRIFT_MAX = 500e-6;
+static const uint32_t SCHED_HORIZON_MS = 600000;   // "at" may be up to 10 min ahead
+static const uint32_t SCHED_LATE_MS = 1000;        // ...or this far behind, then it runs now
+
+struct ClockSample { double host, offset; float rtt; };
+
+static ClockSample g_clockSamples[CLOCK_SAMPLES];
+static uint8_t g_clockCount = 0, g_clockNext = 0;
+static double g_clockOffset = 0;   // device - host ms at g_clockRef
+static double g_clockRef = 0;
+static double g_clockDrift = 0;    // d(offset)/d(host)
+static float g_clockRtt = 0;
+
+// micros() widened to 64 bits; the scheduler ticks it every loop, well inside a wrap.
+static uint64_t clockNowUs() {
+  static uint32_t last = 0;
+  static uint64_t high = 0;
+  uint32_t now = micros();
+  if (now < last) high += (1ULL << 32);
+  last = now;
+  return high | now;
+}
+
+static void clockAddSample(double host, double devMs, float rtt) {
+  g_clockSamples[g_clockNext] = ClockSample{ host, devMs - (host + rtt * 0.5), rtt };
+  g_clockNext = (uint8_t)((g_clockNext + 1) % CLOCK_SAMPLES);
+  if (g_clockCount < CLOCK_SAMPLES) g_clockCount++;
+
+  // Samples much slower than the best one carry queueing delay; leave them out
+  float best = g_clockSamples[0].rtt;
+  for (uint8_t i=1;i<g_clockCount;i++) if (g_clockSamples[i].rtt < best) best = g_clockSamples[i].rtt;
+  float cut = best + fmaxf(2.0f, best * 0.5f);
+
+  double sh = 0, so = 0;
+  uint8_t n = 0;
+  for (uint8_t i=0;i<g_clockCount;i++) {
+    if (g_clockSamples[i].rtt > cut) continue;
+    sh += g_clockSamples[i].host; so += g_clockSamples[i].offset; n++;
+  }
+  double mh = sh / n, mo = so / n, sxy = 0, sxx = 0;
+  for (uint8_t i=0;i<g_clockCount;i++) {
+    if (g_clockSamples[i].rtt > cut) continue;
+    double dh = g_clockSamples[i].host - mh;
+    sxy += dh * (g_clockSamples[i].offset - mo);
+    sxx += dh * dh;
+  }
+  double drift = (n >= 3 && sxx > 1e6) ? sxy / sxx : 0;   // needs ~1 s of spread
+  if (drift > CLOCK_DRIFT_MAX) drift = CLOCK_DRIFT_MAX;
+  if (drift < -CLOCK_DRIFT_MAX) drift = -CLOCK_DRIFT_MAX;
+  g_clockRef = mh;
+  g_clockOffset = mo;
+  g_clockDrift = drift;
+  g_clockRtt = best;
+}
+
+static uint64_t clockHostToDevUs(double hostMs) {
+  double dev = hostMs + g_clockOffset + g_clockDrift * (hostMs - g_clockRef);
+  return dev <= 0 ? 0 : (uint64_t)(dev * 1000.0);
+}
+
+// ------------------- Scheduled Commands -------------------
+void PanTiltRig::schedInit() {
+  for (uint8_t i=0;i<SCHED_WHEEL;i++) schedWheel[i] = -1;
+  schedCount = 0;
+  schedCursor = (uint32_t)(clockNowUs() / 1000);
+}
+
+bool PanTiltRig::schedAdd(const String& line, PanTiltLink link, uint64_t dueUs) {
+  int8_t slot = -1;
+  for (uint8_t i=0;i<SCHED_MAX;i++) if (!sched[i].used) { slot = (int8_t)i; break; }
+  if (slot < 0) return false;
+
+  uint32_t nowMs = (uint32_t)(clockNowUs() / 1000);
+  if (!schedCount) schedCursor = nowMs;
+  uint32_t dueMs = (uint32_t)((dueUs + 999) / 1000);
+  if ((int32_t)(dueMs - schedCursor) <= 0) dueMs = schedCursor + 1;   // overdue: next tick
+
+  SchedEntry& e = sched[slot];
+  e.used = true;
+  e.dueMs = dueMs;
+  e.dueUs = (uint32_t)dueUs;
+  e.link = link;
+  e.line = line;
+  int8_t& head = schedWheel[dueMs & (SCHED_WHEEL - 1)];
+  e.next = head;
+  head = slot;
+  schedCount++;
+  return true;
+}
+
+void PanTiltRig::schedClear() {
+  for (uint8_t i=0;i<SCHED_MAX;i++) { sched[i].used = false; sched[i].line = String(); }
+  for (uint8_t i=0;i<SCHED_WHEEL;i++) schedWheel[i] = -1;
+  schedCount = 0;
+}
+
+void PanTiltRig::schedTick() {
+  uint32_t nowMs = (uint32_t)(clockNowUs() / 1000);
+  if (!schedCount) { schedCursor = nowMs; return; }
+  if (nowMs - schedCursor > SCHED_WHEEL) schedCursor = nowMs - SCHED_WHEEL;   // stalled: one lap covers every bucket
+
+  while (schedCursor != nowMs) {
+    schedCursor++;
+    int8_t* link = &schedWheel[schedCursor & (SCHED_WHEEL - 1)];
+    while (*link >= 0) {
+      SchedEntry& e = sched[*link];
+      if ((int32_t)(e.dueMs - schedCursor) > 0) { link = &e.next; continue; }
+      *link = e.next;
+      e.used = false;
+      schedCount--;
+
+      String line = e.line;
+      e.line = String();
+      PanTiltLink prev = g_mirrorToBle;
+      g_mirrorToBle = e.link;
+      schedReleasing = true;
+      schedDueUs = e.dueUs;
+      handleCommandLine(line);
+      schedReleasing = false;
+      g_mirrorToBle = prev;
+    }
+  }
+}
+
+// ------------------- Replay Cache -------------------
+static_assert((REPLAY_SLOTS & (REPLAY_SLOTS - 1)) == 0 && REPLAY_SLOTS >= 2 * REPLAY_MAX, "replay table size");
+static const uint8_t REPLAY_EMPTY = 0xFF;
+
+static uint8_t replayHome(PanTiltLink link, uint32_t id) {
+  uint32_t h = (id ^ ((uint32_t)link << 24)) * 2654435761u;   // Fibonacci hashing
+  return (uint8_t)((h >> 24) & (REPLAY_SLOTS - 1));
+}
+
+void PanTiltRig::replayInit() {
+  memset(replaySlot, REPLAY_EMPTY, sizeof(replaySlot));
+  for (uint8_t i=0;i<REPLAY_MAX;i++) replay[i].used = false;
+  replayNext = 0;
+}
+
+const ReplayEntry* PanTiltRig::replayFind(PanTiltLink link, uint32_t id) const {
+  // At most half full, so a probe always reaches an empty slot
+  for (uint8_t i = replayHome(link, id); replaySlot[i] != REPLAY_EMPTY; i = (i + 1) & (REPLAY_SLOTS - 1)) {
+    const ReplayEntry& e = replay[replaySlot[i]];
+    if (e.id == id && e.link == link) return &e;
+  }
+  return nullptr;
+}
+
+void PanTiltRig::replayInsert(PanTiltLink link, uint32_t id, bool ok, const char* text) {
+  uint8_t idx = replayNext;
+  replayNext = (uint8_t)((replayNext + 1) % REPLAY_MAX);
+  if (replay[idx].used) replayErase(idx);
+
+  ReplayEntry& e = replay[idx];
+  e.used = true;
+  e.ok = ok;
+  e.link = link;
+  e.id = id;
+  strncpy(e.text, text, REPLAY_TEXT - 1);
+  e.text[REPLAY_TEXT - 1] = 0;
+
+  uint8_t i = replayHome(link, id);
+  while (replaySlot[i] != REPLAY_EMPTY) i = (i + 1) & (REPLAY_SLOTS - 1);
+  replaySlot[i] = idx;
+}
+
+void PanTiltRig::replayErase(uint8_t idx) {
+  ReplayEntry& e = replay[idx];
+  if (!e.used) return;
+  e.used = false;
+  uint8_t i = replayHome(e.link, e.id);
+  while (replaySlot[i] != idx) i = (i + 1) & (REPLAY_SLOTS - 1);
+
+  // Backward-shift deletion: pull later members of the probe run into the hole
+  // unless their home lies cyclically in (hole, j].
+  replaySlot[i] = REPLAY_EMPTY;
+  for (uint8_t j = (i + 1) & (REPLAY_SLOTS - 1); replaySlot[j] != REPLAY_EMPTY; j = (j + 1) & (REPLAY_SLOTS - 1)) {
+    const ReplayEntry& m = replay[replaySlot[j]];
+    uint8_t k = replayHome(m.link, m.id);
+    bool stays = (i <= j) ? (i < k && k <= j) : (i < k || k <= j);
+    if (stays) continue;
+    replaySlot[i] = replaySlot[j];
+    replaySlot[j] = REPLAY_EMPTY;
+    i = j;
+  }
+}
+
+void PanTiltRig::replayDropLink(PanTiltLink link) {
+  for (uint8_t i=0;i<REPLAY_MAX;i++) if (replay[i].used && replay[i].link == link) replayErase(i);
+}
+
+void PanTiltRig::handleClientLine(String line) {
+  PanTiltLink link = g_mirrorToBle;
+  int idInt = 0;
+  // Only a client-chosen id names a command; BLE_ALL is no single client
+  if (!PanTiltBuild::replay || link == PANTILT_LINK_BLE_ALL || !getIntField(line, "id", idInt) || idInt <= 0) { handleCommandLine(line); return; }
+  uint32_t id = (uint32_t)idInt;
+
+  const ReplayEntry* e = replayFind(link, id);
+  if (e) {
+    // Answer the resend from the cache, marked so the host can tell
+    g_creditRig = this;
+    String subsystem, route;
+    if (!getStringField(line, "subsystem", subsystem)) subsystem = lastSubsystem.length() ? lastSubsystem : g_defaultSubsystem;
+    if (!getStringField(line, "route", route)) route = lastRoute;
+    if (e->ok) {
+      if (sinkWants(PanTiltMsg::Ack, link, RK_TINY)) emitLine(PanTiltMsg::Ack, String("{\"ok\":1,\"id\":") + String(id) + ",\"replay\":true}", link, RK_TINY);
+      if (!sinkWants(PanTiltMsg::Ack, link, RK_OK)) return;
+    } else if (!sinkWants(PanTiltMsg::Fault, link, RK_FAULT)) {
+      return;
     }
+    String out;
+    out.reserve(160);
+    out += e->ok ? "{\"ok\":true,\"id\":" : "{\"ok\":false,\"id\":";
+    out += String(id);
+    appendRoutingFields(out, subsystem, route);
+    out += e->ok ? ",\"msg\":\"" : ",\"error\":\"";
+    appendJsonEscaped(out, e->text);
+    out += "\",\"replay\":true}";
+    if (e->ok) emitLine(PanTiltMsg::Ack, out, link, RK_OK);
+    else emitLine(PanTiltMsg::Fault, out, link, RK_FAULT);
+    return;
   }
 
-  maybeStartNextQueuedStep();
+  ReplayCapture& c = g_replayCap;
+  c.armed = true;
+  c.got = c.ok = c.data = false;
+  c.id = id;
+  handleCommandLine(line);
+  c.armed = false;
+  if (c.got && !c.data) replayInsert(link, id, c.ok, c.text);
 }
 
 // ------------------- Command Handler -------------------
-static void handleCommandLine(String line) {
+void PanTiltRig::handleCommandLine(String line) {
+  ScratchScope scope;   // everything this command takes from the arena goes back on return
   line.trim();
   if (!line.length()) return;
   if (line.length() > CMD_LINE_MAX) line = line.substring(0, CMD_LINE_MAX);
@@ -1047,8 +3719,9 @@ static void handleCommandLine(String line) {
   lastSubsystem = subsystem;
   lastRoute = route;
 
-  bool mirror = g_mirrorToBle;
+  PanTiltLink mirror = g_mirrorToBle;
   g_lastMirrorToBle = mirror;
+  g_creditRig = this;
 
   String cmd;
   if (!getStringField(line, "cmd", cmd)) {
@@ -1060,11 +3733,158 @@ static void handleCommandLine(String line) {
   bool qVal=false, hasQ=false;
   if (getBoolField(line, "q", qVal)) hasQ = true;
 
+  // ---- host clock ping (a bare "sync" is still the queue barrier, as in macros) ----
+  double hostT;
+  if (PanTiltBuild::hostClock && cmd == "sync" && getDoubleField(line, "t", hostT)) {
+    float rtt = 0;
+    if (getNumberField(line, "rtt", rtt) && (rtt < 0 || rtt > 10000)) { sendErr(id, subsystem, route, mirror, "bad_value", "rtt must be 0..10000 ms"); return; }
+    double devMs = (double)clockNowUs() / 1000.0;
+    clockAddSample(hostT, devMs, rtt);
+
+    if (!sinkWants(PanTiltMsg::Ack, mirror)) return;
+    String out;
+    out.reserve(200);
+    out += "{\"ok\":true,\"id\":";
+    out += String(id);
+    appendRoutingFields(out, subsystem, route);
+    out += ",\"t\":"; out += String(hostT, 3);
+    out += ",\"dev\":"; out += String(devMs, 3);
+    out += ",\"offset\":"; out += String(g_clockOffset + g_clockDrift * (hostT - g_clockRef), 3);
+    out += ",\"driftPpm\":"; out += String(g_clockDrift * 1e6, 2);
+    out += ",\"rtt\":"; out += String(g_clockRtt, 2);
+    out += ",\"samples\":"; out += String(g_clockCount);
+    out += "}";
+    emitLine(PanTiltMsg::Ack, out, mirror);
+    return;
+  }
+
+  // ---- "at": hold the line until host time at (after a sync) ----
+  double at;
+  if (!schedReleasing && getDoubleField(line, "at", at)) {
+    if (!PanTiltBuild::hostClock) { sendErr(id, subsystem, route, mirror, "not_built", "at scheduling is not in this build profile"); return; }
+    if (!g_clockCount) { sendErr(id, subsystem, route, mirror, "no_clock", "Send sync pings before using at"); return; }
+    uint64_t nowUs = clockNowUs();
+    uint64_t dueUs = clockHostToDevUs(at);
+    if (dueUs + (uint64_t)SCHED_LATE_MS * 1000 < nowUs) { sendErr(id, subsystem, route, mirror, "too_late", "at is more than 1 s in the past"); return; }
+    if (dueUs > nowUs + (uint64_t)SCHED_HORIZON_MS * 1000) { sendErr(id, subsystem, route, mirror, "too_far", "at is more than 10 min ahead"); return; }
+
+    // Keep the reply id on the released line
+    String held = line;
+    if (!idInt) { held = "{\"id\":"; held += String(id); held += ","; held += line.substring(1); }
+    if (!schedAdd(held, mirror, dueUs)) { sendErr(id, subsystem, route, mirror, "schedule_full", "Too many scheduled commands"); return; }
+    sendOk(id, subsystem, route, mirror, "scheduled");
+    return;
+  }
+
   // ---- informational ----
   if (cmd == "commands") { sendOk(id, subsystem, route, mirror, "commands"); sendTextLines("commandsLine", id, subsystem, route, mirror, COMMANDS_LINES, sizeof(COMMANDS_LINES)/sizeof(COMMANDS_LINES[0])); return; }
   if (cmd == "help")     { sendOk(id, subsystem, route, mirror, "help");     sendTextLines("helpLine",     id, subsystem, route, mirror, HELP_LINES,     sizeof(HELP_LINES)/sizeof(HELP_LINES[0]));     return; }
   if (cmd == "examples") { sendOk(id, subsystem, route, mirror, "examples"); sendTextLines("exampleLine",  id, subsystem, route, mirror, EXAMPLES_LINES, sizeof(EXAMPLES_LINES)/sizeof(EXAMPLES_LINES[0])); return; }
-  if (cmd == "status")   { sendOk(id, subsystem, route, mirror, "status");   sendState(nullptr, 0, subsystem, route, mirror); return; }
+  if (cmd == "status")   { sendOk(id, subsystem, route, mirror, "status");   sendState(nullptr, 0, subsystem, route, mirror, RK_DATA); return; }
+
+  // ---- telemetry stream ----
+  if (PanTiltBuild::telemetry && cmd == "telemetry") {
+    int hz=0;
+    if (!getIntField(line, "hz", hz) && !getIntField(line, "value", hz)) { sendErr(id, subsystem, route, mirror, "missing_value", "telemetry requires hz (0 stops)"); return; }
+    if (hz < 0 || hz > 100) { sendErr(id, subsystem, route, mirror, "bad_value", "telemetry hz must be 0..100"); return; }
+    int key = hz ? hz : 1;   // default: one keyframe per second
+    (void)getIntField(line, "keyframe", key);
+    if (key < 1 || key > 255) { sendErr(id, subsystem, route, mirror, "bad_value", "keyframe must be 1..255 samples"); return; }
+    telemetryStart((uint16_t)hz, (uint8_t)key, mirror);
+    sendOk(id, subsystem, route, mirror, hz ? "telemetry_on" : "telemetry_off");
+    return;
+  }
+
+  // ---- output subscriptions (per link, shared by every rig) ----
+  if (cmd == "acklevel") {
+    OutputSink* sk = sinkFind(mirror, true);
+    if (!sk) { sendErr(id, subsystem, route, mirror, "sinks_full", "Too many output links"); return; }
+    String lv;
+    if (!getStringField(line, "level", lv) && !getStringField(line, "value", lv)) { sendErr(id, subsystem, route, mirror, "missing_level", "ackLevel requires level: none|minimal|events|full"); return; }
+    lv.toLowerCase();
+    int8_t level = -1;
+    for (uint8_t l=0;l<4;l++) if (lv == ACK_LEVEL_NAMES[l]) level = (int8_t)l;
+    if (level < 0) { sendErr(id, subsystem, route, mirror, "bad_level", "level must be none|minimal|events|full"); return; }
+    sk->ackLevel = (AckLevel)level;
+    sk->ackKinds = ACK_LEVEL_KINDS[level];
+    sendOk(id, subsystem, route, mirror, "ack_level_set");   // already under the new level
+    return;
+  }
+
+  if (cmd == "window") {
+    // Credit flow control: the reply is the initial window, after which every ack and
+    // telemetry frame to this link carries "cr". Hosts keep in-flight lines under q and ln
+    // and unacked bytes under in instead of guessing.
+    OutputSink* sk = sinkFind(mirror, true);
+    if (!sk) { sendErr(id, subsystem, route, mirror, "sinks_full", "Too many output links"); return; }
+    bool on = true;
+    (void)getBoolField(line, "credits", on);
+    sk->credits = on;
+
+    if (!sinkWants(PanTiltMsg::Ack, mirror)) return;
+    String out;
+    out.reserve(160);
+    out += "{\"ok\":true,\"id\":";
+    out += String(id);
+    appendRoutingFields(out, subsystem, route);
+    out += ",\"window\":{\"q\":";
+    out += String(queueFree());
+    out += ",\"qMax\":";
+    out += String(QMAX);
+    PanTiltInputCredit in;
+    if (g_inputCredit && mirror != PANTILT_LINK_BLE_ALL && g_inputCredit(mirror, in)) {
+      out += ",\"in\":"; out += String(in.bytes);
+      out += ",\"ln\":"; out += String(in.lines);
+    }
+    out += ",\"lineMax\":";
+    out += String(CMD_LINE_MAX);
+    out += ",\"credits\":";
+    out += on ? "true" : "false";
+    out += "}}";
+    emitLine(PanTiltMsg::Ack, out, mirror);
+    return;
+  }
+
+  if (cmd == "subscribe") {
+    OutputSink* sk = sinkFind(mirror, true);
+    if (!sk) { sendErr(id, subsystem, route, mirror, "sinks_full", "Too many output links"); return; }
+
+    // Parse everything first so a bad value changes nothing; "level" sets every class
+    uint8_t lv[PANTILT_MSG_CLASSES];
+    memcpy(lv, sk->level, sizeof(lv));
+    for (int8_t c=-1;c<(int8_t)PANTILT_MSG_CLASSES;c++) {
+      String v;
+      if (!getStringField(line, c < 0 ? "level" : MSG_CLASS_NAMES[c], v)) continue;
+      v.toLowerCase();
+      int8_t level = -1;
+      for (uint8_t l=0;l<3;l++) if (v == SUB_LEVEL_NAMES[l]) level = (int8_t)l;
+      if (level < 0) { sendErr(id, subsystem, route, mirror, "bad_level", "levels are off, own, or all"); return; }
+      if (c < 0) memset(lv, level, sizeof(lv));
+      else lv[c] = (uint8_t)level;
+    }
+    memcpy(sk->level, lv, sizeof(lv));
+
+    if (!sinkWants(PanTiltMsg::Ack, mirror)) return;
+    String out;
+    out.reserve(160);
+    out += "{\"ok\":true,\"id\":";
+    out += String(id);
+    appendRoutingFields(out, subsystem, route);
+    out += ",\"subs\":{";
+    for (uint8_t c=0;c<PANTILT_MSG_CLASSES;c++) {
+      if (c) out += ",";
+      out += "\"";
+      out += MSG_CLASS_NAMES[c];
+      out += "\":\"";
+      out += SUB_LEVEL_NAMES[sk->level[c]];
+      out += "\"";
+    }
+    out += "},\"ackLevel\":\"";
+    out += ACK_LEVEL_NAMES[sk->ackLevel];
+    out += "\"}";
+    emitLine(PanTiltMsg::Ack, out, mirror);
+    return;
+  }
 
   // ---- persistence ----
   if (cmd == "persist") {
@@ -1076,7 +3896,19 @@ static void handleCommandLine(String line) {
     return;
   }
 
+  if (cmd == "autosave") {
+    int ms=0;
+    if (!getIntField(line, "ms", ms) && !getIntField(line, "value", ms)) { sendErr(id, subsystem, route, mirror, "missing_value", "autosave requires ms (0 disables)"); return; }
+    if (ms < 0 || ms > 60000) { sendErr(id, subsystem, route, mirror, "bad_value", "autosave ms must be 0..60000"); return; }
+    autosaveMs = (uint16_t)ms;
+    markDirty(DIRTY_AUTOSAVE);
+    sendOk(id, subsystem, route, mirror, ms ? "autosave_on" : "autosave_off");
+    sendState("done", id, subsystem, route, mirror);
+    return;
+  }
+
   if (cmd == "factoryreset") {
+    if (macroActiveCount()) { sendErr(id, subsystem, route, mirror, "macro_busy", "Stop running macros first (favStop)"); return; }
     String why;
     bool ok = factoryResetFlash(why);
     if (!ok) { sendErr(id, subsystem, route, mirror, "factory_reset_failed", why.c_str()); return; }
@@ -1091,12 +3923,42 @@ static void handleCommandLine(String line) {
   // ---- queue mode ----
   if (cmd == "queue") {
     String mode;
-    if (!getStringField(line, "mode", mode)) { sendErr(id, subsystem, route, mirror, "missing_mode", "queue requires mode: off|on|step"); return; }
+    if (!getStringField(line, "mode", mode)) { sendErr(id, subsystem, route, mirror, "missing_mode", "queue requires mode: off|on|step|blend"); return; }
     mode.toLowerCase();
-    if (mode == "off") qMode = Q_OFF;
-    else if (mode == "on") qMode = Q_ON;
-    else if (mode == "step") qMode = Q_STEP;
-    else { sendErr(id, subsystem, route, mirror, "bad_mode", "mode must be off|on|step"); return; }
+    QueueMode newMode;
+    if (mode == "off") newMode = Q_OFF;
+    else if (mode == "on") newMode = Q_ON;
+    else if (mode == "step") newMode = Q_STEP;
+    else if (mode == "blend") newMode = Q_BLEND;
+    else { sendErr(id, subsystem, route, mirror, "bad_mode", "mode must be off|on|step|blend"); return; }
+
+    float accel, corner; int look;
+    if (getNumberField(line, "accel", accel)) {
+      if (accel < 1.0f || accel > 20000.0f) { sendErr(id, subsystem, route, mirror, "bad_value", "accel must be 1..20000 deg/s^2"); return; }
+      blendAccel = accel;
+    }
+    if (getNumberField(line, "corner", corner)) {
+      if (corner < 0.0f || corner > 30.0f) { sendErr(id, subsystem, route, mirror, "bad_value", "corner must be 0..30 degrees"); return; }
+      blendCorner = corner;
+    }
+    if (getIntField(line, "lookahead", look)) {
+      if (look < 1 || look > (int)QMAX) {
+        char msg[40];
+        snprintf(msg, sizeof(msg), "lookahead must be 1..%u", (unsigned)QMAX);
+        sendErr(id, subsystem, route, mirror, "bad_value", msg);
+        return;
+      }
+      blendLookahead = (uint8_t)look;
+    }
+
+    String lanes;
+    if (getStringField(line, "lanes", lanes)) {
+      lanes.toLowerCase();
+      if (lanes == "single") qLanes = QL_SINGLE;
+      else if (lanes == "axis") qLanes = QL_AXIS;
+      else { sendErr(id, subsystem, route, mirror, "bad_lanes", "lanes must be single|axis"); return; }
+    }
+    qMode = newMode;
     sendOk(id, subsystem, route, mirror, "queue_mode_set");
     sendState("done", id, subsystem, route, mirror);
     return;
@@ -1105,23 +3967,39 @@ static void handleCommandLine(String line) {
   if (cmd == "qclear") { qClearAll(); sendOk(id, subsystem, route, mirror, "queue_cleared"); sendState("done", id, subsystem, route, mirror); return; }
 
   if (cmd == "qabort") {
+    if (!macroRunning) macroStop(-1, "macro_stopped");
     abortQueueAndMotion();
+    schedClear();
     applyOutputs();
     sendOk(id, subsystem, route, mirror, "aborted_all");
     sendState("done", id, subsystem, route, mirror);
     return;
   }
 
-  if (cmd == "qstatus") { sendOk(id, subsystem, route, mirror, "queue_status"); sendState(nullptr, 0, subsystem, route, mirror); return; }
+  if (cmd == "qsync" || cmd == "sync") {
+    QueueItem it;
+    it.id = id; it.subsystem = subsystem; it.route = route; it.kind = "sync";
+    it.mirrorToBle = mirror;
+    it.useX = true; it.useY = true; it.barrier = true;
+    if (!qEnqueue(it)) { sendErr(id, subsystem, route, mirror, "queue_full", "Queue full"); return; }
+    sendOk(id, subsystem, route, mirror, "queued");
+    sendState(nullptr, 0, subsystem, route, mirror);
+    return;
+  }
+
+  if (cmd == "qstatus") { sendOk(id, subsystem, route, mirror, "queue_status"); sendState(nullptr, 0, subsystem, route, mirror, RK_DATA); return; }
 
   if (cmd == "qlist") {
+    if (!sinkWants(PanTiltMsg::Ack, mirror)) return;
     String out;
     out.reserve(900);
     out += "{\"ok\":true,\"id\":";
     out += String(id);
     appendRoutingFields(out, subsystem, route);
     out += ",\"queue\":{\"mode\":\"";
-    out += (qMode==Q_OFF ? "off" : (qMode==Q_ON ? "on" : "step"));
+    out += queueModeName(qMode);
+    out += "\",\"lanes\":\"";
+    out += (qLanes==QL_AXIS ? "axis" : "single");
     out += "\",\"count\":";
     out += String(qCount);
     out += ",\"items\":[";
@@ -1132,18 +4010,18 @@ static void handleCommandLine(String line) {
       out += "{\"ref\":";
       out += String(it.id);
       out += ",\"kind\":\"";
-      out += jsonEscape(it.kind);
+      out += it.kind;
       out += "\",\"axis\":\"";
       out += (it.useX && it.useY) ? "xy" : (it.useX ? "x" : "y");
       out += "\"";
-      if (it.useX) { out += ",\"x\":"; out += String(it.tx, 2); }
-      if (it.useY) { out += ",\"y\":"; out += String(it.ty, 2); }
+      if (it.useX && !it.barrier) { out += ",\"x\":"; out += String(it.tx, 2); }
+      if (it.useY && !it.barrier) { out += ",\"y\":"; out += String(it.ty, 2); }
       out += ",\"dx\":"; out += String(it.dx);
       out += ",\"dy\":"; out += String(it.dy);
       out += "}";
     }
     out += "]}}";
-    emitLine(out, mirror);
+    emitLine(PanTiltMsg::Ack, out, mirror);
     return;
   }
 
@@ -1155,10 +4033,11 @@ static void handleCommandLine(String line) {
     String axis="xy";
     (void)getStringField(line, "axis", axis);
 
-    bool ok=false; String ec, em;
+    bool ok=false; const char* ec=""; const char* em="";
     QueueItem it = buildStepFromCommand(id, subsystem, route, cmd2, axis, line, ok, ec, em);
     it.mirrorToBle = mirror;
-    if (!ok) { sendErr(id, subsystem, route, mirror, ec.c_str(), em.c_str()); return; }
+    if (!ok) { sendErr(id, subsystem, route, mirror, ec, em); return; }
+    if (refuseTargetInZone(it, true)) return;
     if (!qEnqueue(it)) { sendErr(id, subsystem, route, mirror, "queue_full", "Queue full"); return; }
     sendOk(id, subsystem, route, mirror, "queued");
     sendState(nullptr, 0, subsystem, route, mirror);
@@ -1181,8 +4060,9 @@ static void handleCommandLine(String line) {
   if (cmd == "stopall") {
     bool flush = true;
     (void)getBoolField(line, "flush", flush);
+    if (!macroRunning) macroStop(-1, "macro_stopped");
     stopAllMotion();
-    if (flush) { qClearAll(); qActive = false; }
+    if (flush) { qClearAll(); qDeactivateLanes(); schedClear(); }
     applyOutputs();
     sendOk(id, subsystem, route, mirror, flush ? "stopped_all_flushed" : "stopped_all");
     sendState("done", id, subsystem, route, mirror);
@@ -1190,6 +4070,7 @@ static void handleCommandLine(String line) {
   }
 
   if (cmd == "resetall") {
+    if (!macroRunning) macroStop(-1, "macro_stopped");
     abortQueueAndMotion();
     v1 = 0; v2 = 0;
     applyOutputs();
@@ -1215,7 +4096,7 @@ static void handleCommandLine(String line) {
     if (!getNumberField(line, "value", sp)) { sendErr(id, subsystem, route, mirror, "missing_value", "speed requires value (deg/sec)"); return; }
     if (sp < 0.1f || sp > 1000.0f) { sendErr(id, subsystem, route, mirror, "bad_value", "speed out of range"); return; }
     defaultSpeed = sp;
-    cfgDirty = true;
+    markDirty(DIRTY_SPEED);
     sendOk(id, subsystem, route, mirror, "speed_set");
     sendState("done", id, subsystem, route, mirror);
     return;
@@ -1229,7 +4110,7 @@ static void handleCommandLine(String line) {
     posFavValid[idx] = true;
     posFavX[idx] = v1;
     posFavY[idx] = v2;
-    cfgDirty = true;
+    markDirty(dirtyPos(idx));
     sendOk(id, subsystem, route, mirror, "saved_position");
     sendState("done", id, subsystem, route, mirror);
     return;
@@ -1245,22 +4126,16 @@ static void handleCommandLine(String line) {
     bool useX=false,useY=false;
     if (!parseAxisMask(axis, useX, useY)) { sendErr(id, subsystem, route, mirror, "bad_axis", "axis must be x, y, or xy"); return; }
 
-    float tx = posFavX[idx];
-    float ty = posFavY[idx];
-
     float durSec=-1, sp=-1;
     bool hasDur = getNumberField(line, "dur", durSec);
     bool hasSpeed = getNumberField(line, "speed", sp);
 
-    uint32_t dx=0, dy=0;
-    if (!computeDurations(useX,useY,tx,ty,hasDur,durSec,hasSpeed,sp,dx,dy)) { sendErr(id, subsystem, route, mirror, "bad_timing", "Invalid dur or speed"); return; }
-
     QueueItem it;
-    it.id = id; it.subsystem=subsystem; it.route=route; it.kind="recall";
+    if (!buildRecallStep(id, subsystem, route, idx, useX, useY, hasDur, durSec, hasSpeed, sp, it)) { sendErr(id, subsystem, route, mirror, "bad_timing", "Invalid dur or speed"); return; }
     it.mirrorToBle = mirror;
-    it.useX=useX; it.useY=useY; it.tx=tx; it.ty=ty; it.dx=dx; it.dy=dy;
 
     bool enqueue = shouldEnqueue(qMode, hasQ, qVal);
+    if (refuseTargetInZone(it, enqueue)) return;
     if (enqueue) {
       if (!qEnqueue(it)) { sendErr(id, subsystem, route, mirror, "queue_full", "Queue full"); return; }
       sendOk(id, subsystem, route, mirror, "queued");
@@ -1275,30 +4150,50 @@ static void handleCommandLine(String line) {
 
   // ---- command favorites ----
   if (cmd == "favlist") {
+    String kind;
+    if (getStringField(line, "kind", kind)) {
+      kind.toLowerCase();
+      if (kind != "preset" && kind != "macro" && kind != "target" && kind != "all") { sendErr(id, subsystem, route, mirror, "bad_kind", "kind must be preset, macro, target, or all"); return; }
+      int page=0;
+      (void)getIntField(line, "page", page);
+      if (page < 0) page = 0;
+      uint8_t k = kind == "all" ? 0 : (kind == "macro" ? SK_MACRO : (kind == "target" ? SK_TARGET : SK_PRESET));
+      sendStoreListPage(id, subsystem, route, mirror, k, (uint16_t)page);
+      return;
+    }
+    if (!sinkWants(PanTiltMsg::Ack, mirror)) return;
+
     String out;
     out.reserve(600);
     out += "{\"ok\":true,\"id\":";
     out += String(id);
     appendRoutingFields(out, subsystem, route);
     out += ",\"favorites\":[";
+    ensureAllFavLoaded();
     for (int i=0;i<CMD_FAV_SLOTS;i++) {
       if (i) out += ",";
       out += "{\"slot\":";
       out += String(i+1);
       out += ",\"valid\":";
-      out += (cmdFavValid[i] ? "true" : "false");
-      if (cmdFavValid[i]) {
-        String preview = cmdFavScript[i];
+      bool valid = favCodeValid(cmdFav[i]);
+      out += (valid ? "true" : "false");
+      if (favLegacyBad & (1u << i)) out += ",\"legacyInvalid\":true";
+      if (valid) {
+        out += ",\"steps\":";
+        out += String(cmdFav[i].blob[1]);
+        out += ",\"bytes\":";
+        out += String(cmdFav[i].len);
+        String preview = disassembleFavorite(cmdFav[i], 120);
         preview.replace("\n", "\\n");
         if (preview.length() > 120) preview = preview.substring(0, 120) + "...";
         out += ",\"preview\":\"";
-        out += jsonEscape(preview);
+        appendJsonEscaped(out, preview);
         out += "\"";
       }
       out += "}";
     }
     out += "]}";
-    emitLine(out, mirror);
+    emitLine(PanTiltMsg::Ack, out, mirror);
     return;
   }
 
@@ -1308,17 +4203,24 @@ static void handleCommandLine(String line) {
       sendErr(id, subsystem, route, mirror, "bad_slot", "favClear requires slot 0..5 (0 clears all)");
       return;
     }
+    if (slot == 0 ? macroActiveCount() > 0 : macroSlotRunning(slot - 1)) {
+      sendErr(id, subsystem, route, mirror, "macro_busy", "Cannot clear a favorite while it runs");
+      return;
+    }
     if (slot == 0) {
-      for (int i=0;i<CMD_FAV_SLOTS;i++) { cmdFavValid[i]=false; cmdFavScript[i]=""; }
-      cfgDirty = true;
+      for (int i=0;i<CMD_FAV_SLOTS;i++) favCodeFree(cmdFav[i]);
+      favLoadedMask = FAV_LOADED_ALL;
+      favLegacyBad = 0;
+      markDirty(DIRTY_FAV_ALL);
       sendOk(id, subsystem, route, mirror, "fav_cleared_all");
       sendState("done", id, subsystem, route, mirror);
       return;
     }
     int idx = slot - 1;
-    cmdFavValid[idx] = false;
-    cmdFavScript[idx] = "";
-    cfgDirty = true;
+    favCodeFree(cmdFav[idx]);
+    markFavLoaded(idx);
+    favLegacyBad &= (uint8_t)~(1u << idx);
+    markDirty(dirtyFav(idx));
     sendOk(id, subsystem, route, mirror, "fav_cleared");
     sendState("done", id, subsystem, route, mirror);
     return;
@@ -1338,29 +4240,23 @@ static void handleCommandLine(String line) {
       return;
     }
 
-    String script = unescapeScript(raw);
+    String& script = raw;
+    unescapeScript(script);
     script.trim();
     if (!script.length()) { sendErr(id, subsystem, route, mirror, "empty_script", "Provided line/script is empty"); return; }
     if (script.length() > FAV_SCRIPT_MAX) { sendErr(id, subsystem, route, mirror, "too_long", "Script too long"); return; }
-
-    String check = script;
-    int start = 0;
-    while (start < (int)check.length()) {
-      int end = check.indexOf('\n', start);
-      if (end < 0) end = check.length();
-      String one = check.substring(start, end);
-      one.trim();
-      start = end + 1;
-      if (!one.length()) continue;
-      if (looksDangerousFavorite(one)) {
-        sendErr(id, subsystem, route, mirror, "disallowed", "Favorite cannot include persist/factoryReset/favRun");
-        return;
-      }
-    }
-
-    cmdFavValid[idx] = true;
-    cmdFavScript[idx] = script;
-    cfgDirty = true;
+    if (macroSlotRunning(idx)) { sendErr(id, subsystem, route, mirror, "macro_busy", "Cannot replace a favorite while it runs"); return; }
+
+    uint8_t* code = (uint8_t*)scratchAlloc(FAV_CODE_MAX);
+    if (!code) { sendErr(id, subsystem, route, mirror, "no_memory", "Scratch arena full"); return; }
+    uint16_t codeLen = 0;
+    const char* ec=""; const char* em="";
+    if (!compileFavoriteScript(script, code, FAV_CODE_MAX, codeLen, ec, em)) { sendErr(id, subsystem, route, mirror, ec, em); return; }
+    if (!favCodeAssign(cmdFav[idx], code, codeLen)) { sendErr(id, subsystem, route, mirror, "no_memory", "Out of memory for favorite"); return; }
+    markFavLoaded(idx);
+    favLegacyBad &= (uint8_t)~(1u << idx);
+
+    markDirty(dirtyFav(idx));
     sendOk(id, subsystem, route, mirror, "fav_saved");
     sendState("done", id, subsystem, route, mirror);
     return;
@@ -1370,19 +4266,524 @@ static void handleCommandLine(String line) {
     int slot=0;
     if (!getIntField(line, "slot", slot) || slot < 1 || slot > CMD_FAV_SLOTS) { sendErr(id, subsystem, route, mirror, "bad_slot", "favRun requires slot 1..5"); return; }
     int idx = slot - 1;
-    if (!cmdFavValid[idx] || !cmdFavScript[idx].length()) { sendErr(id, subsystem, route, mirror, "empty_slot", "favorite slot is empty"); return; }
+    ensureFavLoaded(idx);
+    if (!favCodeValid(cmdFav[idx])) { sendErr(id, subsystem, route, mirror, "empty_slot", "favorite slot is empty"); return; }
 
-    sendOk(id, subsystem, route, mirror, "macro_running");
-    bool ok = runFavoriteScript(id, subsystem, route, mirror, cmdFavScript[idx]);
-    if (ok) {
-      sendOk(id, subsystem, route, mirror, "macro_complete");
-      sendState("done", id, subsystem, route, mirror);
+    if (macroStart(id, subsystem, route, mirror, idx)) sendOk(id, subsystem, route, mirror, "macro_running");
+    return;
+  }
+
+  if (cmd == "favstop") {
+    String name;
+    if (getStringField(line, "name", name)) {
+      int ci = storeCacheFind(SK_MACRO, storeHash(name));
+      uint8_t n = ci >= 0 ? macroStop(storeMacroSlot(ci), "macro_stopped") : 0;
+      sendOk(id, subsystem, route, mirror, n ? "macros_stopped" : "no_macro_running");
+      return;
+    }
+    int slot=0;
+    (void)getIntField(line, "slot", slot);
+    if (slot < 0 || slot > CMD_FAV_SLOTS) { sendErr(id, subsystem, route, mirror, "bad_slot", "favStop takes slot 0..5 (0 stops all)"); return; }
+    uint8_t n = macroStop(slot - 1, "macro_stopped");
+    sendOk(id, subsystem, route, mirror, n ? "macros_stopped" : "no_macro_running");
+    return;
+  }
+
+  // ---- named presets/macros (flash store) ----
+  if (cmd == "presetsave") {
+    String name; (void)getStringField(line, "name", name);
+    if (!storeNameValid(name)) { sendErr(id, subsystem, route, mirror, "bad_name", "name must be 1..19 chars of A-Z a-z 0-9 _ - ."); return; }
+    float pos[2] = { v1, v2 };
+    float val;
+    if (getNumberField(line, "x", val)) pos[0] = clampf(val, POS_MIN, POS_MAX);
+    if (getNumberField(line, "y", val)) pos[1] = clampf(val, POS_MIN, POS_MAX);
+
+    const char* ec=""; const char* em="";
+    if (!storePut(SK_PRESET, name, (const uint8_t*)pos, sizeof(pos), ec, em)) { sendErr(id, subsystem, route, mirror, ec, em); return; }
+    sendOk(id, subsystem, route, mirror, "preset_saved");
+    return;
+  }
+
+  // ---- soft limits / keep-out zones ----
+  if (cmd == "limits" || (PanTiltBuild::zones && cmd == "zone")) {
+    LimitConfig c = limits;
+    if (cmd == "limits") {
+      const char* const keys[] = { "minX", "maxX", "minY", "maxY" };
+      float* const dst[] = { &c.minX, &c.maxX, &c.minY, &c.maxY };
+      float val;
+      for (uint8_t i=0;i<4;i++) {
+        if (!getNumberField(line, keys[i], val)) continue;
+        if (val < POS_MIN || val > POS_MAX) { sendErr(id, subsystem, route, mirror, "bad_value", "limits must be -90..90"); return; }
+        *dst[i] = val;
+      }
+      if (c.minX >= c.maxX || c.minY >= c.maxY) { sendErr(id, subsystem, route, mirror, "bad_value", "each min must be below its max"); return; }
+      if (v1 < c.minX || v1 > c.maxX || v2 < c.minY || v2 > c.maxY) { sendErr(id, subsystem, route, mirror, "pose_outside", "Move inside the new limits first"); return; }
+    } else {
+      int slot = 0;
+      if (!getIntField(line, "slot", slot) || slot < 1 || slot > ZONE_MAX) { sendErr(id, subsystem, route, mirror, "bad_slot", "zone takes slot 1..4"); return; }
+      KeepOutZone& z = c.zones[slot - 1];
+      bool clear = false;
+      if (getBoolField(line, "clear", clear) && clear) {
+        z = KeepOutZone{};
+      } else {
+        float pts[ZONE_VERTS * 2];
+        uint8_t n = 0;
+        if (!getNumberArray(line, "pts", pts, ZONE_VERTS * 2, n) || (n & 1) || n < 6) { sendErr(id, subsystem, route, mirror, "bad_zone", "pts must be [pan,tilt, ...] with 3..8 vertices"); return; }
+        z = KeepOutZone{};
+        z.n = n / 2;
+        for (uint8_t k=0;k<z.n;k++) {
+          if (pts[2*k] < POS_MIN || pts[2*k] > POS_MAX || pts[2*k+1] < POS_MIN || pts[2*k+1] > POS_MAX) { sendErr(id, subsystem, route, mirror, "bad_zone", "zone vertices must be within -90..90"); return; }
+          z.x[k] = pts[2*k]; z.y[k] = pts[2*k+1];
+        }
+        if (pointInZone(z, v1, v2)) { sendErr(id, subsystem, route, mirror, "pose_in_zone", "Move out of the zone before adding it"); return; }
+      }
+    }
+    if (memcmp(&c, &limits, sizeof(c))) {
+      limits = c;
+      limitsDerive();
+      markDirty(DIRTY_LIMITS);
+    }
+
+    if (!sinkWants(PanTiltMsg::Ack, mirror)) return;
+    String out;
+    out.reserve(200);
+    out += "{\"ok\":true,\"id\":";
+    out += String(id);
+    appendRoutingFields(out, subsystem, route);
+    out += ",\"limits\":{\"minX\":"; out += String(limits.minX, 2);
+    out += ",\"maxX\":"; out += String(limits.maxX, 2);
+    out += ",\"minY\":"; out += String(limits.minY, 2);
+    out += ",\"maxY\":"; out += String(limits.maxY, 2);
+    out += "},\"zones\":[";
+    bool first = true;
+    for (uint8_t zi=0;zi<ZONE_MAX;zi++) {
+      const KeepOutZone& z = limits.zones[zi];
+      if (z.n < 3) continue;
+      if (!first) out += ",";
+      first = false;
+      out += "{\"slot\":"; out += String(zi + 1);
+      out += ",\"pts\":[";
+      for (uint8_t k=0;k<z.n;k++) {
+        if (k) out += ",";
+        out += String(z.x[k], 1); out += ","; out += String(z.y[k], 1);
+      }
+      out += "]}";
+    }
+    out += "]}";
+    emitLine(PanTiltMsg::Ack, out, mirror);
+    return;
+  }
+
+  // ---- velocity jog ----
+  if (PanTiltBuild::jog && cmd == "jog") {
+    float vx = jog.x.target, vy = jog.y.target, f;
+    bool hasX = getNumberField(line, "x", vx);
+    bool hasY = getNumberField(line, "y", vy);
+    if (fabsf(vx) > JOG_MAX_SPEED || fabsf(vy) > JOG_MAX_SPEED) { sendErr(id, subsystem, route, mirror, "bad_value", "jog x/y must be -1000..1000 deg/s"); return; }
+    float accel = jog.accel;
+    if (getNumberField(line, "accel", f)) { if (f < 1.0f || f > 20000.0f) { sendErr(id, subsystem, route, mirror, "bad_value", "accel must be 1..20000 deg/s^2"); return; } accel = f; }
+    int ka = jog.keepaliveMs;
+    if (getIntField(line, "keepalive", ka) && (ka < 50 || ka > 5000)) { sendErr(id, subsystem, route, mirror, "bad_value", "keepalive must be 50..5000 ms"); return; }
+
+    // Jogging an axis cancels whatever positioned move it was running
+    bool wasJogging = jog.x.active || jog.y.active;
+    if (hasX && !jog.x.active && vx != 0) jogTakeAxis('x');
+    if (hasY && !jog.y.active && vy != 0) jogTakeAxis('y');
+
+    uint32_t now = millis();
+    jog.accel = accel;
+    jog.keepaliveMs = (uint16_t)ka;
+    jog.refreshedAt = now;
+    jog.expired = false;
+    jog.origin = mirror;
+    jog.subsystem = subsystem;
+    jog.route = route;
+    if (!wasJogging) { jog.lastTick = now; jog.ref = id; }
+    if (hasX) { jog.x.target = vx; if (vx != 0) jog.x.active = true; }
+    if (hasY) { jog.y.target = vy; if (vy != 0) jog.y.active = true; }
+
+    sendOk(id, subsystem, route, mirror, (jog.x.active || jog.y.active) ? "jogging" : "jog_idle");
+    return;
+  }
+
+  // ---- camera-space aiming ----
+  if (PanTiltBuild::aiming && cmd == "camera") {
+    CameraModel c = cam;
+    float f;
+    if (getNumberField(line, "hfov", f)) { if (f < 1.0f || f > 170.0f) { sendErr(id, subsystem, route, mirror, "bad_value", "hfov must be 1..170 degrees"); return; } c.hfov = f; }
+    if (getNumberField(line, "vfov", f)) { if (f < 1.0f || f > 170.0f) { sendErr(id, subsystem, route, mirror, "bad_value", "vfov must be 1..170 degrees"); return; } c.vfov = f; }
+    if (getNumberField(line, "panOffset", f)) { if (fabsf(f) > 45.0f) { sendErr(id, subsystem, route, mirror, "bad_value", "panOffset must be -45..45 degrees"); return; } c.panOffset = f; }
+    if (getNumberField(line, "tiltOffset", f)) { if (fabsf(f) > 45.0f) { sendErr(id, subsystem, route, mirror, "bad_value", "tiltOffset must be -45..45 degrees"); return; } c.tiltOffset = f; }
+    if (memcmp(&c, &cam, sizeof(c))) {
+      cam = c;
+      cameraDerive();
+      markDirty(DIRTY_CAM);
+    }
+
+    if (!sinkWants(PanTiltMsg::Ack, mirror)) return;
+    String out;
+    out.reserve(160);
+    out += "{\"ok\":true,\"id\":";
+    out += String(id);
+    appendRoutingFields(out, subsystem, route);
+    out += ",\"camera\":{\"hfov\":"; out += String(cam.hfov, 2);
+    out += ",\"vfov\":"; out += String(cam.vfov, 2);
+    out += ",\"panOffset\":"; out += String(cam.panOffset, 2);
+    out += ",\"tiltOffset\":"; out += String(cam.tiltOffset, 2);
+    out += "}}";
+    emitLine(PanTiltMsg::Ack, out, mirror);
+    return;
+  }
+
+  if (PanTiltBuild::aiming && cmd == "look") {
+    float u=0, v=0;
+    if (!getNumberField(line, "u", u) || !getNumberField(line, "v", v)) { sendErr(id, subsystem, route, mirror, "missing_value", "look requires u and v (-1..1 from image centre)"); return; }
+    if (fabsf(u) > 1.5f || fabsf(v) > 1.5f) { sendErr(id, subsystem, route, mirror, "bad_value", "u and v must be -1..1 from image centre"); return; }
+
+    // Per-frame FOV overrides the stored camera (zoom changes)
+    float tanH = camTanH, tanV = camTanV, f;
+    if (getNumberField(line, "hfov", f)) { if (f < 1.0f || f > 170.0f) { sendErr(id, subsystem, route, mirror, "bad_value", "hfov must be 1..170 degrees"); return; } tanH = tanHalfDeg(f); }
+    if (getNumberField(line, "vfov", f)) { if (f < 1.0f || f > 170.0f) { sendErr(id, subsystem, route, mirror, "bad_value", "vfov must be 1..170 degrees"); return; } tanV = tanHalfDeg(f); }
+
+    float tx, ty;
+    projectLook(cam, v1, v2, u, v, tanH, tanV, tx, ty);
+    tx = clampf(tx, POS_MIN, POS_MAX);
+    ty = clampf(ty, POS_MIN, POS_MAX);
+
+    float durSec=-1, sp=-1;
+    bool hasDur = getNumberField(line, "dur", durSec);
+    bool hasSpeed = getNumberField(line, "speed", sp);
+
+    QueueItem it;
+    if (!buildPositionStep(id, subsystem, route, "look", tx, ty, true, true, hasDur, durSec, hasSpeed, sp, it)) { sendErr(id, subsystem, route, mirror, "bad_timing", "Invalid dur or speed"); return; }
+    it.mirrorToBle = mirror;
+
+    bool enqueue = shouldEnqueue(qMode, hasQ, qVal);
+    if (refuseTargetInZone(it, enqueue)) return;
+    if (!dispatchStep(it, enqueue)) { sendErr(id, subsystem, route, mirror, "queue_full", "Queue full"); return; }
+    sendOk(id, subsystem, route, mirror, enqueue ? "queued" : "executing");
+    return;
+  }
+
+  // ---- world targeting ----
+  if (PanTiltBuild::world && cmd == "rigframe") {
+    RigFrame f = frame;
+    float val;
+    const char* const keys[] = { "x", "y", "z", "yaw", "pitch", "roll", "tiltHeight", "camOffset" };
+    float* const dst[] = { &f.x, &f.y, &f.z, &f.yaw, &f.pitch, &f.roll, &f.tiltHeight, &f.camOffset };
+    for (uint8_t i=0;i<8;i++) {
+      if (!getNumberField(line, keys[i], val)) continue;
+      bool angle = i >= 3 && i <= 5;
+      if (angle ? fabsf(val) > 180.0f : fabsf(val) > 1000.0f) { sendErr(id, subsystem, route, mirror, "bad_value", "angles must be -180..180, distances -1000..1000 m"); return; }
+      *dst[i] = val;
+    }
+    if (memcmp(&f, &frame, sizeof(f))) {
+      frame = f;
+      frameDerive();
+      markDirty(DIRTY_FRAME);
+    }
+
+    if (!sinkWants(PanTiltMsg::Ack, mirror)) return;
+    String out;
+    out.reserve(220);
+    out += "{\"ok\":true,\"id\":";
+    out += String(id);
+    appendRoutingFields(out, subsystem, route);
+    out += ",\"frame\":{";
+    for (uint8_t i=0;i<8;i++) {
+      if (i) out += ",";
+      out += "\""; out += keys[i]; out += "\":";
+      out += String(*dst[i], 3);   // f == frame here
+    }
+    out += "}}";
+    emitLine(PanTiltMsg::Ack, out, mirror);
+    return;
+  }
+
+  if (PanTiltBuild::world && cmd == "targetsave") {
+    String name; (void)getStringField(line, "name", name);
+    if (!storeNameValid(name)) { sendErr(id, subsystem, route, mirror, "bad_name", "name must be 1..19 chars of A-Z a-z 0-9 _ - ."); return; }
+    float p[3];
+    if (!getNumberField(line, "x", p[0]) || !getNumberField(line, "y", p[1]) || !getNumberField(line, "z", p[2])) { sendErr(id, subsystem, route, mirror, "missing_value", "targetSave requires x, y, z (world metres)"); return; }
+
+    const char* ec=""; const char* em="";
+    if (!storePut(SK_TARGET, name, (const uint8_t*)p, sizeof(p), ec, em)) { sendErr(id, subsystem, route, mirror, ec, em); return; }
+    sendOk(id, subsystem, route, mirror, "target_saved");
+    return;
+  }
+
+  if (PanTiltBuild::world && cmd == "lookat") {
+    float wx, wy, wz;
+    String name;
+    if (getStringField(line, "name", name)) {
+      if (!storeNameValid(name)) { sendErr(id, subsystem, route, mirror, "bad_name", "lookAt name is not valid"); return; }
+      const char* ec=""; const char* em="";
+      int ci = storeGet(SK_TARGET, name, ec, em);
+      if (ci < 0) { sendErr(id, subsystem, route, mirror, ec, em); return; }
+      wx = storeCache[ci].x; wy = storeCache[ci].y; wz = storeCache[ci].z;
+    } else if (!getNumberField(line, "x", wx) || !getNumberField(line, "y", wy) || !getNumberField(line, "z", wz)) {
+      sendErr(id, subsystem, route, mirror, "missing_value", "lookAt requires name or x, y, z (world metres)");
+      return;
+    }
+
+    float tx, ty;
+    if (!solveLookAt(wx, wy, wz, tx, ty)) { sendErr(id, subsystem, route, mirror, "out_of_reach", "Point is outside the rig's pan/tilt range"); return; }
+    tx = clampf(tx, POS_MIN, POS_MAX);
+    ty = clampf(ty, POS_MIN, POS_MAX);
+
+    float durSec=-1, sp=-1;
+    bool hasDur = getNumberField(line, "dur", durSec);
+    bool hasSpeed = getNumberField(line, "speed", sp);
+
+    QueueItem it;
+    if (!buildPositionStep(id, subsystem, route, "lookAt", tx, ty, true, true, hasDur, durSec, hasSpeed, sp, it)) { sendErr(id, subsystem, route, mirror, "bad_timing", "Invalid dur or speed"); return; }
+    it.mirrorToBle = mirror;
+
+    bool enqueue = shouldEnqueue(qMode, hasQ, qVal);
+    if (refuseTargetInZone(it, enqueue)) return;
+    if (!dispatchStep(it, enqueue)) { sendErr(id, subsystem, route, mirror, "queue_full", "Queue full"); return; }
+    sendOk(id, subsystem, route, mirror, enqueue ? "queued" : "executing");
+    return;
+  }
+
+  // ---- multi-target selection ----
+  if (PanTiltBuild::targets && cmd == "targets") {
+    TargetTracker t = track;
+    float f;
+    if (getNumberField(line, "lockMs", f)) { if (f < 0 || f > 10000) { sendErr(id, subsystem, route, mirror, "bad_value", "lockMs must be 0..10000"); return; } t.lockMs = (uint16_t)f; }
+    if (getNumberField(line, "lostMs", f)) { if (f < 0 || f > 10000) { sendErr(id, subsystem, route, mirror, "bad_value", "lostMs must be 0..10000"); return; } t.lostMs = (uint16_t)f; }
+    if (getNumberField(line, "margin", f)) { if (f < 0 || f > 1) { sendErr(id, subsystem, route, mirror, "bad_value", "margin must be 0..1"); return; } t.switchMargin = f; }
+    if (getNumberField(line, "minConf", f)) { if (f < 0 || f > 1) { sendErr(id, subsystem, route, mirror, "bad_value", "minConf must be 0..1"); return; } t.minConf = f; }
+    if (getNumberField(line, "deadband", f)) { if (f < 0 || f > 0.5f) { sendErr(id, subsystem, route, mirror, "bad_value", "deadband must be 0..0.5"); return; } t.deadband = f; }
+
+    // b = [u,v,w,h,conf, u,v,w,h,conf, ...]; without b this only tunes and reports
+    float raw[TARGET_MAX * 5];
+    uint8_t nv = 0;
+    int kp;
+    bool hasBoxes = findKey(line, "b", kp);
+    if (hasBoxes && (!getNumberArray(line, "b", raw, TARGET_MAX * 5, nv) || nv % 5)) { sendErr(id, subsystem, route, mirror, "bad_boxes", "b must be [u,v,w,h,conf, ...] for up to 8 boxes"); return; }
+    track = t;
+
+    int8_t pick = -1;
+    bool switched = false, wasLocked = track.locked;
+    if (hasBoxes) {
+      TargetBox boxes[TARGET_MAX];
+      uint8_t n = nv / 5;
+      for (uint8_t i=0;i<n;i++) {
+        const float* q = raw + i * 5;
+        boxes[i].u = q[0]; boxes[i].v = q[1]; boxes[i].w = q[2]; boxes[i].h = q[3]; boxes[i].conf = q[4];
+      }
+      pick = selectTarget(boxes, n, millis(), switched);
+
+      if (pick >= 0) {
+        const TargetBox& b = boxes[pick];
+        if (fabsf(b.u) > track.deadband || fabsf(b.v) > track.deadband) {
+          float tx, ty;
+          projectLook(cam, v1, v2, clampf(b.u, -1.5f, 1.5f), clampf(b.v, -1.5f, 1.5f), camTanH, camTanV, tx, ty);
+          tx = clampf(tx, POS_MIN, POS_MAX);
+          ty = clampf(ty, POS_MIN, POS_MAX);
+
+          float durSec=-1, sp=-1;
+          bool hasDur = getNumberField(line, "dur", durSec);
+          bool hasSpeed = getNumberField(line, "speed", sp);
+
+          QueueItem it;
+          if (!buildPositionStep(id, subsystem, route, "track", tx, ty, true, true, hasDur, durSec, hasSpeed, sp, it)) { sendErr(id, subsystem, route, mirror, "bad_timing", "Invalid dur or speed"); return; }
+          it.mirrorToBle = mirror;
+          bool enqueue = shouldEnqueue(qMode, hasQ, qVal);
+          if (refuseTargetInZone(it, enqueue)) return;
+          if (!dispatchStep(it, enqueue)) { sendErr(id, subsystem, route, mirror, "queue_full", "Queue full"); return; }
+        }
+      }
+    }
+
+    // A lock change is an event every subscriber hears; the per-frame reply is chatter
+    bool changed = switched || (wasLocked && !track.locked);
+    bool wantReply = sinkWants(PanTiltMsg::Ack, mirror, RK_STATE);
+    if (!changed && !wantReply) return;
+
+    String lock;
+    lock.reserve(120);
+    lock += ",\"lock\":{\"id\":"; lock += String(track.lockId);
+    lock += ",\"locked\":"; lock += track.locked ? "true" : "false";
+    lock += ",\"idx\":"; lock += String((int)pick);
+    lock += ",\"switched\":"; lock += switched ? "true" : "false";
+    lock += ",\"age\":"; lock += String(track.locked ? millis() - track.lockedAt : 0);
+    lock += ",\"frames\":"; lock += String(track.frames);
+    lock += ",\"switches\":"; lock += String(track.switches);
+    lock += "}";
+
+    if (changed && sinkWants(PanTiltMsg::Motion, mirror)) {
+      String ev = "{\"ok\":true,\"event\":\"lock\"";
+      appendRoutingFields(ev, subsystem, route);
+      ev += lock; ev += "}";
+      emitLine(PanTiltMsg::Motion, ev, mirror);
+    }
+    if (wantReply) {
+      String out;
+      out.reserve(180);
+      out += "{\"ok\":true,\"id\":";
+      out += String(id);
+      appendRoutingFields(out, subsystem, route);
+      out += lock; out += "}";
+      emitLine(PanTiltMsg::Ack, out, mirror, RK_STATE);
+    }
+    return;
+  }
+
+  if (cmd == "presetgo") {
+    String name; (void)getStringField(line, "name", name);
+    if (!storeNameValid(name)) { sendErr(id, subsystem, route, mirror, "bad_name", "presetGo requires a valid name"); return; }
+
+    String axis="xy"; (void)getStringField(line, "axis", axis);
+    bool useX=false,useY=false;
+    if (!parseAxisMask(axis, useX, useY)) { sendErr(id, subsystem, route, mirror, "bad_axis", "axis must be x, y, or xy"); return; }
+
+    float durSec=-1, sp=-1;
+    bool hasDur = getNumberField(line, "dur", durSec);
+    bool hasSpeed = getNumberField(line, "speed", sp);
+
+    const char* ec=""; const char* em="";
+    int ci = storeGet(SK_PRESET, name, ec, em);
+    if (ci < 0) { sendErr(id, subsystem, route, mirror, ec, em); return; }
+
+    QueueItem it;
+    if (!buildPositionStep(id, subsystem, route, "preset", storeCache[ci].x, storeCache[ci].y, useX, useY, hasDur, durSec, hasSpeed, sp, it)) { sendErr(id, subsystem, route, mirror, "bad_timing", "Invalid dur or speed"); return; }
+    it.mirrorToBle = mirror;
+
+    bool enqueue = shouldEnqueue(qMode, hasQ, qVal);
+    if (refuseTargetInZone(it, enqueue)) return;
+    if (enqueue) {
+      if (!qEnqueue(it)) { sendErr(id, subsystem, route, mirror, "queue_full", "Queue full"); return; }
+      sendOk(id, subsystem, route, mirror, "queued");
+      sendState(nullptr, 0, subsystem, route, mirror);
+      return;
     }
+
+    executeStep(it);
+    sendOk(id, subsystem, route, mirror, "executing");
+    return;
+  }
+
+  if (cmd == "macrosave") {
+    String name; (void)getStringField(line, "name", name);
+    if (!storeNameValid(name)) { sendErr(id, subsystem, route, mirror, "bad_name", "name must be 1..19 chars of A-Z a-z 0-9 _ - ."); return; }
+
+    String raw;
+    bool hasLine = getStringField(line, "line", raw);
+    bool hasScript = getStringField(line, "script", raw);
+    if (!hasLine && !hasScript) { sendErr(id, subsystem, route, mirror, "missing_value", "macroSave requires \"line\" or \"script\""); return; }
+
+    String& script = raw;
+    unescapeScript(script);
+    script.trim();
+    if (!script.length()) { sendErr(id, subsystem, route, mirror, "empty_script", "Provided line/script is empty"); return; }
+    if (script.length() > FAV_SCRIPT_MAX) { sendErr(id, subsystem, route, mirror, "too_long", "Script too long"); return; }
+
+    int ci = storeCacheFind(SK_MACRO, storeHash(name));
+    if (ci >= 0 && macroSlotRunning(storeMacroSlot(ci))) { sendErr(id, subsystem, route, mirror, "macro_busy", "Cannot replace a macro while it runs"); return; }
+
+    uint8_t* code = (uint8_t*)scratchAlloc(FAV_CODE_MAX);
+    if (!code) { sendErr(id, subsystem, route, mirror, "no_memory", "Scratch arena full"); return; }
+    uint16_t codeLen = 0;
+    const char* ec=""; const char* em="";
+    if (!compileFavoriteScript(script, code, FAV_CODE_MAX, codeLen, ec, em)) { sendErr(id, subsystem, route, mirror, ec, em); return; }
+    if (!storePut(SK_MACRO, name, code, codeLen, ec, em)) { sendErr(id, subsystem, route, mirror, ec, em); return; }
+    sendOk(id, subsystem, route, mirror, "macro_saved");
+    return;
+  }
+
+  if (cmd == "macrorun") {
+    String name; (void)getStringField(line, "name", name);
+    if (!storeNameValid(name)) { sendErr(id, subsystem, route, mirror, "bad_name", "macroRun requires a valid name"); return; }
+
+    const char* ec=""; const char* em="";
+    int ci = storeGet(SK_MACRO, name, ec, em);
+    if (ci < 0) { sendErr(id, subsystem, route, mirror, ec, em); return; }
+
+    if (macroStart(id, subsystem, route, mirror, storeMacroSlot(ci))) sendOk(id, subsystem, route, mirror, "macro_running");
+    return;
+  }
+
+  if (cmd == "presetdelete" || cmd == "macrodelete" || (PanTiltBuild::world && cmd == "targetdelete")) {
+    String name; (void)getStringField(line, "name", name);
+    if (!storeNameValid(name)) { sendErr(id, subsystem, route, mirror, "bad_name", "delete requires a valid name"); return; }
+
+    const char* ec=""; const char* em="";
+    uint8_t kind = cmd == "macrodelete" ? SK_MACRO : (cmd == "targetdelete" ? SK_TARGET : SK_PRESET);
+    if (!storeDelete(kind, name, ec, em)) { sendErr(id, subsystem, route, mirror, ec, em); return; }
+    sendOk(id, subsystem, route, mirror, "deleted");
     return;
   }
 
   // ---- sweep macro ----
   if (cmd == "sweep") {
+    String shape = "triangle"; (void)getStringField(line, "shape", shape);
+    shape.toLowerCase();
+    int8_t si = -1;
+    for (uint8_t i=0;i<sizeof(SWEEP_SHAPE_NAMES)/sizeof(SWEEP_SHAPE_NAMES[0]);i++) if (shape == SWEEP_SHAPE_NAMES[i]) si = (int8_t)i;
+    if (si < 0 && shape != "triangle") { sendErr(id, subsystem, route, mirror, "bad_shape", "shape must be triangle|sine|ease|raster|spiral|lissajous"); return; }
+    if (si >= 0 && !PanTiltBuild::sweepShapes) { sendErr(id, subsystem, route, mirror, "not_built", "sweep shapes other than triangle are not in this build profile"); return; }
+
+    if (PanTiltBuild::sweepShapes && si >= 0) {
+      SweepPattern p;
+      p.shape = (SweepShape)si;
+      bool planar = p.shape == SS_RASTER || p.shape == SS_SPIRAL || p.shape == SS_LISSAJOUS;
+      String axis = planar ? "xy" : "x"; (void)getStringField(line, "axis", axis);
+      if (!parseAxisMask(axis, p.useX, p.useY)) { sendErr(id, subsystem, route, mirror, "bad_axis", "axis must be x, y, or xy"); return; }
+      if (planar && !(p.useX && p.useY)) { sendErr(id, subsystem, route, mirror, "bad_axis", "raster, spiral and lissajous use both axes"); return; }
+
+      // Window: centre + amplitude (cx, cy, amp, ampX, ampY), or from/to on the swept axes
+      float f;
+      p.cx = v1; p.cy = v2;
+      p.ax = p.ay = 30.0f;
+      (void)getNumberField(line, "cx", p.cx);
+      (void)getNumberField(line, "cy", p.cy);
+      if (getNumberField(line, "amp", f)) p.ax = p.ay = f;
+      (void)getNumberField(line, "ampX", p.ax);
+      (void)getNumberField(line, "ampY", p.ay);
+      float from, to;
+      if (getNumberField(line, "from", from) && getNumberField(line, "to", to)) {
+        from = clampf(from, POS_MIN, POS_MAX);
+        to = clampf(to, POS_MIN, POS_MAX);
+        if (p.useX) { p.cx = (from + to) * 0.5f; p.ax = (to - from) * 0.5f; }
+        if (p.useY) { p.cy = (from + to) * 0.5f; p.ay = (to - from) * 0.5f; }
+      }
+      if (fabsf(p.ax) > 90.0f || fabsf(p.ay) > 90.0f) { sendErr(id, subsystem, route, mirror, "bad_value", "amplitude must be -90..90 degrees"); return; }
+
+      // period is one full cycle; legacy dur is one leg
+      float periodSec = 0;
+      if (!getNumberField(line, "period", periodSec) && getNumberField(line, "dur", f)) periodSec = 2.0f * f;
+      if (periodSec < 0.2f || periodSec > 3600.0f) { sendErr(id, subsystem, route, mirror, "bad_dur", "sweep period must be 0.2..3600 seconds"); return; }
+      p.periodMs = (uint32_t)(periodSec * 1000.0f + 0.5f);
+
+      if (getNumberField(line, "phase", f)) p.phase = fracf(f / 360.0f);
+      int count = 1;
+      if (!getIntField(line, "count", count)) (void)getIntField(line, "loops", count);
+      if (count < 0 || count > 1000000) { sendErr(id, subsystem, route, mirror, "bad_value", "count must be 0..1000000 (0 = endless)"); return; }
+      p.count = (uint32_t)count;
+      if (getNumberField(line, "ratio", f)) { if (f <= 0.0f || f > 50.0f) { sendErr(id, subsystem, route, mirror, "bad_value", "ratio must be >0..50"); return; } p.ratio = f; }
+      else if (p.shape == SS_SPIRAL) p.ratio = 4.0f;
+      int lines = p.lines;
+      if (getIntField(line, "lines", lines) && (lines < 2 || lines > 100)) { sendErr(id, subsystem, route, mirror, "bad_value", "lines must be 2..100"); return; }
+      p.lines = (uint8_t)lines;
+
+      stopAllMotion();
+      float sx, sy;
+      patternAt(p, 0, p.phase, sx, sy);
+      uint32_t lx = p.useX ? durationFromSpeed(v1, sx, defaultSpeed) : 0;
+      uint32_t ly = p.useY ? durationFromSpeed(v2, sy, defaultSpeed) : 0;
+      p.leadMs = lx > ly ? lx : ly;
+      p.leadX = v1; p.leadY = v2;
+      p.t0 = millis();
+      p.ref = id; p.origin = mirror; p.subsystem = subsystem; p.route = route;
+      p.active = true;
+      pat = p;
+
+      sendOk(id, subsystem, route, mirror, "sweep_running");
+      return;
+    }
+
     String axis="x"; (void)getStringField(line, "axis", axis);
     bool useX=false,useY=false;
     if (!parseAxisMask(axis, useX, useY)) { sendErr(id, subsystem, route, mirror, "bad_axis", "axis must be x, y, or xy"); return; }
@@ -1478,12 +4879,13 @@ static void handleCommandLine(String line) {
   // ---- motion commands ----
   if (cmd == "set" || cmd == "adjust" || cmd == "center") {
     String axis="xy"; (void)getStringField(line, "axis", axis);
-    bool ok=false; String ec, em;
+    bool ok=false; const char* ec=""; const char* em="";
     QueueItem it = buildStepFromCommand(id, subsystem, route, cmd, axis, line, ok, ec, em);
     it.mirrorToBle = mirror;
-    if (!ok) { sendErr(id, subsystem, route, mirror, ec.c_str(), em.c_str()); return; }
+    if (!ok) { sendErr(id, subsystem, route, mirror, ec, em); return; }
 
     bool enqueue = shouldEnqueue(qMode, hasQ, qVal);
+    if (refuseTargetInZone(it, enqueue)) return;
     if (enqueue) {
       if (!qEnqueue(it)) { sendErr(id, subsystem, route, mirror, "queue_full", "Queue full"); return; }
       sendOk(id, subsystem, route, mirror, "queued");
@@ -1499,38 +4901,128 @@ static void handleCommandLine(String line) {
   sendErr(id, subsystem, route, mirror, "unknown_cmd", "Unknown cmd (try {\"cmd\":\"commands\"})");
 }
 
-// ------------------- Public API -------------------
-void PanTilt_setOutput(PanTiltOutputFn fn) { g_out = fn; }
-
-void PanTilt_begin(int servoXPin, int servoYPin) {
-  SERVO1_PIN = servoXPin;
-  SERVO2_PIN = servoYPin;
-
-  s1.setPeriodHertz(50);
-  s2.setPeriodHertz(50);
-  s1.attach(SERVO1_PIN, 500, 2400);
-  s2.attach(SERVO2_PIN, 500, 2400);
-
+// ------------------- Rig Lifecycle -------------------
+void PanTiltRig::begin() {
+  s1.setPeriodHertz(PanTiltBuild::servoHz);
+  s2.setPeriodHertz(PanTiltBuild::servoHz);
+  s1.attach(rigCfg.servoXPin, PanTiltBuild::servoAttachMinUs, PanTiltBuild::servoAttachMaxUs);
+  s2.attach(rigCfg.servoYPin, PanTiltBuild::servoAttachMinUs, PanTiltBuild::servoAttachMaxUs);
+
+  // Only the config blob (speed, inversion, positions) gates the first servo write;
+  // favorites are loaded lazily afterwards.
+  uint32_t loadStart = micros();
+  schedInit();
+  replayInit();
   applyDefaults();
   bool loaded = loadConfigFromFlash();
+  uint32_t loadUs = micros() - loadStart;
   applyOutputs();
+  uint32_t firstWriteUs = micros();
 
   String ready;
   ready.reserve(120);
-  ready += "{\"ok\":true,\"event\":\"pantilt_ready\",\"loaded\":";
+  ready += "{\"ok\":true,\"event\":\"pantilt_ready\"";
+  appendRoutingFields(ready, "", rigCfg.route);
+  ready += ",\"loaded\":";
   ready += (loaded ? "true" : "false");
+  ready += ",\"loadUs\":";
+  ready += String(loadUs);
+  ready += ",\"firstWriteUs\":";
+  ready += String(firstWriteUs);
   ready += "}";
-  emitLine(ready, false);
+  emitLine(PanTiltMsg::Debug, ready, PANTILT_LINK_SYSTEM);
 }
 
-void PanTilt_loop() {
+void PanTiltRig::loop() {
+  g_creditRig = this;
+  if (PanTiltBuild::hostClock) schedTick();
   updateMotion();
+  limitTripTick();
+  if (PanTiltBuild::telemetry) telemetryTick(millis());
+  macroTick();
+  autosaveTick();
+  favPrefetchTick();
+}
+
+// ------------------- Rig Routing -------------------
+// Rigs are found by FNV-1a of their route in a small open-addressed table, so dispatch
+// cost doesn't grow with the number of rigs. Lines without a route, or with a route no
+// rig claims, go to the first rig (routes were free-form tags before multi-rig support).
+static const uint8_t PANTILT_MAX_RIGS = PanTiltBuild::maxRigs;
+static const uint8_t ROUTE_BUCKETS = 8;   // power of two, > PANTILT_MAX_RIGS
+
+static PanTiltRig* rigs[PANTILT_MAX_RIGS];
+static uint8_t rigCount = 0;
+static int8_t routeTable[ROUTE_BUCKETS] = {-1,-1,-1,-1,-1,-1,-1,-1};
+
+static int routeFind(const String& route) {
+  uint8_t b = storeHash(route) & (ROUTE_BUCKETS - 1);
+  for (uint8_t n=0;n<ROUTE_BUCKETS;n++) {
+    int8_t r = routeTable[b];
+    if (r < 0) return -1;
+    if (route == rigs[r]->route()) return r;
+    b = (b + 1) & (ROUTE_BUCKETS - 1);
+  }
+  return -1;
+}
+
+// ------------------- Public API -------------------
+void PanTilt_setOutput(PanTiltOutputFn fn) { g_out = fn; }
+void PanTilt_setInputCredit(PanTiltInputCreditFn fn) { g_inputCredit = fn; }
+
+void PanTilt_linkOpened(PanTiltLink link) {
+  OutputSink* sk = sinkFind(link, true);
+  if (sk) sinkDefaults(*sk, link);   // a reused BLE conn id starts fresh
+}
+
+void PanTilt_linkClosed(PanTiltLink link) {
+  if (link == PANTILT_LINK_USB) return;
+  OutputSink* sk = sinkFind(link, false);
+  if (sk) sk->used = false;
+  for (uint8_t i=0;i<rigCount;i++) rigs[i]->linkClosed(link);
+}
+
+bool PanTilt_wants(PanTiltMsg cls) { return sinkWants(cls, PANTILT_LINK_SYSTEM); }
+
+void PanTilt_emit(PanTiltMsg cls, const String& line) { emitLine(cls, line, PANTILT_LINK_SYSTEM); }
+
+bool PanTilt_addRig(const PanTiltRigConfig& cfg) {
+  String route = cfg.route ? cfg.route : "";
+  if (rigCount >= PANTILT_MAX_RIGS || routeFind(route) >= 0) return false;
+
+  PanTiltRig* rig = new PanTiltRig(cfg);
+  uint8_t b = storeHash(route) & (ROUTE_BUCKETS - 1);
+  while (routeTable[b] >= 0) b = (b + 1) & (ROUTE_BUCKETS - 1);
+  routeTable[b] = (int8_t)rigCount;
+  rigs[rigCount++] = rig;
+
+  rig->begin();
+  return true;
+}
+
+void PanTilt_begin(int servoXPin, int servoYPin) {
+  PanTiltRigConfig cfg;
+  cfg.servoXPin = servoXPin;
+  cfg.servoYPin = servoYPin;
+  PanTilt_addRig(cfg);
+}
+
+void PanTilt_loop() {
+  for (uint8_t i=0;i<rigCount;i++) rigs[i]->loop();
 }
 
-void PanTilt_handleLine(String line, bool fromBle) {
+void PanTilt_handleLine(String line, bool fromBle, int bleConn) {
   g_defaultSubsystem = fromBle ? "ble" : "usb";
-  g_mirrorToBle = fromBle;
+  if (!fromBle) g_mirrorToBle = PANTILT_LINK_USB;
+  else if (bleConn < 0 || bleConn >= PANTILT_LINK_SYSTEM - 1) g_mirrorToBle = PANTILT_LINK_BLE_ALL;
+  else g_mirrorToBle = PanTilt_bleLink(bleConn);
+  (void)sinkFind(g_mirrorToBle, true);   // links that never announced themselves get defaults
+  if (!rigCount) return;
+
+  String route;
+  int r = getStringField(line, "route", route) ? routeFind(route) : -1;
+  if (r < 0) r = 0;
 
   // Allow controller to send raw lines; module will respond with JSON errors if not valid.
-  handleCommandLine(line);
-}
\ No newline at end of file
+  rigs[r]->handleClientLine(line);
+}
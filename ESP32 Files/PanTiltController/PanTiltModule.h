@@ -1,17 +1,71 @@
 #pragma once
 #include <Arduino.h>
+#include "PanTiltConfig.h"
 
 enum class PanTiltDest : uint8_t { USB = 0, BLE = 1 };
-using PanTiltOutputFn = void (*)(PanTiltDest dest, const String& line);
+
+// A link is one output sink and also the origin tag of a command and its async events.
+// Values 1..253 are a BLE connection id + 1.
+typedef uint8_t PanTiltLink;
+static const PanTiltLink PANTILT_LINK_USB = 0;
+static const PanTiltLink PANTILT_LINK_SYSTEM = 0xFE;   // origin of unprompted lines (boot, link events)
+static const PanTiltLink PANTILT_LINK_BLE_ALL = 0xFF;  // BLE without a known connection: every central
+
+// bleConn is the target connection id for BLE output, or -1 for all centrals.
+using PanTiltOutputFn = void (*)(PanTiltDest dest, const String& line, int bleConn);
 
 void PanTilt_setOutput(PanTiltOutputFn fn);
 
+// Free input capacity of a link, reported as credit on acks and telemetry ({"cmd":"window"}).
+// bytes = what the host may still write before the adapter buffer fills; lines = lines left
+// in the adapter's flood window. Return false if the link is unknown.
+struct PanTiltInputCredit {
+  uint32_t bytes = 0;
+  uint32_t lines = 0;
+};
+using PanTiltInputCreditFn = bool (*)(PanTiltLink link, PanTiltInputCredit& out);
+
+void PanTilt_setInputCredit(PanTiltInputCreditFn fn);
+
+// Message classes a link can subscribe to ({"cmd":"subscribe"}), each at off|own|all.
+// "own" = lines caused by this link's commands plus system lines; "all" = every link's.
+enum class PanTiltMsg : uint8_t { Ack = 0, Motion, Telemetry, Fault, Debug };
+static const uint8_t PANTILT_MSG_CLASSES = 5;
+
+inline PanTiltLink PanTilt_bleLink(int connId) { return (PanTiltLink)(connId + 1); }
+
+// Register/unregister an output link (USB is always registered). New links start with
+// acks, motion, telemetry and faults at "own" and debug off.
+void PanTilt_linkOpened(PanTiltLink link);
+void PanTilt_linkClosed(PanTiltLink link);
+
+// True if any link would receive a system line of this class; check before formatting.
+bool PanTilt_wants(PanTiltMsg cls);
+// Fan a system line (already JSON) out to the links subscribed to cls.
+void PanTilt_emit(PanTiltMsg cls, const String& line);
+
+// One camera head. Each rig has its own servos, queue, favorites and NVS namespaces.
+struct PanTiltRigConfig {
+  const char* route = "";            // commands whose "route" matches go to this rig (keep the string alive)
+  int servoXPin = 3;
+  int servoYPin = 4;
+  int xMinUs = PanTiltBuild::xMinUs, xMaxUs = PanTiltBuild::xMaxUs;   // pulse range mapped to -90..+90
+  int yMinUs = PanTiltBuild::yMinUs, yMaxUs = PanTiltBuild::yMaxUs;
+  const char* prefNs = "pantilt";    // NVS namespaces (max 15 chars), unique per rig
+  const char* storeNs = "ptstore";
+};
+
 // Pins are the ESP32 GPIOs for your servos (same defaults as your PanTilt_JSON sketch).
+// Registers the default rig, which also receives lines without a known route.
 void PanTilt_begin(int servoXPin = 3, int servoYPin = 4);
 
-// Call from loop() frequently.
+// Adds another rig (up to PanTiltBuild::maxRigs in total). Returns false if the table is full or the route is taken.
+bool PanTilt_addRig(const PanTiltRigConfig& cfg);
+
+// Call from loop() frequently; updates every rig in one pass.
 void PanTilt_loop();
 
 // Provide one newline-terminated JSON object WITHOUT the newline (the adapters already strip it).
-// fromBle controls mirroring: always outputs to USB; also outputs to BLE when fromBle=true.
-void PanTilt_handleLine(String line, bool fromBle);
\ No newline at end of file
+// fromBle/bleConn name the origin link; replies go to the links subscribed to them
+// (by default USB sees everything and a BLE central sees its own replies).
+void PanTilt_handleLine(String line, bool fromBle, int bleConn = -1);
\ No newline at end of file
@@ -0,0 +1,600 @@
+#pragma once
+#include <Arduino.h>
+#include <ESP32Servo.h>
+#include <Preferences.h>
+#include "PanTiltModule.h"
+
+// Internal to PanTiltModule.cpp: one PanTiltRig per camera head. Each rig owns its
+// servos, motion state, queue, favorites, macro VMs and NVS namespaces; the module
+// routes commands to rigs by their "route" field.
+
+// ------------------- Sizes -------------------
+// Set by the build profile (PanTiltConfig.h); a disabled feature keeps a one-entry stub.
+static const uint8_t QMAX = PanTiltBuild::queueDepth;
+static const uint8_t QLANES = 2;
+static const int POS_FAV_SLOTS = 5;
+static const int CMD_FAV_SLOTS = 5;
+static const uint8_t STORE_NAME_MAX = 19;
+static const uint8_t STORE_CACHE_SLOTS = 4;
+static const uint8_t MACRO_VMS = PanTiltBuild::macroVms;
+static const uint8_t MACRO_LOOP_DEPTH = 4;
+static const uint8_t SCHED_MAX = PanTiltBuild::hostClock ? PanTiltBuild::schedMax : 1;
+static const uint8_t SCHED_WHEEL = PanTiltBuild::hostClock ? 64 : 1;   // 1 ms buckets, power of two
+static const uint8_t REPLAY_MAX = PanTiltBuild::replay ? PanTiltBuild::replayMax : 1;
+static const uint8_t REPLAY_SLOTS = REPLAY_MAX > 32 ? 128 : (REPLAY_MAX > 16 ? 64 : (REPLAY_MAX > 8 ? 32 : (REPLAY_MAX > 4 ? 16 : (REPLAY_MAX > 1 ? 8 : 2))));  // power of two, >= 2 * REPLAY_MAX
+static const uint8_t REPLAY_TEXT = 24;
+
+// ------------------- Replies -------------------
+// What a reply line is, so each link's ackLevel can filter it (see Output Sinks).
+// RK_TINY is the {"ok":1,"id":N} form of an ok reply that only minimal links get.
+enum ReplyKind : uint8_t { RK_DATA = 0, RK_OK, RK_TINY, RK_STATE, RK_STARTED, RK_DONE, RK_FAULT };
+
+// ------------------- Motion Profiles -------------------
+struct MoveProfile {
+  bool active = false;
+  float start = 0;
+  float target = 0;
+  uint32_t t0 = 0;
+  uint32_t durMs = 0;
+  uint32_t cmdRef = 0;
+  char axis = '?';
+};
+
+// Velocity jog: the motion tick ramps vel toward target at accel and integrates it
+// into the position. A keepalive lapse zeroes both targets, so the axes ramp to rest.
+struct JogAxis {
+  bool active = false;
+  float vel = 0;             // deg/s, current
+  float target = 0;          // deg/s, commanded
+};
+
+struct JogState {
+  JogAxis x, y;
+  float accel = 400.0f;      // deg/s^2
+  uint16_t keepaliveMs = 300;
+  uint32_t refreshedAt = 0;
+  uint32_t lastTick = 0;
+  bool expired = false;
+  uint32_t ref = 0;          // id of the jog that started the motion
+  PanTiltLink origin = PANTILT_LINK_USB;
+  String subsystem, route;
+};
+
+// Closed-form sweep: position is evaluated from elapsed cycles on every tick, so a
+// pattern holds no queue slots and can run forever. See Sweep Patterns in the .cpp.
+enum SweepShape : uint8_t { SS_SINE = 0, SS_EASE, SS_RASTER, SS_SPIRAL, SS_LISSAJOUS };
+
+struct SweepPattern {
+  bool active = false;
+  SweepShape shape = SS_SINE;
+  bool useX = false, useY = false;
+  float cx = 0, cy = 0;      // centre, deg
+  float ax = 0, ay = 0;      // amplitude, deg
+  uint32_t periodMs = 0;
+  float phase = 0;           // start phase, cycles 0..1
+  float ratio = 2;           // lissajous y:x frequency, spiral turns per cycle
+  uint8_t lines = 5;         // raster rows
+  uint32_t count = 0;        // cycles to run, 0 = endless
+  float leadX = 0, leadY = 0;   // where the lead-in to the start point began
+  uint32_t leadMs = 0;
+  uint32_t t0 = 0;           // lead-in start; cycles start at t0 + leadMs
+  uint32_t ref = 0;
+  PanTiltLink origin = PANTILT_LINK_USB;
+  String subsystem, route;
+};
+
+// Blended queue execution (see Blend Planner in PanTiltModule.cpp).
+struct BlendSeg {
+  bool active = false;
+  float x0 = 0, y0 = 0;
+  float ux = 0, uy = 0;     // unit direction
+  float len = 0;            // degrees
+  float vEntry = 0, vPeak = 0, vExit = 0;
+  float tAcc = 0, tCruise = 0, tDec = 0;   // seconds
+  uint32_t holdMs = 0;      // zero-length steps
+  uint32_t t0 = 0;
+  uint32_t totalMs = 0;
+};
+
+struct BlendPlanSeg {
+  float len;
+  float ux, uy;
+  float vNom;
+};
+
+// Motion arguments after parsing; shared by the JSON path and compiled favorites.
+enum MotionKind : uint8_t { MK_SET=0, MK_ADJUST=1, MK_CENTER=2 };
+
+struct MotionArgs {
+  MotionKind kind = MK_SET;
+  bool useX = false;
+  bool useY = false;
+  bool hasX = false;
+  bool hasY = false;
+  float x = 0;
+  float y = 0;
+  bool hasDur = false;
+  float durSec = -1.0f;
+  bool hasSpeed = false;
+  float speed = -1.0f;
+};
+
+// ------------------- Queue -------------------
+// Q_BLEND enqueues like Q_ON, but runs the queue through the lookahead planner so
+// consecutive steps flow through their waypoints instead of stopping at each one.
+enum QueueMode : uint8_t { Q_OFF=0, Q_ON=1, Q_STEP=2, Q_BLEND=3 };
+
+struct QueueItem {
+  bool used = false;
+  uint32_t id = 0;
+
+  String subsystem;
+  String route;
+
+  PanTiltLink mirrorToBle = PANTILT_LINK_USB;
+
+  const char* kind = "";   // always a string literal
+
+  bool useX = false;
+  bool useY = false;
+  bool barrier = false;   // sync step: waits for both lanes, moves nothing
+
+  float tx = 0;
+  float ty = 0;
+  uint32_t dx = 0;
+  uint32_t dy = 0;
+
+  uint32_t expectedEnd = 0;
+
+  bool timed = false;     // came from an "at" command; started reports lateness
+  uint32_t dueUs = 0;     // its due time, micros()
+};
+
+// Lanes: in single-lane mode every step runs on lane 0 (one step at a time, both axes).
+// In axis mode X-only steps run on lane 0 and Y-only steps on lane 1 concurrently;
+// xy steps and sync barriers still claim both axes.
+enum QueueLanes : uint8_t { QL_SINGLE=0, QL_AXIS=1 };
+
+struct QueueLane {
+  bool active = false;
+  QueueItem cur;
+  bool xDone = true;
+  bool yDone = true;
+  uint32_t startedAt = 0;
+};
+
+// ------------------- Persistence -------------------
+struct PersistStats {
+  uint32_t writes = 0;      // NVS keys written or removed
+  uint32_t skipped = 0;     // dirty cfg blob identical to flash, not rewritten
+  uint32_t commits = 0;     // completed persist passes (manual + autosave)
+  uint32_t autosaves = 0;
+  uint32_t failures = 0;
+};
+
+struct PersistedConfig {
+  uint32_t magic;
+  uint16_t version;
+  uint16_t autosaveMs;  // 0 = off (was reserved, so older blobs load as off)
+  float defaultSpeed;
+  uint8_t invX;
+  uint8_t invY;
+  uint8_t posValidMask; // 5 bits
+  uint8_t reserved2;
+  float posX[POS_FAV_SLOTS];
+  float posY[POS_FAV_SLOTS];
+  uint32_t crc32;
+};
+
+// Camera projection for "look" (NVS key "cam", its own blob so cfg stays compatible).
+struct CameraModel {
+  uint8_t version;
+  uint8_t reserved[3];
+  float hfov, vfov;              // full field of view, degrees
+  float panOffset, tiltOffset;   // optical axis minus servo angle, degrees
+  uint32_t crc32;
+};
+
+// Where the rig sits in the world for "lookAt" (NVS key "frame"). World axes are
+// Unity-style: x right, y up, z forward, metres; yaw/pitch/roll turn the mount.
+struct RigFrame {
+  uint8_t version;
+  uint8_t reserved[3];
+  float x, y, z;                 // pan axis base, world metres
+  float yaw, pitch, roll;        // mount orientation, degrees
+  float tiltHeight;              // tilt axis above the pan base, metres
+  float camOffset;               // optical axis above the tilt axis, metres
+  uint32_t crc32;
+};
+
+// Soft limits and keep-out polygons in (pan, tilt) degrees (NVS key "limits").
+static const uint8_t ZONE_MAX = 4;
+static const uint8_t ZONE_VERTS = 8;
+static const uint8_t ZONE_GRID_DEG = 2;                        // bitmap cell size
+static const uint8_t ZONE_GRID_N = 180 / ZONE_GRID_DEG;        // cells per axis over -90..90
+static const uint16_t ZONE_GRID_BYTES = PanTiltBuild::zones ? (ZONE_GRID_N * ZONE_GRID_N + 7) / 8 : 1;
+
+struct KeepOutZone {
+  uint8_t n;                     // vertices, 0 = unused slot
+  uint8_t reserved[3];
+  float x[ZONE_VERTS], y[ZONE_VERTS];
+};
+
+struct LimitConfig {
+  uint8_t version;
+  uint8_t reserved[3];
+  float minX, maxX, minY, maxY;
+  KeepOutZone zones[ZONE_MAX];
+  uint32_t crc32;
+};
+
+// ------------------- Favorites / Store -------------------
+struct FavCode {
+  uint8_t* blob = nullptr;   // header + ops, malloc'd
+  uint16_t len = 0;
+};
+
+struct StoreCacheEntry {
+  bool used = false;
+  uint8_t kind = 0;
+  uint32_t hash = 0;
+  uint32_t lastUse = 0;
+  char name[STORE_NAME_MAX + 1] = {0};
+  float x = 0, y = 0;   // presets
+  float z = 0;          // world targets (x, y, z in metres)
+  FavCode code;         // macros
+};
+
+struct StoreStats {
+  uint32_t hits = 0;
+  uint32_t misses = 0;
+};
+
+// ------------------- Macro VM -------------------
+struct MacroLoop {
+  uint16_t bodyPc = 0;
+  uint16_t remaining = 0;
+};
+
+struct MacroVm {
+  bool active = false;
+  uint8_t slot = 0;          // favorite index, or storeMacroSlot() for named macros
+  uint32_t id = 0;           // favRun id, used for replies
+  String subsystem;
+  String route;
+  PanTiltLink mirror = PANTILT_LINK_USB;
+
+  uint16_t pc = 0;           // byte offset into the favorite blob
+  uint32_t waitUntil = 0;
+  bool waiting = false;
+  uint8_t depth = 0;
+  MacroLoop loops[MACRO_LOOP_DEPTH];
+  uint32_t opsRun = 0;
+
+  // Queue mode/lanes at favRun; a macro's queue ops are undone when it ends
+  QueueMode savedMode = Q_STEP;
+  QueueLanes savedLanes = QL_SINGLE;
+  bool queueChanged = false;
+};
+
+enum MacroOpResult : uint8_t { MR_NEXT=0, MR_YIELD, MR_END, MR_BAD };
+
+// ------------------- Telemetry -------------------
+// Quantized so float noise never counts as a change.
+struct TelemetrySample {
+  int32_t x = 0, y = 0;      // 0.01 deg
+  int32_t vx = 0, vy = 0;    // 0.1 deg/s
+  uint8_t moving = 0;        // bit0 x, bit1 y
+  uint8_t queue = 0;
+  uint8_t macros = 0;
+};
+
+struct TelemetryStream {
+  bool active = false;
+  uint16_t periodMs = 0;
+  uint8_t keyEvery = 0;      // samples between keyframes
+  uint8_t sinceKey = 0;
+  bool needKey = true;
+  uint32_t nextMs = 0;
+  uint32_t seq = 0;
+  PanTiltLink origin = PANTILT_LINK_USB;
+  float lastX = 0, lastY = 0;   // previous tick, for velocity
+  uint32_t lastT = 0;
+  TelemetrySample sent;         // last sample the host has seen
+};
+
+// ------------------- Target Selection -------------------
+static const uint8_t TARGET_MAX = 8;   // candidate boxes per "targets" frame
+
+struct TargetBox {
+  float u = 0, v = 0;        // centre, -1..1 from image centre (same axes as look)
+  float w = 0, h = 0;        // size, in the same units
+  float conf = 0;
+};
+
+// The box the rig follows between frames. A challenger has to outscore the locked box
+// by switchMargin, and only once the lock has held lockMs; a lock that drops out of
+// the list coasts (no motion) for lostMs before it is released.
+struct TargetTracker {
+  bool locked = false;
+  uint32_t lockId = 0;          // bumps on every new lock
+  TargetBox box;                // last matched box
+  float seenX = 0, seenY = 0;   // rig pose when box was seen, to predict it forward
+  uint32_t lockedAt = 0, lastSeen = 0;
+  uint16_t lockMs = 400, lostMs = 800;
+  float switchMargin = 0.15f, minConf = 0.3f, deadband = 0.02f;
+  uint32_t frames = 0, switches = 0;
+};
+
+// ------------------- Scheduled Commands -------------------
+// A line with "at" waits in a timer wheel until its due time, then runs as if it had
+// just arrived from its link. Entries share a bucket when their due ms are congruent
+// mod SCHED_WHEEL and are skipped until their own ms comes round.
+struct SchedEntry {
+  bool used = false;
+  int8_t next = -1;
+  uint32_t dueMs = 0;     // release tick
+  uint32_t dueUs = 0;     // exact due time, micros()
+  PanTiltLink link = PANTILT_LINK_USB;
+  String line;
+};
+
+// ------------------- Replay Cache -------------------
+// Recent (link, client id) -> compact result, so a resent command answers from here
+// instead of running twice. A ring of entries, indexed by an open-addressed table.
+struct ReplayEntry {
+  bool used = false;
+  bool ok = false;
+  PanTiltLink link = PANTILT_LINK_USB;
+  uint32_t id = 0;
+  char text[REPLAY_TEXT];   // ok: msg, else: error code
+};
+
+// ------------------- Rig -------------------
+class PanTiltRig {
+public:
+  explicit PanTiltRig(const PanTiltRigConfig& cfg) : rigCfg(cfg) {}
+
+  void begin();
+  void loop();
+  void handleCommandLine(String line);
+  void handleClientLine(String line);   // a line from a host link: replay cache, then handleCommandLine
+
+  const char* route() const { return rigCfg.route; }
+  void linkClosed(PanTiltLink link);
+  uint8_t queueFree() const { return (uint8_t)(QMAX - qCount); }   // credit for "cr"/"window"
+
+private:
+  friend struct PanTiltRigProbe;   // host benchmarks and tests (host/) reach internals through this
+
+  PanTiltRigConfig rigCfg;
+  Servo s1, s2;
+
+  // ---- runtime state ----
+  float v1 = 0.0f;
+  float v2 = 0.0f;
+
+  bool invX = false;
+  bool invY = false;
+
+  float defaultSpeed = 90.0f;
+
+  bool posFavValid[POS_FAV_SLOTS] = {false,false,false,false,false};
+  float posFavX[POS_FAV_SLOTS] = {0,0,0,0,0};
+  float posFavY[POS_FAV_SLOTS] = {0,0,0,0,0};
+
+  String lastSubsystem = "";
+  String lastRoute = "";
+
+  uint16_t cfgDirty = 0;
+  uint32_t cfgDirtyAt = 0;
+
+  MoveProfile mx, my;
+  JogState jog;
+  SweepPattern pat;
+
+  float blendAccel = 600.0f;     // deg/s^2 along the path
+  float blendCorner = 0.5f;      // junction deviation, degrees
+  uint8_t blendLookahead = 8;
+  BlendSeg blendSeg;
+  float blendCarryV = 0.0f;      // exit speed of the segment that just finished
+  uint32_t blendCarryT = 0;      // its nominal end time (next segment starts here)
+  bool blendCarryValid = false;
+
+  QueueMode qMode = Q_STEP;
+  QueueItem q[QMAX];
+  uint8_t qHead = 0;
+  uint8_t qTail = 0;
+  uint8_t qCount = 0;
+  QueueLanes qLanes = QL_SINGLE;
+  QueueLane qLane[QLANES];
+
+  uint32_t autoId = 0;
+
+  Preferences prefs;
+  PersistStats persistStats;
+  uint32_t persistedCfgCrc = 0;   // crc of the cfg blob currently in flash
+  uint16_t autosaveMs = 0;        // debounce after the last change; 0 = manual persist only
+  bool autosaveActive = false;
+
+  FavCode cmdFav[CMD_FAV_SLOTS];
+  uint8_t favLoadedMask = 0;      // slots read from flash (or overwritten) since boot
+  uint8_t favLegacyBad = 0;       // slots whose legacy "favN" script failed to compile
+
+  CameraModel cam{};
+  float camTanH = 0, camTanV = 0; // tan(fov/2), derived from cam
+  uint32_t persistedCamCrc = 0;
+
+  LimitConfig limits{};
+  uint8_t zoneInside[ZONE_GRID_BYTES];   // cell wholly inside some zone
+  uint8_t zoneEdge[ZONE_GRID_BYTES];     // cell crossed by a zone edge: exact test needed
+  uint32_t persistedLimitsCrc = 0;
+  float safeX = 0, safeY = 0;            // last pose applyOutputs let through
+  bool safeValid = false;
+  bool limitTripped = false;             // set by applyOutputs, reported from loop()
+
+  RigFrame frame{};
+  float frameR[9];                // mount -> world rotation, row-major, derived from frame
+  uint32_t persistedFrameCrc = 0;
+
+  StoreCacheEntry storeCache[STORE_CACHE_SLOTS];
+  StoreStats storeStats;
+  uint32_t storeUseClock = 0;
+
+  MacroVm macroVm[MACRO_VMS];
+  bool macroRunning = false;      // true only while a VM op executes
+
+  TelemetryStream telem;
+
+  SchedEntry sched[SCHED_MAX];
+  int8_t schedWheel[SCHED_WHEEL];
+  uint32_t schedCursor = 0;       // last ms tick processed
+  uint8_t schedCount = 0;
+  bool schedReleasing = false;    // handleCommandLine is running a released line
+  uint32_t schedDueUs = 0;        // ...and this was its due time
+
+  ReplayEntry replay[REPLAY_MAX];
+  uint8_t replaySlot[REPLAY_SLOTS];   // index into replay[], 0xFF = empty
+  uint8_t replayNext = 0;             // oldest entry, overwritten next
+  TargetTracker track;
+
+  // ---- outputs / replies ----
+  void markDirty(uint16_t bits);
+  void applyOutputs();
+  void toggleInvertX();
+  void toggleInvertY();
+  void sendState(const char* eventName, uint32_t ref, const String& subsystem, const String& route, PanTiltLink mirror, ReplyKind rk = RK_STATE);
+
+  // ---- queue ----
+  bool qAnyActive();
+  QueueLane* laneForAxis(char axis);
+  void qDeactivateLanes();
+  bool qIsFull();
+  bool qIsEmpty();
+  bool qEnqueue(const QueueItem& it);
+  bool qDequeue(QueueItem& out);
+  void qRemoveAt(uint8_t i);
+  void qClearAll();
+
+  // ---- motion ----
+  void stopX();
+  void stopY();
+  void stopAllMotion();
+  void abortQueueAndMotion();
+  void startMoveX(float target, uint32_t durMs, uint32_t ref);
+  void startMoveY(float target, uint32_t durMs, uint32_t ref);
+  void startStepAxes(const QueueItem& it);
+  void executeStep(const QueueItem& it);
+
+  // ---- blend planner ----
+  void stopBlend();
+  float junctionSpeed(const BlendPlanSeg& a, const BlendPlanSeg& b);
+  float planBlendExit(const QueueItem& it, float px, float py, float vEntry, BlendPlanSeg& first);
+  void startBlendSegment(const QueueItem& it);
+  bool updateBlend(uint32_t now);
+
+  // ---- parsing ----
+  bool computeDurations(bool useX, bool useY, float tx, float ty, bool hasDur, float durSec, bool hasSpeed, float sp, uint32_t& dx, uint32_t& dy);
+  bool buildStepFromArgs(uint32_t id, const String& subsystem, const String& route, const MotionArgs& a, QueueItem& it, const char*& errCode, const char*& errMsg);
+  QueueItem buildStepFromCommand(uint32_t id, const String& subsystem, const String& route, const String& cmd, const String& axis, const String& line, bool& ok, const char*& errCode, const char*& errMsg);
+
+  // ---- persistence ----
+  void applyDefaults();
+  PersistedConfig makePersistedConfig();
+  bool loadFavoriteSlot(int i);
+  bool loadConfigFromFlash();
+  void markFavLoaded(int i);
+  void ensureFavLoaded(int i);
+  void ensureAllFavLoaded();
+  void favPrefetchTick();
+  bool persistNextKey();
+  bool persistToFlash(String& why);
+  void autosaveTick();
+  bool factoryResetFlash(String& why);
+
+  // ---- preset/macro store ----
+  uint16_t storeCount();
+  uint8_t storeReadPage(uint16_t page, uint16_t count);
+  bool storeWritePage(uint16_t page, uint8_t n);
+  int storeIndexFind(uint8_t kind, uint32_t hash, uint16_t count);
+  int storeCacheFind(uint8_t kind, uint32_t hash);
+  void storeCacheDrop(int i);
+  int storeCacheVictim();
+  void storeClearCache();
+  bool storePut(uint8_t kind, const String& name, const uint8_t* data, uint16_t len, const char*& errCode, const char*& errMsg);
+  int storeGet(uint8_t kind, const String& name, const char*& errCode, const char*& errMsg);
+  bool storeDelete(uint8_t kind, const String& name, const char*& errCode, const char*& errMsg);
+  void sendStoreListPage(uint32_t id, const String& subsystem, const String& route, PanTiltLink mirror, uint8_t kind, uint16_t page);
+  bool storeFactoryReset();
+
+  // ---- macro runner ----
+  uint8_t macroActiveCount();
+  bool macroSlotRunning(int idx);
+  const FavCode& macroCode(int slot);
+  bool shouldEnqueue(QueueMode mode, bool hasQ, bool qVal);
+  bool buildPositionStep(uint32_t id, const String& subsystem, const String& route, const char* kind, float tx, float ty, bool useX, bool useY, bool hasDur, float durSec, bool hasSpeed, float sp, QueueItem& it);
+  bool buildRecallStep(uint32_t id, const String& subsystem, const String& route, int idx, bool useX, bool useY, bool hasDur, float durSec, bool hasSpeed, float sp, QueueItem& it);
+  bool dispatchStep(const QueueItem& it, bool enqueue);
+  bool motionIdle();
+  MacroOpResult macroExecOp(MacroVm& vm, const FavCode& fc);
+  void macroRelease(MacroVm& vm);
+  void macroFinish(MacroVm& vm, const char* msg);
+  uint8_t macroStop(int slot, const char* msg);
+  bool macroStart(uint32_t id, const String& subsystem, const String& route, PanTiltLink mirror, int slot);
+  void macroTick();
+
+  // ---- scheduler ----
+  void startLane(QueueLane& ln, const QueueItem& it);
+  void maybeStartNextQueuedStep();
+  void finishAxisMove(char axis, uint32_t ref);
+  void updateMotion();
+  void updateJog(uint32_t now);
+  void jogTakeAxis(char axis);
+  void stopPattern();
+  void updatePattern(uint32_t now);
+
+  // ---- camera projection ----
+  void cameraDefaults();
+  void cameraDerive();
+  bool loadCamera();
+  bool persistCamera();
+  bool persistBlobKey(const char* key, uint16_t bit, const void* data, size_t n, uint32_t crc, uint32_t& persistedCrc);
+
+  // ---- limits / keep-out zones ----
+  void limitsDefaults();
+  void limitsDerive();
+  bool loadLimits();
+  bool persistLimits();
+  bool poseAllowed(float x, float y);
+  bool clipPath(float x0, float y0, float& x1, float& y1, uint32_t& dx, uint32_t& dy);
+  bool refuseTargetInZone(const QueueItem& it, bool queued);
+  void limitTripTick();
+
+  // ---- world targeting ----
+  void frameDefaults();
+  void frameDerive();
+  bool loadFrame();
+  bool persistFrame();
+  bool solveLookAt(float wx, float wy, float wz, float& pan, float& tilt);
+
+  // ---- target selection ----
+  int8_t selectTarget(const TargetBox* boxes, uint8_t n, uint32_t now, bool& switched);
+
+  // ---- scheduled commands ----
+  void schedInit();
+  bool schedAdd(const String& line, PanTiltLink link, uint64_t dueUs);
+  void schedClear();
+  void schedTick();
+
+  // ---- replay cache ----
+  void replayInit();
+  const ReplayEntry* replayFind(PanTiltLink link, uint32_t id) const;
+  void replayInsert(PanTiltLink link, uint32_t id, bool ok, const char* text);
+  void replayErase(uint8_t idx);
+  void replayDropLink(PanTiltLink link);
+
+  // ---- telemetry ----
+  void telemetryStart(uint16_t hz, uint8_t keyEvery, PanTiltLink origin);
+  void telemetrySnapshot(TelemetrySample& s, uint32_t now);
+  void telemetryTick(uint32_t now);
+};
@@ -35,6 +35,18 @@ bool USBAdapter::floodAllowed_() {
   return true;
 }
 
+size_t USBAdapter::rxFree() const {
+  if (!enabled_ || !io_) return 0;
+  int avail = io_->available();
+  size_t used = (avail > 0 ? (size_t)avail : 0) + lineBuf_.length();
+  return used >= cfg_.rx_buffer_len ? 0 : cfg_.rx_buffer_len - used;
+}
+
+uint32_t USBAdapter::linesLeft() const {
+  if (millis() - windowStartMs_ >= 1000) return cfg_.flood_max_fps;
+  return framesThisWindow_ >= cfg_.flood_max_fps ? 0 : cfg_.flood_max_fps - framesThisWindow_;
+}
+
 bool USBAdapter::sendFrame(const uint8_t* data, size_t len) {
   if (!enabled_ || !io_) return false;
   // For USB serial this is typically fine; keep payload reasonable.
@@ -20,6 +20,7 @@ struct UsbConfig {
   uint32_t flood_max_fps = 60;
   bool require_newline = true;
   bool echo = false;     // useful for consoles
+  size_t rx_buffer_len = 256;  // driver RX buffer the sketch gave the port; sizes rxFree()
 };
 
 class USBAdapter {
@@ -33,6 +34,8 @@ public:
   void setEnabled(bool en);
   bool sendFrame(const uint8_t* data, size_t len);
   UsbStats stats() const { return stats_; }
+  size_t rxFree() const;          // bytes the host may still send before the driver buffer fills
+  uint32_t linesLeft() const;     // lines left in this flood window before drops start
 
 private:
   Stream* io_ = nullptr;
@@ -0,0 +1,205 @@
+// Microbenchmarks for the firmware core, built against the host stand-ins.
+// The module is compiled into this file so its file-static helpers (parser, CRC)
+// can be measured directly; rig internals are reached through PanTiltRigProbe.
+//
+//   pantilt_bench [--quick] [--json] [--filter text]
+//
+// Reports ns/op, heap allocations/op and bytes allocated/op (operator new, so String
+// growth is counted; the target's smaller String SSO makes on-device counts a bit
+// higher). Time is virtual: motion benches advance the clock 1 ms per op.
+#include "../../PanTiltModule.cpp"
+
+#include <chrono>
+#include <cstring>
+#include <vector>
+
+struct PanTiltRigProbe {
+  static PanTiltRig& rig() { return *rigs[0]; }
+  static void updateMotion(PanTiltRig& r) { r.updateMotion(); }
+  static bool moving(PanTiltRig& r) { return !r.motionIdle(); }
+  static bool enqueue(PanTiltRig& r, const QueueItem& it) { return r.qEnqueue(it); }
+  static bool dequeue(PanTiltRig& r, QueueItem& it) { return r.qDequeue(it); }
+  static uint8_t queued(PanTiltRig& r) { return r.qCount; }
+  static void buildStep(PanTiltRig& r, QueueItem& it) { r.buildPositionStep(7, "usb", "", "set", 20, 10, true, true, true, 1.0f, false, 0, it); }
+  static void sendState(PanTiltRig& r) { r.sendState(nullptr, 0, "usb", "", PANTILT_LINK_USB, RK_DATA); }
+};
+
+// ------------------- Runner -------------------
+static uint64_t g_outBytes = 0;
+static void nullOut(PanTiltDest, const String& line, int) { g_outBytes += line.length() + 1; }
+
+struct BenchResult {
+  const char* name;
+  double nsPerOp;
+  double allocsPerOp;
+  double bytesPerOp;
+  double outPerOp;
+  uint64_t ops;
+};
+
+static std::vector<BenchResult> g_results;
+static double g_targetSec = 0.25;
+static const char* g_filter = nullptr;
+
+template <typename Op>
+static void bench(const char* name, Op op) {
+  if (g_filter && !strstr(name, g_filter)) return;
+  typedef std::chrono::steady_clock Clock;
+  for (int i=0;i<64;i++) op();   // warm caches and lazy state
+
+  // Grow the batch until it runs long enough to time, then keep that batch
+  uint64_t n = 64;
+  while (true) {
+    HostAllocStats a0 = hostAllocStats();
+    uint64_t out0 = g_outBytes;
+    Clock::time_point t0 = Clock::now();
+    for (uint64_t i=0;i<n;i++) op();
+    double sec = std::chrono::duration<double>(Clock::now() - t0).count();
+    if (sec >= g_targetSec || n >= (1ull << 32)) {
+      HostAllocStats a1 = hostAllocStats();
+      g_results.push_back({ name, sec * 1e9 / (double)n,
+                            (double)(a1.allocs - a0.allocs) / (double)n,
+                            (double)(a1.bytes - a0.bytes) / (double)n,
+                            (double)(g_outBytes - out0) / (double)n, n });
+      return;
+    }
+    n = sec < g_targetSec / 16 ? n * 8 : n * 2;
+  }
+}
+
+// ------------------- Benches -------------------
+static const String SET_LINE = "{\"cmd\":\"set\",\"axis\":\"xy\",\"x\":12.5,\"y\":-4,\"dur\":0.4,\"q\":false,\"id\":42,\"route\":\"\"}";
+static volatile float g_sinkF;
+static volatile int g_sinkI;
+
+static void benchParse() {
+  String s;
+  float f;
+  int i;
+  bool b;
+  bench("parse.findKey", [&] { g_sinkI = findKey(SET_LINE, "dur", i) ? i : -1; });
+  bench("parse.getStringField", [&] { g_sinkI = getStringField(SET_LINE, "axis", s) ? (int)s.length() : -1; });
+  bench("parse.getNumberField", [&] { g_sinkF = getNumberField(SET_LINE, "x", f) ? f : 0; });
+  bench("parse.getIntField", [&] { g_sinkI = getIntField(SET_LINE, "id", i) ? i : 0; });
+  bench("parse.getBoolField", [&] { g_sinkI = getBoolField(SET_LINE, "q", b) ? b : 0; });
+  bench("parse.setLine", [&] {   // the fields a set command reads
+    String cmd, axis;
+    float x = 0, y = 0, dur = 0;
+    int id = 0;
+    bool q = false;
+    getStringField(SET_LINE, "cmd", cmd);
+    getStringField(SET_LINE, "axis", axis);
+    getNumberField(SET_LINE, "x", x);
+    getNumberField(SET_LINE, "y", y);
+    getNumberField(SET_LINE, "dur", dur);
+    getIntField(SET_LINE, "id", id);
+    getBoolField(SET_LINE, "q", q);
+    g_sinkF = x + y + dur + (float)id + (q ? 1.0f : 0.0f) + (float)cmd.length() + (float)axis.length();
+  });
+}
+
+static void benchDispatch() {
+  PanTiltRig& r = PanTiltRigProbe::rig();
+  const String speed = "{\"cmd\":\"speed\",\"value\":120}";
+  const String unknown = "{\"cmd\":\"nosuchcommand\"}";
+  const String sets[2] = {
+    "{\"cmd\":\"set\",\"axis\":\"x\",\"value\":10,\"dur\":0.5}",
+    "{\"cmd\":\"set\",\"axis\":\"x\",\"value\":-10,\"dur\":0.5}",
+  };
+  uint32_t k = 0;
+  bench("dispatch.speed", [&] { r.handleCommandLine(speed); });
+  bench("dispatch.unknown", [&] { r.handleCommandLine(unknown); });   // walks the whole chain
+  bench("dispatch.set", [&] { r.handleCommandLine(sets[k++ & 1]); });
+  bench("dispatch.client.set", [&] { PanTilt_handleLine(sets[k++ & 1], false); });
+  r.handleCommandLine("{\"cmd\":\"stopAll\",\"flush\":true}");
+}
+
+static void benchReplies() {
+  PanTiltRig& r = PanTiltRigProbe::rig();
+  bench("reply.sendState", [&] { PanTiltRigProbe::sendState(r); });
+
+  r.handleCommandLine("{\"cmd\":\"queue\",\"mode\":\"step\"}");
+  for (int i=0;i<10;i++) {
+    String l = "{\"cmd\":\"qAdd\",\"cmd2\":\"set\",\"axis\":\"x\",\"value\":";
+    l += String(i * 5);
+    l += ",\"dur\":3000}";
+    r.handleCommandLine(l);
+  }
+  const String qlist = "{\"cmd\":\"qList\"}";
+  bench("reply.qList10", [&] { r.handleCommandLine(qlist); });
+  r.handleCommandLine("{\"cmd\":\"stopAll\",\"flush\":true}");
+}
+
+static void benchMotion() {
+  PanTiltRig& r = PanTiltRigProbe::rig();
+  const String slow = "{\"cmd\":\"set\",\"axis\":\"xy\",\"x\":80,\"y\":-60,\"dur\":3000}";
+  const String back = "{\"cmd\":\"set\",\"axis\":\"xy\",\"x\":-80,\"y\":60,\"dur\":3000}";
+  uint32_t k = 0;
+
+  bench("motion.tickIdle", [&] { hostClockAdvanceUs(1000); PanTiltRigProbe::updateMotion(r); });
+  r.handleCommandLine(slow);
+  bench("motion.tickMoving", [&] {
+    hostClockAdvanceUs(1000);
+    PanTiltRigProbe::updateMotion(r);
+    if (!PanTiltRigProbe::moving(r)) r.handleCommandLine((k++ & 1) ? slow : back);
+  });
+  r.handleCommandLine("{\"cmd\":\"stopAll\",\"flush\":true}");
+  bench("loop.idle", [&] { hostClockAdvanceUs(1000); PanTilt_loop(); });
+}
+
+static void benchQueue() {
+  PanTiltRig& r = PanTiltRigProbe::rig();
+  r.handleCommandLine("{\"cmd\":\"stopAll\",\"flush\":true}");
+  QueueItem it;
+  PanTiltRigProbe::buildStep(r, it);
+  QueueItem out;
+  bench("queue.enqueueDequeue", [&] {
+    PanTiltRigProbe::enqueue(r, it);
+    PanTiltRigProbe::dequeue(r, out);
+  });
+  g_sinkI = PanTiltRigProbe::queued(r);
+}
+
+static void benchCrc() {
+  static uint8_t buf[256];
+  for (unsigned i=0;i<sizeof(buf);i++) buf[i] = (uint8_t)(i * 31 + 7);
+  bench("crc32.256B", [&] { g_sinkI = (int)crc32_update(0, buf, sizeof(buf)); });
+}
+
+// ------------------- Main -------------------
+int main(int argc, char** argv) {
+  bool json = false;
+  for (int i=1;i<argc;i++) {
+    if (!strcmp(argv[i], "--quick")) g_targetSec = 0.01;
+    else if (!strcmp(argv[i], "--json")) json = true;
+    else if (!strcmp(argv[i], "--filter") && i + 1 < argc) g_filter = argv[++i];
+    else { fprintf(stderr, "usage: %s [--quick] [--json] [--filter text]\n", argv[0]); return 2; }
+  }
+
+  hostClockSetUs(1000000);
+  PanTilt_setOutput(nullOut);
+  PanTilt_begin(3, 4);
+
+  benchParse();
+  benchDispatch();
+  benchReplies();
+  benchMotion();
+  benchQueue();
+  benchCrc();
+
+  if (json) {
+    printf("[\n");
+    for (size_t i=0;i<g_results.size();i++) {
+      const BenchResult& b = g_results[i];
+      printf("  {\"name\":\"%s\",\"nsPerOp\":%.2f,\"allocsPerOp\":%.3f,\"bytesPerOp\":%.1f,\"outBytesPerOp\":%.1f,\"ops\":%llu}%s\n",
+             b.name, b.nsPerOp, b.allocsPerOp, b.bytesPerOp, b.outPerOp, (unsigned long long)b.ops,
+             i + 1 < g_results.size() ? "," : "");
+    }
+    printf("]\n");
+  } else {
+    printf("%-24s %12s %12s %12s %12s\n", "bench", "ns/op", "allocs/op", "B alloc/op", "B out/op");
+    for (const BenchResult& b : g_results)
+      printf("%-24s %12.1f %12.2f %12.1f %12.1f\n", b.name, b.nsPerOp, b.allocsPerOp, b.bytesPerOp, b.outPerOp);
+  }
+  return g_results.empty() ? 1 : 0;
+}
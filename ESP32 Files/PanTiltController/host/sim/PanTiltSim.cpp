@@ -0,0 +1,382 @@
+// Device simulator: runs the sketch (USBAdapter + BLEAdapterUART + PanTiltModule) on
+// the host in real time. USB is a pseudo-terminal, so hosts and scripts open it like the
+// board's serial port; BLE centrals are clients of a local socket whose writes are cut
+// into ATT-sized packets. Servo pulses drive a servo model whose angle is logged.
+//
+//   pantilt_sim [--link PATH] [--ble PATH] [--prefs FILE] [--log FILE] [--log-ms N]
+//               [--servo-us MIN,MAX] [--range DEG] [--rate DEG_PER_S] [--tau MS]
+//               [--deadband US] [--ble-mtu N] [--ble-interval MS] [--ble-per-event N]
+//               [--duration S] [--quiet]
+//
+// The first line on stdout is the serial device path. On exit a summary goes to stderr:
+// servo pulse counts and command-to-motion latency (input line delivered to the firmware
+// until a resting servo has moved 0.1 deg).
+#include <Arduino.h>
+#include <ESP32Servo.h>
+#include <Preferences.h>
+#include "ServoModel.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <csignal>
+#include <fcntl.h>
+#include <map>
+#include <poll.h>
+#include <string>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <termios.h>
+#include <unistd.h>
+#include <vector>
+
+void setup();
+void loop();
+
+// ------------------- Options -------------------
+struct SimOptions {
+  const char* link = nullptr;      // symlink to the pty slave
+  const char* blePath = nullptr;   // unix socket for BLE centrals
+  const char* prefsPath = nullptr;
+  const char* logPath = nullptr;
+  uint32_t logMs = 10;
+  ServoParams servo;
+  size_t bleMtu = 20;              // ATT payload per write (default MTU 23)
+  uint32_t bleIntervalMs = 15;     // connection interval; 0 delivers writes at once
+  uint32_t blePerEvent = 4;        // writes per connection event
+  double durationSec = 0;          // 0: until SIGINT/SIGTERM
+  bool quiet = false;
+};
+
+static SimOptions g_opt;
+static volatile sig_atomic_t g_stop = 0;
+static void onSignal(int) { g_stop = 1; }
+
+static void usage(const char* argv0) {
+  fprintf(stderr,
+          "usage: %s [--link PATH] [--ble PATH] [--prefs FILE] [--log FILE] [--log-ms N]\n"
+          "          [--servo-us MIN,MAX] [--range DEG] [--rate DEG_PER_S] [--tau MS] [--deadband US]\n"
+          "          [--ble-mtu N] [--ble-interval MS] [--ble-per-event N] [--duration S] [--quiet]\n",
+          argv0);
+}
+
+static bool parseOptions(int argc, char** argv) {
+  for (int i=1;i<argc;i++) {
+    const char* a = argv[i];
+    if (!strcmp(a, "--quiet")) { g_opt.quiet = true; continue; }
+    if (i + 1 >= argc) return false;
+    const char* v = argv[++i];
+    if (!strcmp(a, "--link")) g_opt.link = v;
+    else if (!strcmp(a, "--ble")) g_opt.blePath = v;
+    else if (!strcmp(a, "--prefs")) g_opt.prefsPath = v;
+    else if (!strcmp(a, "--log")) g_opt.logPath = v;
+    else if (!strcmp(a, "--log-ms")) g_opt.logMs = (uint32_t)std::max(1L, atol(v));
+    else if (!strcmp(a, "--servo-us")) {
+      if (sscanf(v, "%d,%d", &g_opt.servo.usMin, &g_opt.servo.usMax) != 2 || g_opt.servo.usMax <= g_opt.servo.usMin) return false;
+    }
+    else if (!strcmp(a, "--range")) g_opt.servo.rangeDeg = strtof(v, nullptr);
+    else if (!strcmp(a, "--rate")) g_opt.servo.rateDegPerSec = strtof(v, nullptr);
+    else if (!strcmp(a, "--tau")) g_opt.servo.tauMs = strtof(v, nullptr);
+    else if (!strcmp(a, "--deadband")) g_opt.servo.deadbandUs = atoi(v);
+    else if (!strcmp(a, "--ble-mtu")) g_opt.bleMtu = (size_t)std::max(1L, atol(v));
+    else if (!strcmp(a, "--ble-interval")) g_opt.bleIntervalMs = (uint32_t)std::max(0L, atol(v));
+    else if (!strcmp(a, "--ble-per-event")) g_opt.blePerEvent = (uint32_t)std::max(1L, atol(v));
+    else if (!strcmp(a, "--duration")) g_opt.durationSec = strtod(v, nullptr);
+    else return false;
+  }
+  return g_opt.servo.rateDegPerSec > 0;
+}
+
+#define SIM_LOG(...) do { if (!g_opt.quiet) fprintf(stderr, "pantilt_sim: " __VA_ARGS__); } while (0)
+
+// ------------------- Latency -------------------
+// An input line arms a measurement; the first resting servo to move after it closes it.
+static uint64_t g_lastLineUs = 0;
+static uint64_t g_measuredLineUs = 0;
+static std::vector<uint32_t> g_latencyUs;
+
+static void noteInput(const uint8_t* d, size_t n) {
+  if (memchr(d, '\n', n)) g_lastLineUs = hostClockUs();
+}
+
+// ------------------- Servos -------------------
+struct SimServo {
+  ServoModel model;
+  bool moving = false;
+  uint64_t restSinceUs = 0;
+  float restDeg = 0;
+  bool restLogged = false;
+};
+
+static std::map<int, SimServo> g_servos;   // by pin
+static FILE* g_log = nullptr;
+
+static void onServoWrite(int pin, int us) {
+  SimServo& s = g_servos[pin];
+  if (!s.model.powered()) {
+    s.model.configure(g_opt.servo);
+    s.model.command(us, hostClockUs());
+    s.restSinceUs = hostClockUs();
+    s.restDeg = s.model.angleDeg();
+    return;
+  }
+  s.model.command(us, hostClockUs());
+}
+
+static void stepServos(uint64_t now) {
+  for (auto& kv : g_servos) {
+    SimServo& s = kv.second;
+    s.model.step(now);
+    if (!s.moving) {
+      if (fabsf(s.model.angleDeg() - s.restDeg) < 0.1f) continue;
+      s.moving = true;
+      s.restLogged = false;
+      if (g_lastLineUs > g_measuredLineUs && g_lastLineUs >= s.restSinceUs) {
+        g_latencyUs.push_back((uint32_t)(now - g_lastLineUs));
+        g_measuredLineUs = g_lastLineUs;
+      }
+    } else if (s.model.settled()) {
+      s.moving = false;
+      s.restSinceUs = now;
+      s.restDeg = s.model.angleDeg();
+    }
+  }
+}
+
+// One row per servo per interval while it moves, plus one when it comes to rest
+static void logServos(uint64_t now) {
+  if (!g_log) return;
+  for (auto& kv : g_servos) {
+    SimServo& s = kv.second;
+    if (!s.moving && s.restLogged) continue;
+    fprintf(g_log, "%.3f,%d,%d,%.2f,%.3f,%.1f\n", (double)now / 1000.0, kv.first, s.model.commandUs(),
+            s.model.commandDeg(), s.model.angleDeg(), s.model.velocityDegPerSec());
+    if (!s.moving) s.restLogged = true;
+  }
+}
+
+// ------------------- USB (pty) -------------------
+static int g_ptyMaster = -1;
+static int g_ptySlave = -1;    // held open so the master never sees a hangup between clients
+static uint64_t g_usbTxDropped = 0;
+
+static void ptyWrite(const uint8_t* d, size_t n) {
+  while (n) {
+    ssize_t k = write(g_ptyMaster, d, n);
+    if (k <= 0) { g_usbTxDropped += n; return; }   // nobody reading: drop like an unopened CDC port
+    d += k;
+    n -= (size_t)k;
+  }
+}
+
+static bool openPty() {
+  g_ptyMaster = posix_openpt(O_RDWR | O_NOCTTY);
+  if (g_ptyMaster < 0 || grantpt(g_ptyMaster) || unlockpt(g_ptyMaster)) return false;
+  const char* name = ptsname(g_ptyMaster);
+  if (!name) return false;
+  g_ptySlave = open(name, O_RDWR | O_NOCTTY);
+  if (g_ptySlave < 0) return false;
+
+  // Raw: no echo, no CR/LF translation, so the byte stream matches the CDC port
+  termios t;
+  if (tcgetattr(g_ptySlave, &t)) return false;
+  cfmakeraw(&t);
+  if (tcsetattr(g_ptySlave, TCSANOW, &t)) return false;
+  fcntl(g_ptyMaster, F_SETFL, fcntl(g_ptyMaster, F_GETFL) | O_NONBLOCK);
+
+  if (g_opt.link) {
+    unlink(g_opt.link);
+    if (symlink(name, g_opt.link)) { perror("pantilt_sim: symlink"); return false; }
+  }
+  printf("%s\n", name);
+  fflush(stdout);
+  return true;
+}
+
+static void pollPty(short revents) {
+  if (!(revents & POLLIN)) return;
+  uint8_t buf[512];
+  ssize_t n = read(g_ptyMaster, buf, sizeof(buf));
+  if (n <= 0) return;
+  hostSerialFeed(buf, (size_t)n);
+  noteInput(buf, (size_t)n);
+}
+
+// ------------------- BLE (unix socket) -------------------
+struct SimCentral {
+  int fd = -1;
+  int connId = 0;
+  std::string pending;        // bytes not yet delivered as ATT writes
+  uint64_t nextEventUs = 0;
+  bool drop = false;
+};
+
+static int g_bleListen = -1;
+static std::vector<SimCentral> g_centrals;
+static int g_nextConnId = 0;
+static uint64_t g_bleTxDropped = 0;
+
+static SimCentral* findCentral(int connId) {
+  for (SimCentral& c : g_centrals) if (c.connId == connId && c.fd >= 0) return &c;
+  return nullptr;
+}
+
+static void onBleNotify(int connId, const uint8_t* d, size_t n) {
+  SimCentral* c = findCentral(connId);
+  if (!c) return;
+  ssize_t k = send(c->fd, d, n, MSG_DONTWAIT | MSG_NOSIGNAL);
+  if (k < (ssize_t)n) g_bleTxDropped += n - (k > 0 ? (size_t)k : 0);
+}
+
+static void onBleDrop(int connId) {
+  if (SimCentral* c = findCentral(connId)) c->drop = true;
+}
+
+static bool openBle() {
+  if (!g_opt.blePath) return true;
+  sockaddr_un addr = {};
+  addr.sun_family = AF_UNIX;
+  if (strlen(g_opt.blePath) >= sizeof(addr.sun_path)) return false;
+  strcpy(addr.sun_path, g_opt.blePath);
+  unlink(g_opt.blePath);
+  g_bleListen = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (g_bleListen < 0 || bind(g_bleListen, (sockaddr*)&addr, sizeof(addr)) || listen(g_bleListen, 4)) return false;
+  fcntl(g_bleListen, F_SETFL, fcntl(g_bleListen, F_GETFL) | O_NONBLOCK);
+  hostBleOnNotify(onBleNotify);
+  hostBleOnDrop(onBleDrop);
+  return true;
+}
+
+static void acceptCentral() {
+  int fd = accept(g_bleListen, nullptr, nullptr);
+  if (fd < 0) return;
+  fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+  SimCentral c;
+  c.fd = fd;
+  c.connId = g_nextConnId++ & 0xFFFF;
+  c.nextEventUs = hostClockUs();
+  g_centrals.push_back(c);
+  SIM_LOG("ble central %d connected\n", c.connId);
+  hostBleConnect(c.connId);
+}
+
+static void closeCentral(SimCentral& c) {
+  SIM_LOG("ble central %d disconnected\n", c.connId);
+  close(c.fd);
+  c.fd = -1;
+  hostBleDisconnect(c.connId);
+}
+
+static void readCentral(SimCentral& c, short revents) {
+  if (!(revents & (POLLIN | POLLHUP | POLLERR))) return;
+  char buf[512];
+  ssize_t n = recv(c.fd, buf, sizeof(buf), 0);
+  if (n > 0) c.pending.append(buf, (size_t)n);
+  else if (n == 0 || (errno != EAGAIN && errno != EINTR)) c.drop = true;
+}
+
+// Up to blePerEvent writes of at most bleMtu bytes per connection interval
+static void deliverCentral(SimCentral& c, uint64_t now) {
+  if (c.pending.empty()) return;
+  uint32_t budget = UINT32_MAX;
+  if (g_opt.bleIntervalMs) {
+    if (now < c.nextEventUs) return;
+    c.nextEventUs = now + (uint64_t)g_opt.bleIntervalMs * 1000;
+    budget = g_opt.blePerEvent;
+  }
+  size_t off = 0;
+  while (budget-- && off < c.pending.size()) {
+    size_t n = std::min(g_opt.bleMtu, c.pending.size() - off);
+    const uint8_t* d = (const uint8_t*)c.pending.data() + off;
+    hostBleWrite(c.connId, d, n);
+    noteInput(d, n);
+    off += n;
+  }
+  c.pending.erase(0, off);
+}
+
+// ------------------- Preferences -------------------
+static uint32_t g_prefsSaved = 0;
+
+static void savePrefs() {
+  if (!g_opt.prefsPath || Preferences::writes == g_prefsSaved) return;
+  if (!Preferences::hostSave(g_opt.prefsPath)) perror("pantilt_sim: prefs");
+  g_prefsSaved = Preferences::writes;
+}
+
+// ------------------- Summary -------------------
+static void printSummary() {
+  for (auto& kv : g_servos)
+    fprintf(stderr, "servo pin %d: %u pulses, %u inside deadband, at %.2f deg\n", kv.first,
+            kv.second.model.commands(), kv.second.model.ignored(), kv.second.model.angleDeg());
+  if (g_usbTxDropped || g_bleTxDropped)
+    fprintf(stderr, "tx dropped: usb %llu B, ble %llu B\n", (unsigned long long)g_usbTxDropped,
+            (unsigned long long)g_bleTxDropped);
+  if (g_latencyUs.empty()) return;
+  std::vector<uint32_t> v = g_latencyUs;
+  std::sort(v.begin(), v.end());
+  auto at = [&](double q) { return (double)v[(size_t)(q * (double)(v.size() - 1))] / 1000.0; };
+  fprintf(stderr, "command-to-motion: n=%zu min %.2f p50 %.2f p95 %.2f max %.2f ms\n", v.size(),
+          at(0), at(0.5), at(0.95), at(1));
+}
+
+// ------------------- Main -------------------
+int main(int argc, char** argv) {
+  if (!parseOptions(argc, argv)) { usage(argv[0]); return 2; }
+  signal(SIGINT, onSignal);
+  signal(SIGTERM, onSignal);
+  signal(SIGPIPE, SIG_IGN);
+
+  if (!openPty()) { perror("pantilt_sim: pty"); return 1; }
+  if (!openBle()) { perror("pantilt_sim: ble socket"); return 1; }
+  if (g_opt.logPath) {
+    g_log = fopen(g_opt.logPath, "w");
+    if (!g_log) { perror("pantilt_sim: log"); return 1; }
+    fprintf(g_log, "t_ms,pin,cmd_us,cmd_deg,angle_deg,vel_dps\n");
+  }
+  if (g_opt.prefsPath && Preferences::hostLoad(g_opt.prefsPath)) SIM_LOG("loaded %s\n", g_opt.prefsPath);
+  g_prefsSaved = Preferences::writes;
+
+  hostClockRealTime(true);
+  hostSerialOnWrite(ptyWrite);
+  Servo::observer = onServoWrite;
+  setup();
+  SIM_LOG("running%s%s\n", g_opt.blePath ? ", ble on " : "", g_opt.blePath ? g_opt.blePath : "");
+
+  const uint64_t endUs = g_opt.durationSec > 0 ? hostClockUs() + (uint64_t)(g_opt.durationSec * 1e6) : 0;
+  uint64_t nextLogUs = hostClockUs(), nextSaveUs = hostClockUs();
+  std::vector<pollfd> fds;
+
+  while (!g_stop && (!endUs || hostClockUs() < endUs)) {
+    fds.clear();
+    fds.push_back({ g_ptyMaster, POLLIN, 0 });
+    if (g_bleListen >= 0) fds.push_back({ g_bleListen, POLLIN, 0 });
+    for (SimCentral& c : g_centrals) fds.push_back({ c.fd, POLLIN, 0 });
+    if (poll(fds.data(), fds.size(), 1) < 0 && errno != EINTR) break;
+
+    size_t k = 0;
+    pollPty(fds[k++].revents);
+    if (g_bleListen >= 0 && (fds[k++].revents & POLLIN)) acceptCentral();
+    for (size_t i=0;i<g_centrals.size() && k<fds.size();i++, k++) readCentral(g_centrals[i], fds[k].revents);
+
+    uint64_t now = hostClockUs();
+    for (SimCentral& c : g_centrals) if (c.fd >= 0 && !c.drop) deliverCentral(c, now);
+
+    loop();
+
+    for (SimCentral& c : g_centrals) if (c.fd >= 0 && c.drop) closeCentral(c);
+    g_centrals.erase(std::remove_if(g_centrals.begin(), g_centrals.end(),
+                                    [](const SimCentral& c) { return c.fd < 0; }), g_centrals.end());
+
+    now = hostClockUs();
+    stepServos(now);
+    if (now >= nextLogUs) { logServos(now); nextLogUs = now + (uint64_t)g_opt.logMs * 1000; }
+    if (now >= nextSaveUs) { savePrefs(); nextSaveUs = now + 500000; }
+  }
+
+  savePrefs();
+  if (g_log) fclose(g_log);
+  if (g_opt.link) unlink(g_opt.link);
+  if (g_opt.blePath) unlink(g_opt.blePath);
+  printSummary();
+  return 0;
+}
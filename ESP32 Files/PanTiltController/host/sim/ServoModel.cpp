@@ -0,0 +1,54 @@
+#include "ServoModel.h"
+#include <cmath>
+#include <cstdlib>
+
+static const float SETTLED_DEG = 0.05f;
+static const float SETTLED_DPS = 1.0f;
+
+float ServoModel::usToDeg(int us) const {
+  float span = (float)(p_.usMax - p_.usMin);
+  if (span <= 0) return 0;
+  return (float)(us - p_.usMin) * p_.rangeDeg / span;
+}
+
+bool ServoModel::command(int us, uint64_t nowUs) {
+  if (!powered_) {
+    // First pulse after power-up: the horn is assumed to be there already
+    powered_ = true;
+    heldUs_ = us;
+    angle_ = usToDeg(us);
+    vel_ = 0;
+    lastUs_ = nowUs;
+    commands_++;
+    return true;
+  }
+  step(nowUs);
+  if (abs(us - heldUs_) <= p_.deadbandUs) { ignored_++; return false; }
+  heldUs_ = us;
+  commands_++;
+  return true;
+}
+
+void ServoModel::step(uint64_t nowUs) {
+  if (!powered_ || nowUs <= lastUs_) return;
+  float target = usToDeg(heldUs_);
+  while (lastUs_ < nowUs) {
+    uint64_t dtUs = nowUs - lastUs_;
+    if (dtUs > 1000) dtUs = 1000;
+    float dt = (float)dtUs * 1e-6f;
+
+    float err = target - angle_;
+    float move = p_.tauMs > 0 ? err * (1.0f - expf(-dt * 1000.0f / p_.tauMs)) : err;
+    float maxMove = p_.rateDegPerSec * dt;
+    if (move > maxMove) move = maxMove;
+    else if (move < -maxMove) move = -maxMove;
+
+    angle_ += move;
+    vel_ = move / dt;
+    lastUs_ += dtUs;
+  }
+}
+
+bool ServoModel::settled() const {
+  return fabsf(usToDeg(heldUs_) - angle_) < SETTLED_DEG && fabsf(vel_) < SETTLED_DPS;
+}
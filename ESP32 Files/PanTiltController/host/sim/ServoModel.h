@@ -0,0 +1,43 @@
+#pragma once
+#include <cstdint>
+
+// A hobby servo as the horn sees it: pulses inside the deadband of the held command
+// are ignored, the horn follows the command with a first-order lag and never turns
+// faster than the rate limit.
+struct ServoParams {
+  int usMin = 500;            // pulse at 0 deg
+  int usMax = 2500;           // pulse at rangeDeg
+  float rangeDeg = 180.0f;
+  float rateDegPerSec = 600.0f;   // ~0.10 s/60 deg
+  float tauMs = 25.0f;            // 0: pure rate limit
+  int deadbandUs = 4;
+};
+
+class ServoModel {
+public:
+  void configure(const ServoParams& p) { p_ = p; }
+
+  // A pulse from Servo::writeMicroseconds; returns false if the deadband ate it
+  bool command(int us, uint64_t nowUs);
+  // Advance the horn to nowUs in steps of at most 1 ms
+  void step(uint64_t nowUs);
+
+  bool powered() const { return powered_; }
+  int commandUs() const { return heldUs_; }
+  float commandDeg() const { return usToDeg(heldUs_); }
+  float angleDeg() const { return angle_; }
+  float velocityDegPerSec() const { return vel_; }
+  bool settled() const;
+  uint32_t commands() const { return commands_; }
+  uint32_t ignored() const { return ignored_; }
+
+private:
+  float usToDeg(int us) const;
+
+  ServoParams p_;
+  bool powered_ = false;
+  int heldUs_ = 0;
+  float angle_ = 0, vel_ = 0;
+  uint64_t lastUs_ = 0;
+  uint32_t commands_ = 0, ignored_ = 0;
+};
@@ -0,0 +1,2 @@
+// The sketch exactly as the Arduino IDE builds it; the simulator calls setup()/loop().
+#include "../../PanTiltController.ino"
@@ -0,0 +1,147 @@
+#pragma once
+// Host stand-in for the parts of the Arduino-ESP32 core the firmware uses: String,
+// Print/Stream, Serial, ESP heap queries, critical sections and the clock. Behaviour follows the core
+// closely enough for the module's parsing and formatting; String is backed by
+// std::string, so its small-string buffer is 15 chars here against 11 on target.
+#include <cctype>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+#include <string>
+#include <strings.h>
+
+#include "HostHooks.h"
+
+// FreeRTOS critical sections: host callbacks run on the loop thread, so these are no-ops
+typedef int portMUX_TYPE;
+#define portMUX_INITIALIZER_UNLOCKED 0
+#define portENTER_CRITICAL(mux) ((void)(mux))
+#define portEXIT_CRITICAL(mux) ((void)(mux))
+
+uint32_t millis();
+uint32_t micros();
+void delay(uint32_t ms);
+
+class String {
+public:
+  String() {}
+  String(const char* s) : s_(s ? s : "") {}
+  String(const std::string& s) : s_(s) {}
+  explicit String(char c) : s_(1, c) {}
+  String(int v) : s_(std::to_string(v)) {}
+  String(unsigned v) : s_(std::to_string(v)) {}
+  String(long v) : s_(std::to_string(v)) {}
+  String(unsigned long v) : s_(std::to_string(v)) {}
+  String(float v, unsigned dec = 2) { fmt(v, dec); }
+  String(double v, unsigned dec = 2) { fmt(v, dec); }
+
+  unsigned length() const { return (unsigned)s_.size(); }
+  const char* c_str() const { return s_.c_str(); }
+  bool reserve(unsigned n) { s_.reserve(n); return true; }
+  char operator[](unsigned i) const { return i < s_.size() ? s_[i] : 0; }
+  char& operator[](unsigned i) { return s_[i]; }
+  char charAt(unsigned i) const { return (*this)[i]; }
+  void setCharAt(unsigned i, char c) { if (i < s_.size()) s_[i] = c; }
+
+  String& operator=(const char* s) { s_.assign(s ? s : ""); return *this; }
+  String& operator+=(const String& o) { s_ += o.s_; return *this; }
+  String& operator+=(const char* o) { s_ += o; return *this; }
+  String& operator+=(char c) { s_ += c; return *this; }
+  String& operator+=(int v) { s_ += std::to_string(v); return *this; }
+  String& operator+=(unsigned v) { s_ += std::to_string(v); return *this; }
+  String& operator+=(long v) { s_ += std::to_string(v); return *this; }
+  String& operator+=(unsigned long v) { s_ += std::to_string(v); return *this; }
+  bool concat(const char* p, unsigned n) { s_.append(p, n); return true; }
+
+  bool operator==(const String& o) const { return s_ == o.s_; }
+  bool operator==(const char* o) const { return s_ == o; }
+  bool operator!=(const String& o) const { return s_ != o.s_; }
+  bool operator!=(const char* o) const { return s_ != o; }
+
+  int indexOf(char c, unsigned from = 0) const { auto p = s_.find(c, from); return p == std::string::npos ? -1 : (int)p; }
+  int indexOf(const String& t, unsigned from = 0) const { auto p = s_.find(t.s_, from); return p == std::string::npos ? -1 : (int)p; }
+  int lastIndexOf(char c) const { auto p = s_.rfind(c); return p == std::string::npos ? -1 : (int)p; }
+  String substring(unsigned a) const { return a >= s_.size() ? String() : String(s_.substr(a)); }
+  String substring(unsigned a, unsigned b) const {
+    if (a > b) std::swap(a, b);
+    if (a >= s_.size()) return String();
+    return String(s_.substr(a, std::min<size_t>(b, s_.size()) - a));
+  }
+  bool startsWith(const String& p) const { return s_.compare(0, p.s_.size(), p.s_) == 0; }
+  bool startsWith(const String& p, unsigned off) const { return off <= s_.size() && s_.compare(off, p.s_.size(), p.s_) == 0; }
+  bool endsWith(const String& p) const { return s_.size() >= p.s_.size() && s_.compare(s_.size() - p.s_.size(), p.s_.size(), p.s_) == 0; }
+  void remove(unsigned i) { if (i < s_.size()) s_.erase(i); }
+  void remove(unsigned i, unsigned n) { if (i < s_.size()) s_.erase(i, n); }
+  void replace(const String& a, const String& b) {
+    if (a.s_.empty()) return;
+    size_t p = 0;
+    while ((p = s_.find(a.s_, p)) != std::string::npos) { s_.replace(p, a.s_.size(), b.s_); p += b.s_.size(); }
+  }
+  void trim() {
+    size_t a = 0, b = s_.size();
+    while (a < b && isspace((unsigned char)s_[a])) a++;
+    while (b > a && isspace((unsigned char)s_[b - 1])) b--;
+    if (a || b != s_.size()) s_ = s_.substr(a, b - a);
+  }
+  void toLowerCase() { for (auto& c : s_) c = (char)tolower((unsigned char)c); }
+  void toUpperCase() { for (auto& c : s_) c = (char)toupper((unsigned char)c); }
+  long toInt() const { return strtol(s_.c_str(), nullptr, 10); }
+  float toFloat() const { return strtof(s_.c_str(), nullptr); }
+  bool equalsIgnoreCase(const String& o) const { return strcasecmp(s_.c_str(), o.s_.c_str()) == 0; }
+
+  friend String operator+(const String& a, const String& b) { String r(a); r += b; return r; }
+  friend String operator+(const String& a, const char* b) { String r(a); r += b; return r; }
+  friend String operator+(const char* a, const String& b) { String r(a); r += b; return r; }
+
+private:
+  void fmt(double v, unsigned dec) { char buf[48]; snprintf(buf, sizeof(buf), "%.*f", (int)dec, v); s_ = buf; }
+  std::string s_;
+};
+
+class Print {
+public:
+  virtual ~Print() {}
+  virtual size_t write(uint8_t b) = 0;
+  virtual size_t write(const uint8_t* d, size_t n) { size_t k = 0; while (n--) k += write(*d++); return k; }
+  size_t print(const String& s) { return write((const uint8_t*)s.c_str(), s.length()); }
+  size_t print(const char* s) { return write((const uint8_t*)s, strlen(s)); }
+  size_t print(char c) { return write((uint8_t)c); }
+  size_t println(const String& s) { size_t n = print(s); return n + print('\n'); }
+  size_t println(const char* s) { size_t n = print(s); return n + print('\n'); }
+  virtual void flush() {}
+};
+
+class Stream : public Print {
+public:
+  virtual int available() = 0;
+  virtual int read() = 0;
+};
+
+// Serial: reads come from hostSerialFeed(), writes go to the hostSerialOnWrite() sink
+// (stdout by default).
+class HardwareSerial : public Stream {
+public:
+  void begin(uint32_t baud) { (void)baud; }
+  size_t setRxBufferSize(size_t n) { rxCap_ = n; return n; }
+  size_t rxBufferSize() const { return rxCap_; }
+  int available() override;
+  int read() override;
+  size_t write(uint8_t b) override;
+  size_t write(const uint8_t* d, size_t n) override;
+private:
+  size_t rxCap_ = 256;
+};
+extern HardwareSerial Serial;
+
+// Heap queries report the host allocator as seen through the operator new counters.
+class EspClass {
+public:
+  uint32_t getFreeHeap();
+  uint32_t getMinFreeHeap();
+  uint32_t getMaxAllocHeap();
+};
+extern EspClass ESP;
@@ -0,0 +1,102 @@
+#pragma once
+#include <Arduino.h>
+#include <esp_gatts_api.h>
+
+// Host stand-in for the Arduino-ESP32 BLE library: one server with one service is
+// enough for the UART adapter. Centrals are driven from the host side through
+// hostBleConnect/hostBleWrite/hostBleDisconnect (HostHooks.h); callbacks run on the
+// caller's thread, so the adapter's critical sections are no-ops here.
+class BLEServer;
+class BLECharacteristic;
+
+class BLEServerCallbacks {
+public:
+  virtual ~BLEServerCallbacks() {}
+  virtual void onConnect(BLEServer*) {}
+  virtual void onConnect(BLEServer*, esp_ble_gatts_cb_param_t*) {}
+  virtual void onDisconnect(BLEServer*) {}
+  virtual void onDisconnect(BLEServer*, esp_ble_gatts_cb_param_t*) {}
+};
+
+class BLECharacteristicCallbacks {
+public:
+  virtual ~BLECharacteristicCallbacks() {}
+  virtual void onWrite(BLECharacteristic*) {}
+  virtual void onWrite(BLECharacteristic*, esp_ble_gatts_cb_param_t*) {}
+};
+
+class BLEDescriptor {
+public:
+  virtual ~BLEDescriptor() {}
+};
+
+// Client Characteristic Configuration; the host stand-in subscribes on connect
+class BLE2902 : public BLEDescriptor {
+public:
+  bool getNotifications() const { return notify_; }
+  void setNotifications(bool on) { notify_ = on; }
+private:
+  bool notify_ = false;
+};
+
+class BLECharacteristic {
+public:
+  static constexpr uint32_t PROPERTY_READ = 1 << 0;
+  static constexpr uint32_t PROPERTY_WRITE = 1 << 1;
+  static constexpr uint32_t PROPERTY_NOTIFY = 1 << 2;
+  static constexpr uint32_t PROPERTY_INDICATE = 1 << 3;
+  static constexpr uint32_t PROPERTY_WRITE_NR = 1 << 5;
+
+  BLECharacteristic(const char* uuid, uint32_t props, uint16_t handle) : uuid_(uuid), props_(props), handle_(handle) {}
+  void addDescriptor(BLEDescriptor* d) { if (BLE2902* c = dynamic_cast<BLE2902*>(d)) cccd_ = c; }
+  void setCallbacks(BLECharacteristicCallbacks* cb) { cb_ = cb; }
+  void setValue(const uint8_t* d, size_t n) { value_ = String(std::string((const char*)d, n)); }
+  String getValue() const { return value_; }
+  uint16_t getHandle() const { return handle_; }
+  const char* getUUID() const { return uuid_; }
+  uint32_t properties() const { return props_; }
+  BLECharacteristicCallbacks* callbacks() const { return cb_; }
+  BLE2902* cccd() const { return cccd_; }
+
+private:
+  const char* uuid_;
+  uint32_t props_;
+  uint16_t handle_;
+  String value_;
+  BLECharacteristicCallbacks* cb_ = nullptr;
+  BLE2902* cccd_ = nullptr;
+};
+
+class BLEService {
+public:
+  BLECharacteristic* createCharacteristic(const char* uuid, uint32_t props);
+  void start() {}
+};
+
+class BLEServer {
+public:
+  void setCallbacks(BLEServerCallbacks* cb) { cb_ = cb; }
+  BLEService* createService(const char* uuid) { (void)uuid; return &service_; }
+  void disconnect(uint16_t connId);   // reported to the hostBleOnDrop() sink
+  esp_gatt_if_t getGattsIf() const { return 3; }
+  BLEServerCallbacks* callbacks() const { return cb_; }
+
+private:
+  BLEServerCallbacks* cb_ = nullptr;
+  BLEService service_;
+};
+
+class BLEAdvertising {
+public:
+  void addServiceUUID(const char* uuid) { (void)uuid; }
+  void setScanResponse(bool on) { (void)on; }
+  void setMinPreferred(uint8_t v) { (void)v; }
+};
+
+class BLEDevice {
+public:
+  static void init(const String& name) { (void)name; }
+  static BLEServer* createServer();
+  static BLEAdvertising* getAdvertising();
+  static void startAdvertising() {}
+};
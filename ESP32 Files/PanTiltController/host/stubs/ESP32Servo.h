@@ -0,0 +1,26 @@
+#pragma once
+#include <Arduino.h>
+
+// Host stand-in for ESP32Servo: remembers the last pulse. An optional observer sees
+// every write (the simulator's servo model hangs off it).
+class Servo {
+public:
+  using Observer = void (*)(int pin, int us);
+  static Observer observer;
+
+  void setPeriodHertz(int hz) { hz_ = hz; }
+  int attach(int pin, int minUs, int maxUs) { pin_ = pin; minUs_ = minUs; maxUs_ = maxUs; return 1; }
+  void detach() { pin_ = -1; }
+  bool attached() const { return pin_ >= 0; }
+  void writeMicroseconds(int us) {
+    us_ = us < minUs_ ? minUs_ : (us > maxUs_ ? maxUs_ : us);
+    writes_++;
+    if (observer && pin_ >= 0) observer(pin_, us_);
+  }
+  int readMicroseconds() const { return us_; }
+  uint32_t writes() const { return writes_; }
+
+private:
+  int pin_ = -1, hz_ = 50, minUs_ = 500, maxUs_ = 2500, us_ = 0;
+  uint32_t writes_ = 0;
+};
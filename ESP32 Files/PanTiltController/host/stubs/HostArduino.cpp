@@ -0,0 +1,137 @@
+#include <Arduino.h>
+#include <ESP32Servo.h>
+#include <Preferences.h>
+
+#include <chrono>
+#include <deque>
+#include <fstream>
+#include <new>
+
+// ------------------- Clock -------------------
+static uint64_t g_clockUs = 0;
+static bool g_clockReal = false;
+static std::chrono::steady_clock::time_point g_clockRealBase;
+static uint64_t g_clockRealBaseUs = 0;
+
+uint64_t hostClockUs() {
+  if (!g_clockReal) return g_clockUs;
+  auto dt = std::chrono::steady_clock::now() - g_clockRealBase;
+  return g_clockRealBaseUs + (uint64_t)std::chrono::duration_cast<std::chrono::microseconds>(dt).count();
+}
+
+void hostClockSetUs(uint64_t us) {
+  g_clockUs = us;
+  g_clockRealBase = std::chrono::steady_clock::now();
+  g_clockRealBaseUs = us;
+}
+
+void hostClockAdvanceUs(uint64_t us) { hostClockSetUs(hostClockUs() + us); }
+
+void hostClockRealTime(bool on) {
+  uint64_t now = hostClockUs();
+  g_clockReal = on;
+  hostClockSetUs(now);
+}
+
+uint32_t millis() { return (uint32_t)(hostClockUs() / 1000); }
+uint32_t micros() { return (uint32_t)hostClockUs(); }
+void delay(uint32_t ms) { if (!g_clockReal) g_clockUs += (uint64_t)ms * 1000; }
+
+// ------------------- Serial -------------------
+HardwareSerial Serial;
+static std::deque<uint8_t> g_serialRx;
+static HostSerialWriteFn g_serialTx = nullptr;
+
+void hostSerialFeed(const uint8_t* data, size_t len) { g_serialRx.insert(g_serialRx.end(), data, data + len); }
+void hostSerialOnWrite(HostSerialWriteFn fn) { g_serialTx = fn; }
+
+int HardwareSerial::available() { return (int)g_serialRx.size(); }
+
+int HardwareSerial::read() {
+  if (g_serialRx.empty()) return -1;
+  uint8_t b = g_serialRx.front();
+  g_serialRx.pop_front();
+  return b;
+}
+
+size_t HardwareSerial::write(uint8_t b) { return write(&b, 1); }
+
+size_t HardwareSerial::write(const uint8_t* d, size_t n) {
+  if (g_serialTx) g_serialTx(d, n);
+  else fwrite(d, 1, n, stdout);
+  return n;
+}
+
+// ------------------- Allocations -------------------
+// Counted at operator new/delete; a size header lets delete account live bytes.
+static HostAllocStats g_alloc;
+static const size_t ALLOC_HDR = alignof(std::max_align_t);
+
+static void* countedAlloc(size_t n) {
+  void* p = malloc(n + ALLOC_HDR);
+  if (!p) throw std::bad_alloc();
+  *(size_t*)p = n;
+  g_alloc.allocs++;
+  g_alloc.bytes += n;
+  g_alloc.liveBytes += (int64_t)n;
+  if (g_alloc.liveBytes > g_alloc.peakLiveBytes) g_alloc.peakLiveBytes = g_alloc.liveBytes;
+  return (uint8_t*)p + ALLOC_HDR;
+}
+
+static void countedFree(void* q) {
+  if (!q) return;
+  void* p = (uint8_t*)q - ALLOC_HDR;
+  g_alloc.frees++;
+  g_alloc.liveBytes -= (int64_t)*(size_t*)p;
+  free(p);
+}
+
+void* operator new(size_t n) { return countedAlloc(n); }
+void* operator new[](size_t n) { return countedAlloc(n); }
+void operator delete(void* p) noexcept { countedFree(p); }
+void operator delete[](void* p) noexcept { countedFree(p); }
+void operator delete(void* p, size_t) noexcept { countedFree(p); }
+void operator delete[](void* p, size_t) noexcept { countedFree(p); }
+
+HostAllocStats hostAllocStats() { return g_alloc; }
+
+// ------------------- ESP -------------------
+// A nominal ESP32 heap less what the host has live; no fragmentation model.
+EspClass ESP;
+static const int64_t HOST_HEAP_BYTES = 320 * 1024;
+
+static uint32_t heapLeft(int64_t used) { return used >= HOST_HEAP_BYTES ? 0 : (uint32_t)(HOST_HEAP_BYTES - used); }
+uint32_t EspClass::getFreeHeap() { return heapLeft(g_alloc.liveBytes); }
+uint32_t EspClass::getMinFreeHeap() { return heapLeft(g_alloc.peakLiveBytes); }
+uint32_t EspClass::getMaxAllocHeap() { return getFreeHeap(); }
+
+// ------------------- Servo / Preferences -------------------
+Servo::Observer Servo::observer = nullptr;
+uint32_t Preferences::writes = 0;
+Preferences::Observer Preferences::observer = nullptr;
+
+// File format: per key "<namespace> <key> <length>\n" then the raw bytes.
+bool Preferences::hostSave(const char* path) {
+  std::ofstream out(path, std::ios::binary | std::ios::trunc);
+  if (!out) return false;
+  for (auto& ns : store())
+    for (auto& kv : ns.second) {
+      out << ns.first << ' ' << kv.first << ' ' << kv.second.size() << '\n';
+      out.write((const char*)kv.second.data(), (std::streamsize)kv.second.size());
+    }
+  return (bool)out;
+}
+
+bool Preferences::hostLoad(const char* path) {
+  std::ifstream in(path, std::ios::binary);
+  if (!in) return false;
+  std::string ns, key;
+  size_t n;
+  while (in >> ns >> key >> n) {
+    in.get();
+    Blob b(n);
+    if (n && !in.read((char*)b.data(), (std::streamsize)n)) return false;
+    store()[ns][key] = b;
+  }
+  return true;
+}
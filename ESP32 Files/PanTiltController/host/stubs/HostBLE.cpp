@@ -0,0 +1,60 @@
+#include <BLEDevice.h>
+
+// One server, one service: the adapter's TX (notify) and RX (write) characteristics.
+static BLEServer g_server;
+static BLEAdvertising g_advertising;
+static BLECharacteristic* g_chars[4];
+static uint8_t g_charCount = 0;
+static HostBleNotifyFn g_notify = nullptr;
+static HostBleDropFn g_drop = nullptr;
+
+BLEServer* BLEDevice::createServer() { return &g_server; }
+BLEAdvertising* BLEDevice::getAdvertising() { return &g_advertising; }
+
+BLECharacteristic* BLEService::createCharacteristic(const char* uuid, uint32_t props) {
+  if (g_charCount >= sizeof(g_chars) / sizeof(g_chars[0])) return nullptr;
+  BLECharacteristic* c = new BLECharacteristic(uuid, props, (uint16_t)(0x2A + g_charCount));
+  g_chars[g_charCount++] = c;
+  return c;
+}
+
+void BLEServer::disconnect(uint16_t connId) {
+  if (g_drop) g_drop(connId);
+}
+
+void hostBleOnNotify(HostBleNotifyFn fn) { g_notify = fn; }
+void hostBleOnDrop(HostBleDropFn fn) { g_drop = fn; }
+
+void hostBleConnect(int connId) {
+  for (uint8_t i = 0; i < g_charCount; i++)
+    if (g_chars[i]->cccd()) g_chars[i]->cccd()->setNotifications(true);
+  esp_ble_gatts_cb_param_t p = {};
+  p.connect.conn_id = (uint16_t)connId;
+  if (g_server.callbacks()) g_server.callbacks()->onConnect(&g_server, &p);
+}
+
+void hostBleDisconnect(int connId) {
+  esp_ble_gatts_cb_param_t p = {};
+  p.disconnect.conn_id = (uint16_t)connId;
+  if (g_server.callbacks()) g_server.callbacks()->onDisconnect(&g_server, &p);
+}
+
+void hostBleWrite(int connId, const uint8_t* data, size_t len) {
+  for (uint8_t i = 0; i < g_charCount; i++) {
+    BLECharacteristic* c = g_chars[i];
+    if (!(c->properties() & (BLECharacteristic::PROPERTY_WRITE | BLECharacteristic::PROPERTY_WRITE_NR))) continue;
+    c->setValue(data, len);
+    esp_ble_gatts_cb_param_t p = {};
+    p.write.conn_id = (uint16_t)connId;
+    p.write.handle = c->getHandle();
+    if (c->callbacks()) c->callbacks()->onWrite(c, &p);
+    return;
+  }
+}
+
+esp_err_t esp_ble_gatts_send_indicate(esp_gatt_if_t gatts_if, uint16_t conn_id, uint16_t attr_handle,
+                                      uint16_t value_len, uint8_t* value, bool need_confirm) {
+  (void)gatts_if; (void)attr_handle; (void)need_confirm;
+  if (g_notify) g_notify(conn_id, value, value_len);
+  return ESP_OK;
+}
@@ -0,0 +1,39 @@
+#pragma once
+// Host-only controls for the stand-in core: the clock, Serial's two ends, the BLE
+// centrals and the allocation counters. Firmware sources never include this directly.
+#include <cstddef>
+#include <cstdint>
+
+// ---- clock ----
+// Virtual by default: time moves only when the host advances it, so runs repeat
+// exactly. hostClockRealTime(true) follows the monotonic clock instead.
+void hostClockSetUs(uint64_t us);
+void hostClockAdvanceUs(uint64_t us);
+uint64_t hostClockUs();
+void hostClockRealTime(bool on);
+
+// ---- Serial ----
+using HostSerialWriteFn = void (*)(const uint8_t* data, size_t len);
+void hostSerialFeed(const uint8_t* data, size_t len);   // bytes the sketch will read()
+void hostSerialOnWrite(HostSerialWriteFn fn);           // nullptr: stdout
+
+// ---- BLE ----
+// One simulated central per connId: connecting also subscribes to notifications;
+// each hostBleWrite() is one ATT write to the RX characteristic.
+using HostBleNotifyFn = void (*)(int connId, const uint8_t* data, size_t len);
+using HostBleDropFn = void (*)(int connId);
+void hostBleConnect(int connId);
+void hostBleDisconnect(int connId);
+void hostBleWrite(int connId, const uint8_t* data, size_t len);
+void hostBleOnNotify(HostBleNotifyFn fn);   // TX notifications; dropped when unset
+void hostBleOnDrop(HostBleDropFn fn);       // the firmware closed a connection
+
+// ---- allocations (operator new / delete) ----
+struct HostAllocStats {
+  uint64_t allocs = 0;
+  uint64_t frees = 0;
+  uint64_t bytes = 0;        // total requested
+  int64_t liveBytes = 0;
+  int64_t peakLiveBytes = 0;
+};
+HostAllocStats hostAllocStats();
@@ -0,0 +1,72 @@
+#pragma once
+#include <Arduino.h>
+#include <map>
+#include <string>
+#include <vector>
+
+// Host stand-in for the NVS Preferences API: one in-memory store shared by every
+// instance, keyed by namespace. hostSave/hostLoad keep it in a file across runs. Every
+// flash-changing call is counted in writes and shown to the optional observer.
+class Preferences {
+public:
+  bool begin(const char* ns, bool readOnly = false) { ns_ = ns; ro_ = readOnly; return true; }
+  void end() {}
+  bool clear() {
+    if (ro_) return false;
+    space().clear();
+    noteWrite("clear", "");
+    return true;
+  }
+  bool remove(const char* k) {
+    if (ro_ || !space().erase(k)) return false;
+    noteWrite("remove", k);
+    return true;
+  }
+  bool isKey(const char* k) { return space().count(k) > 0; }
+
+  size_t putBytes(const char* k, const void* v, size_t n) {
+    if (ro_) return 0;
+    space()[k].assign((const uint8_t*)v, (const uint8_t*)v + n);
+    noteWrite("put", k);
+    return n;
+  }
+  size_t getBytesLength(const char* k) { const Blob* b = find(k); return b ? b->size() : 0; }
+  size_t getBytes(const char* k, void* v, size_t n) {
+    const Blob* b = find(k);
+    if (!b || b->size() > n) return 0;
+    memcpy(v, b->data(), b->size());
+    return b->size();
+  }
+
+  size_t putString(const char* k, const String& s) { return putBytes(k, s.c_str(), s.length()); }
+  String getString(const char* k, const String& def = String()) {
+    const Blob* b = find(k);
+    return b ? String(std::string(b->begin(), b->end())) : def;
+  }
+  size_t putUShort(const char* k, uint16_t v) { return putBytes(k, &v, sizeof(v)); }
+  uint16_t getUShort(const char* k, uint16_t def = 0) { uint16_t v; return getBytes(k, &v, sizeof(v)) == sizeof(v) ? v : def; }
+  size_t putUInt(const char* k, uint32_t v) { return putBytes(k, &v, sizeof(v)); }
+  uint32_t getUInt(const char* k, uint32_t def = 0) { uint32_t v; return getBytes(k, &v, sizeof(v)) == sizeof(v) ? v : def; }
+
+  static bool hostSave(const char* path);
+  static bool hostLoad(const char* path);
+  static void hostReset() { store().clear(); writes = 0; }
+  static uint32_t writes;   // put/remove/clear calls that reached the store, all namespaces
+
+  using Observer = void (*)(const char* op, const char* ns, const char* key);
+  static Observer observer;
+
+private:
+  typedef std::vector<uint8_t> Blob;
+  typedef std::map<std::string, Blob> Space;
+  static std::map<std::string, Space>& store() { static std::map<std::string, Space> s; return s; }
+  Space& space() { return store()[ns_]; }
+  void noteWrite(const char* op, const char* k) {
+    writes++;
+    if (observer) observer(op, ns_.c_str(), k);
+  }
+  const Blob* find(const char* k) { Space& s = space(); auto it = s.find(k); return it == s.end() ? nullptr : &it->second; }
+
+  std::string ns_;
+  bool ro_ = false;
+};
@@ -0,0 +1,20 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+// Host stand-in for the ESP-IDF GATT server types the BLE adapter touches.
+typedef int esp_err_t;
+#define ESP_OK 0
+#define ESP_FAIL -1
+
+typedef uint8_t esp_gatt_if_t;
+
+typedef union {
+  struct { uint16_t conn_id; } connect;
+  struct { uint16_t conn_id; } disconnect;
+  struct { uint16_t conn_id; uint16_t handle; } write;
+} esp_ble_gatts_cb_param_t;
+
+// Notifications go to the hostBleOnNotify() sink
+esp_err_t esp_ble_gatts_send_indicate(esp_gatt_if_t gatts_if, uint16_t conn_id, uint16_t attr_handle,
+                                      uint16_t value_len, uint8_t* value, bool need_confirm);
@@ -0,0 +1,482 @@
+// Unit tests for the firmware core on the host stand-ins. The module is compiled in, so
+// file-static helpers are reachable; rig internals go through PanTiltRigProbe. Each
+// case runs in a fresh process (ctest registers one test per case), so the rig, NVS and
+// clock always start from boot. A case whose feature the build profile leaves out exits
+// with SKIP_CODE, which ctest reports as skipped.
+//
+//   pantilt_tests [case]    no argument: run every case, each in its own child
+#include "../../PanTiltModule.cpp"
+
+#include <string>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <vector>
+
+struct PanTiltRigProbe {
+  static PanTiltRig& rig() { return *rigs[0]; }
+  static uint16_t cfgDirty() { return rig().cfgDirty; }
+  static uint32_t persistSkipped() { return rig().persistStats.skipped; }
+
+  static float panPos() { return rig().v1; }
+  static bool jogging(char axis) { return axis == 'x' ? rig().jog.x.active : rig().jog.y.active; }
+  static uint8_t queued() { return rig().qCount; }
+  static bool laneActive() { return rig().qAnyActive(); }
+  static QueueMode queueMode() { return rig().qMode; }
+  static bool macroActive() { return rig().macroVm[0].active; }
+  // Cuts the running macro's code mid-op, as a corrupt blob would be
+  static void truncateMacro() {
+    MacroVm& vm = rig().macroVm[0];
+    rig().cmdFav[vm.slot].len = (uint16_t)(vm.pc + 1);
+  }
+  static float tiltPos() { return rig().v2; }
+  static bool poseAllowed(float x, float y) { return rig().poseAllowed(x, y); }
+  static bool clipPath(float x0, float y0, float& x1, float& y1, uint32_t& dx, uint32_t& dy) {
+    return rig().clipPath(x0, y0, x1, y1, dx, dy);
+  }
+  static bool cellInside(float x, float y) { return gridBit(rig().zoneInside, zoneCell(y) * ZONE_GRID_N + zoneCell(x)); }
+  static bool cellEdge(float x, float y) { return gridBit(rig().zoneEdge, zoneCell(y) * ZONE_GRID_N + zoneCell(x)); }
+  static const LimitConfig& limits() { return rig().limits; }
+  static void limitsDefaults() { rig().limitsDefaults(); }
+  static bool reloadLimits() {
+    PanTiltRig& r = rig();
+    r.prefs.begin(r.rigCfg.prefNs, true);
+    bool ok = r.loadLimits();
+    r.prefs.end();
+    return ok;
+  }
+};
+
+// ------------------- Harness -------------------
+static std::string g_captured;
+static int g_failures = 0;
+
+static void captureOut(PanTiltDest, const String& line, int) {
+  g_captured += line.c_str();
+  g_captured += '\n';
+}
+
+#define CHECK(cond) do { if (!(cond)) { fprintf(stderr, "%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #cond); g_failures++; } } while (0)
+#define CHECK_HAS(text, part) do { if ((text).find(part) == std::string::npos) { fprintf(stderr, "%s:%d: expected %s in:\n%s\n", __FILE__, __LINE__, part, (text).c_str()); g_failures++; } } while (0)
+#define CHECK_LACKS(text, part) do { if ((text).find(part) != std::string::npos) { fprintf(stderr, "%s:%d: unexpected %s in:\n%s\n", __FILE__, __LINE__, part, (text).c_str()); g_failures++; } } while (0)
+
+static void runMs(uint32_t ms) {
+  for (uint32_t i=0;i<ms;i++) {
+    hostClockAdvanceUs(1000);
+    PanTilt_loop();
+  }
+}
+
+static void boot() {
+  hostClockSetUs(1000000);
+  PanTilt_setOutput(captureOut);
+  PanTilt_begin(3, 4);
+  runMs(50);   // favorites prefetch, first telemetry/debug lines
+  g_captured.clear();
+}
+
+// One client line; returns everything the firmware printed for it
+static std::string send(const char* line) {
+  g_captured.clear();
+  PanTilt_handleLine(String(line), false);
+  return g_captured;
+}
+
+// ---- NVS write log ----
+static std::vector<std::string> g_nvs;
+
+static void nvsObserve(const char* op, const char* ns, const char* key) {
+  g_nvs.push_back(std::string(op) + " " + ns + "/" + key);
+}
+
+static std::string nvsLog() {
+  std::string s;
+  for (const std::string& e : g_nvs) { s += e; s += '\n'; }
+  return s;
+}
+
+static size_t nvsCount(const char* entry) {
+  size_t n = 0;
+  for (const std::string& e : g_nvs) if (e == entry) n++;
+  return n;
+}
+
+// ------------------- Persistence -------------------
+// One flush writes each dirty key group exactly once, and nothing else
+static void testPersistOneKeyPerGroup() {
+  boot();
+  Preferences::observer = nvsObserve;
+
+  send("{\"cmd\":\"speed\",\"value\":120}");
+  send("{\"cmd\":\"invert\",\"axis\":\"x\"}");     // same cfg group
+  send("{\"cmd\":\"camera\",\"hfov\":70}");
+  send("{\"cmd\":\"favSave\",\"slot\":2,\"line\":\"{\\\"cmd\\\":\\\"center\\\"}\"}");
+  g_nvs.clear();
+  CHECK_HAS(send("{\"cmd\":\"persist\"}"), "\"persisted\"");
+  CHECK(g_nvs.size() == 3);
+  CHECK(nvsCount("put pantilt/cfg") == 1);
+  CHECK(nvsCount("put pantilt/cam") == 1);
+  CHECK(nvsCount("put pantilt/fb2") == 1);
+  if (g_nvs.size() != 3) fprintf(stderr, "%s", nvsLog().c_str());
+
+  g_nvs.clear();
+  CHECK_HAS(send("{\"cmd\":\"persist\"}"), "no_changes");
+  CHECK(g_nvs.empty());
+}
+
+// A group that is dirty but matches flash is skipped without a write
+static void testPersistUnchangedSkipped() {
+  boot();
+  Preferences::observer = nvsObserve;
+
+  send("{\"cmd\":\"speed\",\"value\":120}");
+  send("{\"cmd\":\"persist\"}");
+  uint32_t skipped = PanTiltRigProbe::persistSkipped();
+
+  g_nvs.clear();
+  send("{\"cmd\":\"speed\",\"value\":60}");
+  send("{\"cmd\":\"speed\",\"value\":120}");
+  CHECK(PanTiltRigProbe::cfgDirty() != 0);
+  send("{\"cmd\":\"persist\"}");
+  CHECK(g_nvs.empty());
+  CHECK(PanTiltRigProbe::persistSkipped() == skipped + 1);
+
+  // Same camera values never even mark the group dirty
+  send("{\"cmd\":\"camera\",\"hfov\":70}");
+  send("{\"cmd\":\"persist\"}");
+  g_nvs.clear();
+  send("{\"cmd\":\"camera\",\"hfov\":70}");
+  CHECK(PanTiltRigProbe::cfgDirty() == 0);
+  send("{\"cmd\":\"persist\"}");
+  CHECK(g_nvs.empty());
+  if (!g_nvs.empty()) fprintf(stderr, "%s", nvsLog().c_str());
+}
+
+// Autosave spreads the flush over loop passes but still writes each group once
+static void testPersistAutosaveFlush() {
+  boot();
+  send("{\"cmd\":\"autosave\",\"ms\":200}");
+  send("{\"cmd\":\"persist\"}");
+  Preferences::observer = nvsObserve;
+
+  send("{\"cmd\":\"speed\",\"value\":45}");
+  send("{\"cmd\":\"camera\",\"vfov\":40}");
+  runMs(150);
+  CHECK(g_nvs.empty());   // still inside the debounce window
+  runMs(200);
+  CHECK(g_nvs.size() == 2);
+  CHECK(nvsCount("put pantilt/cfg") == 1);
+  CHECK(nvsCount("put pantilt/cam") == 1);
+  CHECK(PanTiltRigProbe::cfgDirty() == 0);
+
+  g_nvs.clear();
+  runMs(500);
+  CHECK(g_nvs.empty());
+}
+
+// ------------------- Queue -------------------
+// Blend lookahead is bounded by the profile's queue depth, and the error says so
+static void testQueueLookaheadRange() {
+  boot();
+  char line[96], want[40];
+  snprintf(line, sizeof(line), "{\"cmd\":\"queue\",\"mode\":\"blend\",\"lookahead\":%u}", (unsigned)QMAX);
+  CHECK_HAS(send(line), "\"ok\":true");
+  snprintf(line, sizeof(line), "{\"cmd\":\"queue\",\"mode\":\"blend\",\"lookahead\":%u}", (unsigned)QMAX + 1);
+  snprintf(want, sizeof(want), "lookahead must be 1..%u\"", (unsigned)QMAX);
+  CHECK_HAS(send(line), want);
+}
+
+// ------------------- Macros -------------------
+// A macro that changed the queue mode hands it back even when its bytecode turns out bad
+static void testMacroBadCodeRestoresQueue() {
+  boot();
+  send("{\"cmd\":\"favSave\",\"slot\":1,\"script\":\"{\\\"cmd\\\":\\\"queue\\\",\\\"mode\\\":\\\"blend\\\"}\\\\n"
+       "{\\\"cmd\\\":\\\"waitMs\\\",\\\"ms\\\":200}\\\\n{\\\"cmd\\\":\\\"center\\\"}\"}");
+  CHECK(PanTiltRigProbe::queueMode() == Q_STEP);
+  CHECK_HAS(send("{\"cmd\":\"favRun\",\"slot\":1}"), "\"ok\":true");
+  runMs(50);
+  CHECK(PanTiltRigProbe::macroActive());
+  CHECK(PanTiltRigProbe::queueMode() == Q_BLEND);
+
+  PanTiltRigProbe::truncateMacro();
+  g_captured.clear();
+  runMs(300);
+  CHECK_HAS(g_captured, "bad_macro");
+  CHECK(!PanTiltRigProbe::macroActive());
+  CHECK(PanTiltRigProbe::queueMode() == Q_STEP);
+}
+
+// ------------------- Jog -------------------
+// A jog that takes over a queued step's axis finishes that step instead of letting it
+// time out, and later steps on the axis wait until the jog has stopped
+static void testJogTakesQueuedAxis() {
+  boot();
+  send("{\"cmd\":\"queue\",\"mode\":\"on\"}");
+  CHECK_HAS(send("{\"cmd\":\"set\",\"x\":60,\"dur\":1}"), "queued");
+  CHECK_HAS(send("{\"cmd\":\"set\",\"x\":-60,\"dur\":1}"), "queued");
+  runMs(200);
+  CHECK(PanTiltRigProbe::laneActive());
+
+  std::string out = send("{\"cmd\":\"jog\",\"x\":5,\"keepalive\":5000}");
+  CHECK_HAS(out, "jogging");
+  g_captured.clear();
+  runMs(3000);
+  CHECK_LACKS(g_captured, "step_timeout");
+  CHECK(PanTiltRigProbe::jogging('x'));
+  CHECK(!PanTiltRigProbe::laneActive());
+  CHECK(PanTiltRigProbe::queued() == 1);   // held back by the jog
+
+  send("{\"cmd\":\"jog\",\"x\":0}");
+  runMs(1500);
+  CHECK(!PanTiltRigProbe::jogging('x'));
+  CHECK(PanTiltRigProbe::queued() == 0);
+  CHECK(PanTiltRigProbe::panPos() == -60);
+}
+
+// ------------------- Target selection -------------------
+// A frame with no boxes reports no pick and leaves the rig where it is
+static void testTargetsEmptyFrame() {
+  boot();
+  std::string out = send("{\"cmd\":\"targets\",\"b\":[]}");
+  CHECK_HAS(out, "\"idx\":-1");
+  CHECK_LACKS(out, "\"ok\":false");
+  runMs(100);
+  CHECK(PanTiltRigProbe::panPos() == 0 && PanTiltRigProbe::tiltPos() == 0);
+}
+
+// ------------------- Keep-out zones -------------------
+// Pan 30..60, tilt -10..40: cells along x=30 are edge cells, (45,15) is wholly inside
+static const char* ZONE_A = "{\"cmd\":\"zone\",\"slot\":1,\"pts\":[30,-10,60,-10,60,40,30,40]}";
+
+static void testZonePoseAllowed() {
+  boot();
+  CHECK_HAS(send(ZONE_A), "\"zones\":[{\"slot\":1");
+
+  CHECK(PanTiltRigProbe::cellInside(45, 15));
+  CHECK(!PanTiltRigProbe::poseAllowed(45, 15));
+
+  CHECK(PanTiltRigProbe::cellEdge(30.5f, 0));
+  CHECK(!PanTiltRigProbe::poseAllowed(30.5f, 0));   // edge cell, inside the polygon
+  CHECK(PanTiltRigProbe::cellEdge(31.5f, 41));
+  CHECK(PanTiltRigProbe::poseAllowed(31.5f, 41));   // edge cell, above the top edge
+  CHECK(PanTiltRigProbe::poseAllowed(29.5f, 0));
+
+  CHECK(!PanTiltRigProbe::cellInside(0, 0) && !PanTiltRigProbe::cellEdge(0, 0));
+  CHECK(PanTiltRigProbe::poseAllowed(0, 0));
+  CHECK(PanTiltRigProbe::poseAllowed(-90, -90) && PanTiltRigProbe::poseAllowed(90, 90));
+
+  send("{\"cmd\":\"limits\",\"maxX\":20}");
+  CHECK(!PanTiltRigProbe::poseAllowed(25, 0));   // outside the limit box
+}
+
+// A timed path through the zone stops at its near edge, and the clip scales the time
+static void testZoneClipCrossing() {
+  boot();
+  send(ZONE_A);
+
+  float x1 = 90, y1 = 0;
+  uint32_t dx = 1000, dy = 1000;
+  CHECK(PanTiltRigProbe::clipPath(0, 0, x1, y1, dx, dy));
+  CHECK(x1 > 29.5f && x1 <= 30.0f);
+  CHECK(y1 == 0);
+  CHECK(dx > 320 && dx <= 334);
+  CHECK(PanTiltRigProbe::poseAllowed(x1, y1));
+
+  // A path that misses the zone is left alone
+  x1 = 90; y1 = 60; dx = dy = 1000;
+  CHECK(!PanTiltRigProbe::clipPath(0, 60, x1, y1, dx, dy));
+  CHECK(x1 == 90 && y1 == 60 && dx == 1000 && dy == 1000);
+}
+
+// An instant step is walked as its straight segment, not tested only at its end
+static void testZoneClipInstant() {
+  boot();
+  send(ZONE_A);
+
+  float x1 = 90, y1 = 0;
+  uint32_t dx = 0, dy = 0;
+  CHECK(PanTiltRigProbe::clipPath(0, 0, x1, y1, dx, dy));
+  CHECK(x1 > 29.5f && x1 <= 30.0f);
+  CHECK(dx == 0 && dy == 0);
+
+  x1 = -40; y1 = 0;
+  CHECK(!PanTiltRigProbe::clipPath(0, 0, x1, y1, dx, dy));
+  CHECK(x1 == -40 && y1 == 0);
+
+  std::string out = send("{\"cmd\":\"set\",\"x\":80,\"y\":0,\"dur\":0}");
+  CHECK_HAS(out, "\"keep_out\"");
+  runMs(20);
+  CHECK(PanTiltRigProbe::panPos() > 29.5f && PanTiltRigProbe::panPos() <= 30.0f);
+  CHECK(PanTiltRigProbe::poseAllowed(PanTiltRigProbe::panPos(), PanTiltRigProbe::tiltPos()));
+}
+
+// Commands that would leave the rig inside a zone or outside the limits are refused
+static void testZoneRejectPose() {
+  boot();
+  send(ZONE_A);
+
+  CHECK_HAS(send("{\"cmd\":\"set\",\"x\":45,\"y\":15}"), "pose_in_zone");
+  CHECK_HAS(send("{\"cmd\":\"qAdd\",\"cmd2\":\"set\",\"x\":45,\"y\":15}"), "pose_in_zone");
+  CHECK_HAS(send("{\"cmd\":\"set\",\"x\":10,\"y\":15,\"dur\":0}"), "\"ok\":true");
+  runMs(20);
+  CHECK_HAS(send("{\"cmd\":\"adjust\",\"x\":35}"), "pose_in_zone");
+  CHECK(PanTiltRigProbe::panPos() == 10);
+
+  CHECK_HAS(send("{\"cmd\":\"zone\",\"slot\":2,\"pts\":[0,0,20,0,20,30,0,30]}"), "pose_in_zone");
+  CHECK(PanTiltRigProbe::limits().zones[1].n == 0);
+  CHECK_HAS(send("{\"cmd\":\"limits\",\"minX\":20}"), "pose_outside");
+  CHECK(PanTiltRigProbe::limits().minX == POS_MIN);
+}
+
+// Every positioned command refuses a target inside a zone, not only set
+static void testZoneRejectPositioned() {
+  boot();
+  send("{\"cmd\":\"set\",\"x\":45,\"y\":15,\"dur\":0}");
+  send("{\"cmd\":\"save\",\"slot\":1}");
+  send("{\"cmd\":\"presetSave\",\"name\":\"inside\"}");
+  send("{\"cmd\":\"favSave\",\"slot\":1,\"script\":\"{\\\"cmd\\\":\\\"set\\\",\\\"x\\\":50,\\\"y\\\":0,\\\"q\\\":false}\"}");
+  send("{\"cmd\":\"set\",\"x\":10,\"y\":15,\"dur\":0}");
+  runMs(20);
+  send(ZONE_A);
+
+  CHECK_HAS(send("{\"cmd\":\"recall\",\"slot\":1}"), "pose_in_zone");
+  CHECK_HAS(send("{\"cmd\":\"presetGo\",\"name\":\"inside\"}"), "pose_in_zone");
+  CHECK_HAS(send("{\"cmd\":\"look\",\"u\":1,\"v\":0}"), "pose_in_zone");
+  send("{\"cmd\":\"favRun\",\"slot\":1}");
+  runMs(100);
+  CHECK_HAS(g_captured, "pose_in_zone");
+  CHECK_LACKS(g_captured, "keep_out");
+  CHECK(PanTiltRigProbe::panPos() == 10 && PanTiltRigProbe::tiltPos() == 15);
+
+  CHECK_HAS(send("{\"cmd\":\"look\",\"u\":-0.5,\"v\":0}"), "\"ok\":true");   // away from the zone
+}
+
+// The limits blob survives a persist/reload and a corrupted one is ignored
+static void testZoneLimitsRoundTrip() {
+  boot();
+  Preferences::observer = nvsObserve;
+  send("{\"cmd\":\"limits\",\"minX\":-60,\"maxY\":70}");
+  send(ZONE_A);
+  g_nvs.clear();
+  CHECK_HAS(send("{\"cmd\":\"persist\"}"), "\"persisted\"");
+  CHECK(nvsCount("put pantilt/limits") == 1);
+  LimitConfig saved = PanTiltRigProbe::limits();
+
+  PanTiltRigProbe::limitsDefaults();
+  CHECK(PanTiltRigProbe::poseAllowed(45, 15));
+  CHECK(PanTiltRigProbe::reloadLimits());
+  CHECK(!memcmp(&saved, &PanTiltRigProbe::limits(), sizeof(saved)));
+  CHECK(!PanTiltRigProbe::poseAllowed(45, 15));
+  CHECK(!PanTiltRigProbe::poseAllowed(-70, 0));
+
+  Preferences raw;
+  raw.begin("pantilt", false);
+  LimitConfig bad = saved;
+  bad.maxX = 10;   // crc no longer matches
+  raw.putBytes("limits", &bad, sizeof(bad));
+  raw.end();
+  PanTiltRigProbe::limitsDefaults();
+  CHECK(!PanTiltRigProbe::reloadLimits());
+  CHECK(PanTiltRigProbe::limits().minX == POS_MIN);
+  CHECK(PanTiltRigProbe::poseAllowed(45, 15));
+}
+
+// ------------------- JSON fields -------------------
+// Only keys of the outer object count: string values and nested keys are skipped
+static void testJsonKeysOnly() {
+  double d = 0;
+  CHECK(!getDoubleField(String("{\"cmd\":\"presetSave\",\"name\":\"at\",\"x\":1}"), "at", d));
+  CHECK(!getDoubleField(String("{\"cmd\":\"x\",\"o\":{\"at\":5}}"), "at", d));
+  CHECK(getDoubleField(String("{\"name\":\"at\", \"at\" : 7}"), "at", d) && d == 7);
+
+  String v;
+  CHECK(getStringField(String("{\"name\":\"cmd\",\"cmd\":\"center\"}"), "cmd", v) && v == "center");
+  CHECK(getStringField(String("{\"line\":\"{\\\"cmd\\\":\\\"stop\\\"}\",\"cmd\":\"favSave\"}"), "cmd", v) && v == "favSave");
+  float f = 0;
+  CHECK(!getNumberField(String("{\"cmd\":\"set\",\"axis\":\"x\"}"), "x", f));
+}
+
+// A value named "at" is not a schedule time; a real "at" before any sync still is
+static void testJsonAtValue() {
+  boot();
+  std::string out = send("{\"cmd\":\"presetSave\",\"name\":\"at\",\"x\":1}");
+  CHECK_LACKS(out, "no_clock");
+  CHECK_HAS(out, "\"ok\":true");
+  out = send("{\"cmd\":\"presetGo\",\"name\":\"at\",\"dur\":1}");
+  CHECK_LACKS(out, "no_clock");
+  CHECK_HAS(out, "\"ok\":true");
+  CHECK_HAS(send("{\"cmd\":\"center\",\"at\":5000}"), PanTiltBuild::hostClock ? "no_clock" : "not_built");
+}
+
+// Favorites keep "at" lines on schedule and refuse stored clock pings
+static void testJsonFavoriteClockLines() {
+  boot();
+  CHECK_HAS(send("{\"cmd\":\"favSave\",\"slot\":1,\"script\":\"{\\\"cmd\\\":\\\"sync\\\",\\\"t\\\":5000}\"}"), "disallowed");
+  CHECK_HAS(send("{\"cmd\":\"favSave\",\"slot\":1,\"script\":\"{\\\"cmd\\\":\\\"sync\\\"}\"}"), "\"ok\":true");
+
+  send("{\"cmd\":\"sync\",\"t\":100000}");
+  CHECK_HAS(send("{\"cmd\":\"favSave\",\"slot\":2,\"script\":\"{\\\"cmd\\\":\\\"set\\\",\\\"x\\\":40,\\\"dur\\\":0,\\\"at\\\":100500}\"}"), "\"ok\":true");
+  CHECK_HAS(send("{\"cmd\":\"favRun\",\"slot\":2}"), "\"ok\":true");
+  runMs(100);
+  CHECK_HAS(g_captured, "scheduled");
+  CHECK(PanTiltRigProbe::panPos() == 0);
+  runMs(600);
+  CHECK(PanTiltRigProbe::panPos() == 40);
+}
+
+// ------------------- Main -------------------
+static const int SKIP_CODE = 77;
+
+struct TestCase {
+  const char* name;
+  void (*fn)();
+  bool built;   // the features it exercises are in this build profile
+};
+
+static const TestCase TESTS[] = {
+  { "persist.oneKeyPerGroup", testPersistOneKeyPerGroup, true },
+  { "persist.unchangedSkipped", testPersistUnchangedSkipped, true },
+  { "persist.autosaveFlush", testPersistAutosaveFlush, true },
+  { "queue.lookaheadRange", testQueueLookaheadRange, true },
+  { "macro.badCodeRestoresQueue", testMacroBadCodeRestoresQueue, true },
+  { "jog.takesQueuedAxis", testJogTakesQueuedAxis, PanTiltBuild::jog },
+  { "targets.emptyFrame", testTargetsEmptyFrame, PanTiltBuild::targets },
+  { "zone.poseAllowed", testZonePoseAllowed, PanTiltBuild::zones },
+  { "zone.clipCrossing", testZoneClipCrossing, PanTiltBuild::zones },
+  { "zone.clipInstant", testZoneClipInstant, PanTiltBuild::zones },
+  { "zone.rejectPose", testZoneRejectPose, PanTiltBuild::zones },
+  { "zone.rejectPositioned", testZoneRejectPositioned, PanTiltBuild::zones },
+  { "zone.limitsRoundTrip", testZoneLimitsRoundTrip, PanTiltBuild::zones },
+  { "json.keysOnly", testJsonKeysOnly, true },
+  { "json.atValue", testJsonAtValue, true },
+  { "json.favoriteClockLines", testJsonFavoriteClockLines, PanTiltBuild::hostClock },
+};
+
+static int runCase(const TestCase& t) {
+  if (!t.built) return SKIP_CODE;
+  t.fn();
+  if (g_failures) fprintf(stderr, "FAIL %s (%d)\n", t.name, g_failures);
+  return g_failures ? 1 : 0;
+}
+
+int main(int argc, char** argv) {
+  if (argc > 2) { fprintf(stderr, "usage: %s [case]\n", argv[0]); return 2; }
+  if (argc == 2) {
+    for (const TestCase& t : TESTS)
+      if (!strcmp(t.name, argv[1])) return runCase(t);
+    fprintf(stderr, "unknown case %s\n", argv[1]);
+    return 2;
+  }
+
+  int failed = 0;
+  for (const TestCase& t : TESTS) {
+    fflush(stdout);
+    pid_t pid = fork();
+    if (pid == 0) _exit(runCase(t));
+    int status = 0;
+    waitpid(pid, &status, 0);
+    int code = WIFEXITED(status) ? WEXITSTATUS(status) : -1;
+    printf("%-32s %s\n", t.name, code == 0 ? "ok" : code == SKIP_CODE ? "skip" : "FAIL");
+    if (code != 0 && code != SKIP_CODE) failed++;
+  }
+  return failed ? 1 : 0;
+}